@@ -27,8 +27,8 @@
 #include "vim.h"
 
 static void	enter_buffer __ARGS((BUF *));
-static char_u	*buflist_match __ARGS((vim_regexp *prog, BUF *buf));
-static char_u	*buflist_match_try __ARGS((vim_regexp *prog, char_u *name));
+static char_u	*buflist_match __ARGS((REGEXEC *, vim_regexp *, BUF *));
+static char_u	*buflist_match_try __ARGS((REGEXEC *, vim_regexp *, char_u *));
 static void	buflist_setlnum __ARGS((BUF *, linenr_t));
 static void	free_buf_winlnum __ARGS((BUF *buf));
 static int	append_arg_number __ARGS((char_u *, int, int));
@@ -890,6 +890,7 @@ buflist_findpat(pattern, pattern_end)
 {
     BUF		*buf;
     vim_regexp	*prog;
+    REGEXEC	rex;
     int		fnum = -1;
     char_u	*pat;
     char_u	*match;
@@ -931,9 +932,10 @@ buflist_findpat(pattern, pattern_end)
 	if (prog == NULL)
 	    return -1;
 
+	vim_regexec_init(&rex, reg_ic);
 	for (buf = firstbuf; buf != NULL; buf = buf->b_next)
 	{
-	    match = buflist_match(prog, buf);
+	    match = buflist_match(&rex, prog, buf);
 	    if (match != NULL)
 	    {
 		if (fnum >= 0)		/* already found a match */
@@ -944,7 +946,8 @@ buflist_findpat(pattern, pattern_end)
 		fnum = buf->b_fnum;	/* remember first match */
 	    }
 	}
-	vim_free(prog);
+	vim_regexec_free(&rex);
+	vim_regfree(prog);
 	if (fnum >= 0)			/* found one match */
 	    break;
     }
@@ -974,6 +977,7 @@ ExpandBufnames(pat, num_file, file, options)
     char_u	*p;
     int		attempt;
     vim_regexp	*prog;
+    REGEXEC	rex;
 
     *num_file = 0;		    /* return values in case of FAIL */
     *file = NULL;
@@ -993,6 +997,7 @@ ExpandBufnames(pat, num_file, file, options)
 	prog = vim_regcomp(pat, (int)p_magic);
 	if (prog == NULL)
 	    return FAIL;
+	vim_regexec_init(&rex, reg_ic);
 
 	/*
 	 * round == 1: Count the matches.
@@ -1003,7 +1008,7 @@ ExpandBufnames(pat, num_file, file, options)
 	    count = 0;
 	    for (buf = firstbuf; buf != NULL; buf = buf->b_next)
 	    {
-		p = buflist_match(prog, buf);
+		p = buflist_match(&rex, prog, buf);
 		if (p != NULL)
 		{
 		    if (round == 1)
@@ -1025,12 +1030,14 @@ ExpandBufnames(pat, num_file, file, options)
 		*file = (char_u **)alloc((unsigned)(count * sizeof(char_u *)));
 		if (*file == NULL)
 		{
-		    vim_free(prog);
+		    vim_regexec_free(&rex);
+		    vim_regfree(prog);
 		    return FAIL;
 		}
 	    }
 	}
-	vim_free(prog);
+	vim_regexec_free(&rex);
+	vim_regfree(prog);
 	if (count)		/* match(es) found, break here */
 	    break;
     }
@@ -1040,34 +1047,32 @@ ExpandBufnames(pat, num_file, file, options)
 }
 
 /*
- * Check for a match on the file name for buffer "buf" with regex prog "prog".
+ * Check for a match on the file name for buffer "buf" with regex prog "prog",
+ * using context "rex".
  */
     static char_u *
-buflist_match(prog, buf)
+buflist_match(rex, prog, buf)
+    REGEXEC	*rex;
     vim_regexp	*prog;
     BUF		*buf;
 {
     char_u  *match;
-#ifdef CASE_INSENSITIVE_FILENAME
-    int	    save_reg_ic = reg_ic;
 
-    reg_ic = TRUE;		/* Always ignore case */
+#ifdef CASE_INSENSITIVE_FILENAME
+    rex->rx_ic = TRUE;		/* Always ignore case */
 #endif
 
     /* First try the short file name, then the long file name. */
-    match = buflist_match_try(prog, buf->b_sfname);
+    match = buflist_match_try(rex, prog, buf->b_sfname);
     if (match == NULL)
-	match = buflist_match_try(prog, buf->b_ffname);
-
-#ifdef CASE_INSENSITIVE_FILENAME
-    reg_ic = save_reg_ic;
-#endif
+	match = buflist_match_try(rex, prog, buf->b_ffname);
 
     return match;
 }
 
     static char_u *
-buflist_match_try(prog, name)
+buflist_match_try(rex, prog, name)
+    REGEXEC	*rex;
     vim_regexp	*prog;
     char_u	*name;
 {
@@ -1076,13 +1081,13 @@ buflist_match_try(prog, name)
 
     if (name != NULL)
     {
-	if (vim_regexec(prog, name, TRUE) != 0)
+	if (vim_regexec(rex, prog, name, TRUE) != 0)
 	    match = name;
 	else
 	{
 	    /* Replace $(HOME) with '~' and try matching again. */
 	    p = home_replace_save(NULL, name);
-	    if (p != NULL && vim_regexec(prog, p, TRUE) != 0)
+	    if (p != NULL && vim_regexec(rex, prog, p, TRUE) != 0)
 		match = name;
 	    vim_free(p);
 	}
@@ -2064,6 +2069,12 @@ do_modelines()
 	if (chk_modeline(lnum) == FAIL)
 	    nmlines = 0;
 
+#ifdef LAZY_READ
+    /* the last lines are not there yet, read_rest() calls us again */
+    if (read_rest_busy(curbuf))
+	return;
+#endif
+
     for (lnum = curbuf->b_ml.ml_line_count; lnum > 0 && lnum > nmlines &&
 			  lnum > curbuf->b_ml.ml_line_count - nmlines; --lnum)
 	if (chk_modeline(lnum) == FAIL)
@@ -37,6 +37,8 @@ init_chartab()
     int	    tilde;
     int	    do_isalpha;
 
+    ++chartab_tick;	/* vim_regexec() may have used the old flags */
+
     /*
      * Set the default size for printable characters:
      * From <Space> to '~' is 1 (printable), others are 2 (not printable).
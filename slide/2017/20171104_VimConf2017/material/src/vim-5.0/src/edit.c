@@ -1474,6 +1474,7 @@ complete_dictionaries(dict, pat, dir, flags)
     int		at_start;
     FILE	*fp;
     vim_regexp	*prog;
+    REGEXEC	rex;
     int		add_r;
     char_u	**files;
     int		count;
@@ -1482,6 +1483,7 @@ complete_dictionaries(dict, pat, dir, flags)
     buf = alloc(LSIZE);
     set_reg_ic(pat);	/* set reg_ic according to p_ic, p_scs and pat */
     prog = vim_regcomp(pat, (int)p_magic);
+    vim_regexec_init(&rex, reg_ic);
     expand_interactively = TRUE;
     while (buf && prog && *dict != NUL && !got_int)
     {
@@ -1512,14 +1514,14 @@ complete_dictionaries(dict, pat, dir, flags)
 		{
 		    ptr = buf;
 		    at_start = TRUE;
-		    while (vim_regexec(prog, ptr, at_start))
+		    while (vim_regexec(&rex, prog, ptr, at_start))
 		    {
 			at_start = FALSE;
-			ptr = prog->startp[0];
+			ptr = rex.rx_startp[0];
 			while (vim_iswordc(*ptr))
 			    ++ptr;
-			add_r = add_completion_and_infercase(prog->startp[0],
-				(int)(ptr - prog->startp[0]), files[i], dir, 0);
+			add_r = add_completion_and_infercase(rex.rx_startp[0],
+			      (int)(ptr - rex.rx_startp[0]), files[i], dir, 0);
 			if (add_r == OK)
 			    /* if dir was BACKWARD then honor it just once */
 			    dir = FORWARD;
@@ -1537,7 +1539,8 @@ complete_dictionaries(dict, pat, dir, flags)
 	    break;
     }
     expand_interactively = FALSE;
-    vim_free(prog);
+    vim_regexec_free(&rex);
+    vim_regfree(prog);
     vim_free(buf);
 }
 
@@ -588,6 +588,7 @@ eval3(arg, retvar)
     char_u		*s1, *s2;
     char_u		buf1[NUMBUFLEN], buf2[NUMBUFLEN];
     vim_regexp		*prog;
+    REGEXEC		rex;
 
     /*
      * Get the first variable.
@@ -678,12 +679,13 @@ eval3(arg, retvar)
 		case TYPE_SMALLER:  n1 = (i < 0); break;
 		case TYPE_SEQUAL:   n1 = (i <= 0); break;
 		case TYPE_MATCH:
-		case TYPE_NOMATCH:  reg_ic = p_ic;
-				    prog = vim_regcomp(s2, TRUE);
+		case TYPE_NOMATCH:  prog = vim_regcomp(s2, TRUE);
 				    if (prog != NULL)
 				    {
-					n1 = vim_regexec(prog, s1, TRUE);
-					vim_free(prog);
+					vim_regexec_init(&rex, p_ic);
+					n1 = vim_regexec(&rex, prog, s1, TRUE);
+					vim_regexec_free(&rex);
+					vim_regfree(prog);
 					if (type == TYPE_NOMATCH)
 					    n1 = !n1;
 				    }
@@ -1679,6 +1681,9 @@ f_has(argvars, retvar)
 #ifdef HAVE_LANGMAP
 	"langmap",
 #endif
+#ifdef LAZY_READ
+	"lazyread",
+#endif
 #ifdef LISPINDENT
 	"lispindent",
 #endif
@@ -1714,6 +1719,9 @@ f_has(argvars, retvar)
 #ifdef SMARTINDENT
 	"smartindent",
 #endif
+#ifdef MMAP_SWAP
+	"swapmap",
+#endif
 #ifdef SYNTAX_HL
 	"syntax",
 #endif
@@ -1905,23 +1913,25 @@ f_some_match(argvars, retvar, start)
     char_u		*pat;
     int			n = -1;
     vim_regexp		*prog;
+    REGEXEC		rex;
     char_u		patbuf[NUMBUFLEN];
 
     str = get_var_string(&argvars[0]);
     pat = get_var_string_buf(&argvars[1], patbuf);
 
-    reg_ic = p_ic;
     prog = vim_regcomp(pat, TRUE);
     if (prog != NULL)
     {
-	if (vim_regexec(prog, str, TRUE))
+	vim_regexec_init(&rex, p_ic);
+	if (vim_regexec(&rex, prog, str, TRUE))
 	{
 	    if (start)
-		n = prog->startp[0] - str;
+		n = rex.rx_startp[0] - str;
 	    else
-		n = prog->endp[0] - str;
+		n = rex.rx_endp[0] - str;
 	}
-	vim_free(prog);
+	vim_regexec_free(&rex);
+	vim_regfree(prog);
     }
     retvar->var_val.var_number = n;
 }
@@ -2135,6 +2145,7 @@ f_substitute(argvars, retvar)
     char_u		*result = NULL;
     int			sublen;
     vim_regexp		*prog;
+    REGEXEC		rex;
     int			i;
     char_u		patbuf[NUMBUFLEN];
     char_u		subbuf[NUMBUFLEN];
@@ -2144,11 +2155,11 @@ f_substitute(argvars, retvar)
     sub = get_var_string_buf(&argvars[2], subbuf);
     /* flags = get_var_string_buf(&argvars[3], flagsbuf); */
 
-    reg_ic = p_ic;
     prog = vim_regcomp(pat, TRUE);
     if (prog != NULL)
     {
-	if (vim_regexec(prog, str, TRUE))
+	vim_regexec_init(&rex, p_ic);
+	if (vim_regexec(&rex, prog, str, TRUE))
 	{
 	    /*
 	     * Get some space for a temporary buffer to do the substitution
@@ -2157,17 +2168,18 @@ f_substitute(argvars, retvar)
 	     * - The substituted text.
 	     * - The text after the match.
 	     */
-	    sublen = vim_regsub(prog, sub, str, FALSE, TRUE);
+	    sublen = vim_regsub(&rex, sub, str, FALSE, TRUE);
 	    if ((result = alloc_check((unsigned)(STRLEN(str) + sublen
-			       - (prog->endp[0] - prog->startp[0])))) != NULL)
+			      - (rex.rx_endp[0] - rex.rx_startp[0])))) != NULL)
 	    {
-		i = prog->startp[0] - str;
+		i = rex.rx_startp[0] - str;
 		vim_memmove(result, str, (size_t)i);
-		(void)vim_regsub(prog, sub, result + i, TRUE, TRUE);
-		STRCAT(result, prog->endp[0]);
+		(void)vim_regsub(&rex, sub, result + i, TRUE, TRUE);
+		STRCAT(result, rex.rx_endp[0]);
 	    }
 	}
-	vim_free(prog);
+	vim_regexec_free(&rex);
+	vim_regfree(prog);
     }
     retvar->var_type = VAR_STRING;
     retvar->var_val.var_string = (result == NULL ? vim_strsave(str) : result);
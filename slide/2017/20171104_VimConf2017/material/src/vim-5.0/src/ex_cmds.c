@@ -1842,6 +1842,20 @@ static char_u	    *old_sub = NULL;	/* previous substitute pattern */
  */
 static long	    sub_nsubs;	    /* total number of substitutions */
 static linenr_t	    sub_nlines;	    /* total number of lines changed */
+static int	    sub_count_only; /* only counting matches ([n] flag) */
+
+/*
+ * Without confirmation the changed lines are not stored one by one, they are
+ * kept in a growarray and stored together: undo only needs to save them once
+ * for all of them.  At most SUB_BATCH lines are kept, a gap of more than
+ * SUB_GAP lines without a change also starts a new batch, because the
+ * unchanged lines in between are saved for undo as well.
+ */
+#define SUB_BATCH   1000
+#define SUB_GAP	    20
+
+static void do_sub_flush __ARGS((struct growarray *text_gap,
+						  struct growarray *lnum_gap));
 
 /* do_sub()
  *
@@ -1865,10 +1879,13 @@ do_sub(eap)
     char_u	   *ptr;
     char_u	   *old_line;
     vim_regexp	   *prog;
+    REGEXEC	    rex;
     static int	    do_all = FALSE;	/* do multiple substitutions per line */
     static int	    do_ask = FALSE;	/* ask for confirmation */
     int		    do_error = TRUE;	/* if false, ignore errors */
     int		    do_print = FALSE;	/* print last line with subst. */
+    int		    do_count = FALSE;	/* only count the matches */
+    FPOS	    old_cursor;
     char_u	   *pat = NULL, *sub = NULL;	/* init for GCC */
     int		    delimiter;
     int		    sublen;
@@ -1877,13 +1894,17 @@ do_sub(eap)
     int		    temp;
     int		    which_pat;
     char_u	    *cmd;
-    int		    save_reg_ic;
+    struct growarray text_ga;		/* text of changed lines, not stored */
+    struct growarray lnum_ga;		/* line numbers for text_ga */
+    char_u	    *sub_buf = NULL;	/* buffer for a changed line */
+    unsigned	    sub_buf_len = 0;
 
     cmd = eap->arg;
     if (!global_busy)
     {
 	sub_nsubs = 0;
 	sub_nlines = 0;
+	sub_count_only = FALSE;
     }
 
 #ifdef FKMAP		    /* reverse the flow of the Farsi characters */
@@ -1996,10 +2017,14 @@ do_sub(eap)
 	    which_pat = RE_LAST;
 	else if (*cmd == 'p')
 	    do_print = TRUE;
+	else if (*cmd == 'n')
+	    do_count = TRUE;
 	else
 	    break;
 	++cmd;
     }
+    if (do_count)
+	do_ask = FALSE;
 
     /*
      * check for a trailing count
@@ -2040,6 +2065,7 @@ do_sub(eap)
 	    emsg(e_invcmd);
 	return;
     }
+    vim_regexec_init(&rex, reg_ic);
 
     /*
      * ~ in the substitute pattern is replaced with the old pattern.
@@ -2047,12 +2073,39 @@ do_sub(eap)
      */
     sub = regtilde(sub, (int)p_magic);
 
+    if (do_count)
+    {
+	sub_count_only = TRUE;
+	old_cursor = curwin->w_cursor;
+    }
+
+    text_ga.ga_itemsize = 1;
+    text_ga.ga_growsize = 4000;
+    ga_init(&text_ga);
+    lnum_ga.ga_itemsize = sizeof(linenr_t);
+    lnum_ga.ga_growsize = 100;
+    ga_init(&lnum_ga);
+
     old_line = NULL;
     for (lnum = eap->line1; lnum <= eap->line2 && !(got_int || got_quit);
 								       ++lnum)
     {
+	/* Skip lines without a match quickly. */
+	lnum = ml_find_match(curbuf, lnum, eap->line2, FORWARD, &rex, prog);
+	if (got_int)
+	    break;
+
+	/* Store the changed lines when the gap would become too big. */
+	if (lnum_ga.ga_len > 0 && lnum - ((linenr_t *)lnum_ga.ga_data)
+						[lnum_ga.ga_len - 1] > SUB_GAP)
+	    do_sub_flush(&text_ga, &lnum_ga);
+
+	/* make a copy of the line, so it won't be taken away when updating
+	 * the screen */
 	ptr = ml_get(lnum);
-	if (vim_regexec(prog, ptr, TRUE))  /* a match on this line */
+	if ((old_line = vim_strsave(ptr)) == NULL)
+	    continue;
+	if (vim_regexec(&rex, prog, old_line, TRUE))  /* a match on the line */
 	{
 	    char_u	*new_end, *new_start = NULL;
 	    char_u	*old_match, *old_copy;
@@ -2063,16 +2116,10 @@ do_sub(eap)
 	    unsigned	len, needed_len;
 	    unsigned	new_start_len = 0;
 
-	    /* make a copy of the line, so it won't be taken away when updating
-		the screen */
-	    if ((old_line = vim_strsave(ptr)) == NULL)
-		continue;
-	    vim_regexec(prog, old_line, TRUE);	/* match again on this line to
-						 * update the pointers. TODO:
-						 * remove extra vim_regexec() */
 	    if (!got_match)
 	    {
-		setpcmark();
+		if (!do_count)
+		    setpcmark();
 		got_match = TRUE;
 	    }
 
@@ -2084,7 +2131,7 @@ do_sub(eap)
 		 * position (just like the real vi).
 		 */
 		curwin->w_cursor.lnum = lnum;
-		curwin->w_cursor.col = (int)(prog->startp[0] - old_line);
+		curwin->w_cursor.col = (int)(rex.rx_startp[0] - old_line);
 		changed_cline_bef_curs();
 
 		/*
@@ -2092,16 +2139,21 @@ do_sub(eap)
 		 * This reproduces the strange vi behaviour.
 		 * This also catches endless loops.
 		 */
-		if (old_match == prev_old_match && old_match == prog->endp[0])
+		if (old_match == prev_old_match && old_match == rex.rx_endp[0])
 		{
 		    ++old_match;
 		    goto skip;
 		}
-		old_match = prog->endp[0];
+		old_match = rex.rx_endp[0];
 		prev_old_match = old_match;
 
-		/* update_screen() may change reg_ic: save it */
-		save_reg_ic = reg_ic;
+		/* When only counting, the text is not changed. */
+		if (do_count)
+		{
+		    sub_nsubs++;
+		    did_sub = TRUE;
+		    goto skip;
+		}
 
 		/*
 		 * Loop until 'y', 'n', 'q', CTRL-E or CTRL-Y typed.
@@ -2110,7 +2162,7 @@ do_sub(eap)
 		{
 		    temp = RedrawingDisabled;
 		    RedrawingDisabled = FALSE;
-		    search_match_len = prog->endp[0] - prog->startp[0];
+		    search_match_len = rex.rx_endp[0] - rex.rx_startp[0];
 		    /* invert the matched string
 		     * remove the inversion afterwards */
 		    if (search_match_len == 0)
@@ -2167,19 +2219,24 @@ do_sub(eap)
 		if (got_quit)
 		    break;
 
-		reg_ic = save_reg_ic;
-
 		/* get length of substitution part */
-		sublen = vim_regsub(prog, sub, old_line, FALSE, (int)p_magic);
+		sublen = vim_regsub(&rex, sub, old_line, FALSE, (int)p_magic);
 		if (new_start == NULL)
 		{
 		    /*
 		     * Get some space for a temporary buffer to do the
 		     * substitution into (and some extra space to avoid
-		     * too many calls to alloc()/free()).
+		     * too many calls to alloc()/free()).  The buffer of the
+		     * previous line is used again when it is big enough.
 		     */
 		    new_start_len = STRLEN(old_copy) + sublen + 25;
-		    if ((new_start = alloc_check(new_start_len)) == NULL)
+		    if (sub_buf != NULL && sub_buf_len >= new_start_len)
+		    {
+			new_start = sub_buf;
+			new_start_len = sub_buf_len;
+			sub_buf = NULL;
+		    }
+		    else if ((new_start = alloc_check(new_start_len)) == NULL)
 			goto outofmem;
 		    *new_start = NUL;
 		    new_end = new_start;
@@ -2208,11 +2265,11 @@ do_sub(eap)
 		/*
 		 * copy the text up to the part that matched
 		 */
-		i = prog->startp[0] - old_copy;
+		i = rex.rx_startp[0] - old_copy;
 		vim_memmove(new_end, old_copy, (size_t)i);
 		new_end += i;
 
-		vim_regsub(prog, sub, new_end, TRUE, (int)p_magic);
+		vim_regsub(&rex, sub, new_end, TRUE, (int)p_magic);
 		sub_nsubs++;
 		did_sub = TRUE;
 
@@ -2227,6 +2284,7 @@ do_sub(eap)
 		{
 		    if (p1 == new_end || p1[-1] != Ctrl('V'))
 		    {
+			do_sub_flush(&text_ga, &lnum_ga);
 			if (u_inssub(lnum) == OK)   /* prepare for undo */
 			{
 			    *p1 = NUL;		    /* truncate up to the CR */
@@ -2247,7 +2305,7 @@ do_sub(eap)
 		}
 
 		/* remember next character to be copied */
-		old_copy = prog->endp[0];
+		old_copy = rex.rx_endp[0];
 		/*
 		 * continue searching after the match
 		 * prevent endless loop with patterns that match empty strings,
@@ -2256,8 +2314,8 @@ do_sub(eap)
 skip:
 		match = -1;
 		lastone = (*old_match == NUL || got_int || got_quit || !do_all);
-		if (lastone || do_ask ||
-		      (match = vim_regexec(prog, old_match, (int)FALSE)) == 0)
+		if (lastone || do_ask || (match = vim_regexec(&rex, prog,
+						  old_match, (int)FALSE)) == 0)
 		{
 		    if (new_start)
 		    {
@@ -2268,13 +2326,37 @@ skip:
 			 * changed the number of characters.
 			 */
 			STRCAT(new_start, old_copy);
+			if (!do_ask)
+			{
+			    /* Done with this line: keep the text with the
+			     * other changed lines and the buffer for the next
+			     * line. */
+			    len = STRLEN(new_start) + 1;
+			    if (ga_grow(&text_ga, (int)len) == FAIL
+				    || ga_grow(&lnum_ga, 1) == FAIL)
+				goto outofmem;
+			    vim_memmove((char_u *)text_ga.ga_data
+					     + text_ga.ga_len, new_start, len);
+			    text_ga.ga_len += len;
+			    text_ga.ga_room -= len;
+			    ((linenr_t *)lnum_ga.ga_data)[lnum_ga.ga_len] =
+									  lnum;
+			    ++lnum_ga.ga_len;
+			    --lnum_ga.ga_room;
+			    if (lnum_ga.ga_len >= SUB_BATCH)
+				do_sub_flush(&text_ga, &lnum_ga);
+			    vim_free(sub_buf);
+			    sub_buf = new_start;
+			    sub_buf_len = new_start_len;
+			    break;
+			}
 			i = old_line + STRLEN(old_line) - old_match;
+			do_sub_flush(&text_ga, &lnum_ga);
 			if (u_savesub(lnum) == OK)
 			    ml_replace(lnum, new_start, TRUE);
 			/* When asking, undo is saved each time, must also set
 			 * changed flag each time. */
-			if (do_ask)
-			    CHANGED;
+			CHANGED;
 
 			vim_free(old_line);	    /* free the temp buffer */
 			old_line = new_start;
@@ -2288,7 +2370,7 @@ skip:
 			old_copy = old_line;
 		    }
 		    if (match == -1 && !lastone)
-			match = vim_regexec(prog, old_match, (int)FALSE);
+			match = vim_regexec(&rex, prog, old_match, (int)FALSE);
 		    if (match <= 0)   /* quit loop if there is no more match */
 			break;
 		}
@@ -2297,9 +2379,9 @@ skip:
 	    }
 	    if (did_sub)
 		++sub_nlines;
-	    vim_free(old_line);	    /* free the copy of the original line */
-	    old_line = NULL;
 	}
+	vim_free(old_line);	    /* free the copy of the original line */
+	old_line = NULL;
 	line_breakcheck();
     }
     curbuf->b_op_start.lnum = eap->line1;
@@ -2307,16 +2389,31 @@ skip:
     curbuf->b_op_start.col = curbuf->b_op_end.col = 0;
 
 outofmem:
+    do_sub_flush(&text_ga, &lnum_ga);
+    ga_clear(&text_ga);
+    ga_clear(&lnum_ga);
+    vim_free(sub_buf);
     vim_free(old_line);	    /* may have to free an allocated copy of the line */
+    if (do_count)
+    {
+	curwin->w_cursor = old_cursor;	/* the cursor doesn't move */
+	changed_cline_bef_curs();
+    }
     if (sub_nsubs)
     {
-	CHANGED;
-	approximate_botline();
+	if (!do_count)
+	{
+	    CHANGED;
+	    approximate_botline();
+	}
 	if (!global_busy)
 	{
-	    update_topline();
-	    beginline(BL_WHITE | BL_FIX);
-	    update_screen(NOT_VALID); /* need this to update LineSizes */
+	    if (!do_count)
+	    {
+		update_topline();
+		beginline(BL_WHITE | BL_FIX);
+		update_screen(NOT_VALID); /* need this to update LineSizes */
+	    }
 	    if (!do_sub_msg() && do_ask)
 		MSG("");
 	}
@@ -2336,7 +2433,36 @@ outofmem:
 	}
     }
 
-    vim_free(prog);
+    vim_regexec_free(&rex);
+    vim_regfree(prog);
+}
+
+/*
+ * Store the changed lines kept by do_sub() in the buffer: "text_gap" has the
+ * text of the lines, "lnum_gap" their line numbers.  The lines from the first
+ * to the last one are saved for undo together.
+ */
+    static void
+do_sub_flush(text_gap, lnum_gap)
+    struct growarray	*text_gap;
+    struct growarray	*lnum_gap;
+{
+    linenr_t	*lnums = (linenr_t *)lnum_gap->ga_data;
+    char_u	*p = (char_u *)text_gap->ga_data;
+    int		i;
+
+    if (lnum_gap->ga_len == 0)
+	return;
+    if (u_savesublines(lnums[0], lnums[lnum_gap->ga_len - 1]) == OK)
+	for (i = 0; i < lnum_gap->ga_len; ++i)
+	{
+	    ml_replace(lnums[i], p, TRUE);
+	    p += STRLEN(p) + 1;
+	}
+    text_gap->ga_room += text_gap->ga_len;
+    text_gap->ga_len = 0;
+    lnum_gap->ga_room += lnum_gap->ga_len;
+    lnum_gap->ga_len = 0;
 }
 
 /*
@@ -2349,17 +2475,19 @@ do_sub_msg()
 {
     /*
      * Only report substitutions when:
-     * - more than 'report' substitutions
+     * - more than 'report' substitutions, or only counting matches
      * - command was typed by user, or number of changed lines > 'report'
      * - giving messages is not disabled by 'lazyredraw'
      */
-    if (sub_nsubs > p_report &&
-	    (KeyTyped || sub_nlines > 1 || p_report < 1) &&
+    if ((sub_count_only || (sub_nsubs > p_report &&
+		(KeyTyped || sub_nlines > 1 || p_report < 1))) &&
 	    messaging())
     {
-	sprintf((char *)msg_buf, "%s%ld substitution%s on %ld line%s",
+	sprintf((char *)msg_buf, "%s%ld %s on %ld line%s",
 		got_int ? "(Interrupted) " : "",
-		sub_nsubs, plural(sub_nsubs),
+		sub_nsubs, sub_count_only
+			? (sub_nsubs == 1 ? "match" : "matches")
+			: (sub_nsubs == 1 ? "substitution" : "substitutions"),
 		(long)sub_nlines, plural((long)sub_nlines));
 	if (msg(msg_buf))
 	{
@@ -2407,6 +2535,7 @@ do_glob(eap)
     char_u	    delim;	/* delimiter, normally '/' */
     char_u	   *pat;
     vim_regexp	   *prog;
+    REGEXEC	    rex;
     int		    match;
     int		    which_pat;
 
@@ -2421,6 +2550,7 @@ do_glob(eap)
     which_pat = RE_LAST;	    /* default: use last used regexp */
     sub_nsubs = 0;
     sub_nlines = 0;
+    sub_count_only = FALSE;
 
     /*
      * undocumented vi feature:
@@ -2472,11 +2602,17 @@ do_glob(eap)
 /*
  * pass 1: set marks for each (not) matching line
  */
+    vim_regexec_init(&rex, reg_ic);
     ndone = 0;
     for (lnum = eap->line1; lnum <= eap->line2 && !got_int; ++lnum)
     {
+	/* for ":g" quickly skip over lines without a match */
+	if (type == 'g')
+	    lnum = ml_find_match(curbuf, lnum, eap->line2, FORWARD,
+								  &rex, prog);
+
 	/* a match on this line? */
-	match = vim_regexec(prog, ml_get(lnum), (int)TRUE);
+	match = vim_regexec(&rex, prog, ml_get(lnum), (int)TRUE);
 	if ((type == 'g' && match) || (type == 'v' && !match))
 	{
 	    ml_setmarked(lnum);
@@ -2484,6 +2620,7 @@ do_glob(eap)
 	}
 	line_breakcheck();
     }
+    vim_regexec_free(&rex);
 
 /*
  * pass 2: execute the command for each line that has been marked
@@ -2531,7 +2668,7 @@ do_glob(eap)
     }
 
     ml_clearmarked();	   /* clear rest of the marks */
-    vim_free(prog);
+    vim_regfree(prog);
 }
 
 #ifdef VIMINFO
@@ -230,6 +230,7 @@ enum CMD_index
     EXCMD(CMD_redo,	"redo",		TRLBAR),
     EXCMD(CMD_redir,	"redir",	BANG+FILES+TRLBAR),
     EXCMD(CMD_registers,"registers",	EXTRA+NOTRLCOM+TRLBAR),
+    EXCMD(CMD_regcache,	"regcache",	BANG+TRLBAR),
     EXCMD(CMD_resize,	"resize",	TRLBAR+WORD1),
     EXCMD(CMD_retab,	"retab",	TRLBAR+RANGE+DFLALL+BANG+WORD1),
     EXCMD(CMD_right,	"right",	TRLBAR+RANGE+EXTRA),
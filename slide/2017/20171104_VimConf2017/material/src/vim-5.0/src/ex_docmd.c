@@ -638,6 +638,12 @@ do_one_cmd(cmdlinep, sourcing,
 	goto skip_address;
 #endif
 
+#ifdef LAZY_READ
+    /* a range may use lines of a file that is still being loaded */
+    if (read_rest_busy(curbuf) && !isalpha(*ea.cmd))
+	read_rest(FALSE);
+#endif
+
     /* repeat for all ',' or ';' separated addresses */
     for (;;)
     {
@@ -815,6 +821,12 @@ skip_address:
  */
     argt = cmdnames[ea.cmdidx].cmd_argt;
 
+#ifdef LAZY_READ
+    /* a command that works on lines needs all of them */
+    if (read_rest_busy(curbuf) && (argt & RANGE) && !(argt & NOTADR))
+	read_rest(FALSE);
+#endif
+
     if (!(argt & RANGE) && ea.addr_count)	/* no range allowed */
     {
 	errormsg = e_norange;
@@ -1785,6 +1797,10 @@ skip_address:
 		do_dis(ea.arg);
 		break;
 
+	case CMD_regcache:
+		do_regcache(ea.forceit);
+		break;
+
 	case CMD_help:
 		do_help(&ea);
 		break;
@@ -4504,6 +4520,8 @@ do_swapname()
 	MSG("No swap file");
     else
 	msg(curbuf->b_ml.ml_mfp->mf_fname);
+    if (p_verbose > 0 && curbuf->b_ml.ml_mfp != NULL)
+	mf_statistics(curbuf->b_ml.ml_mfp);
 }
 
     static void
@@ -2014,7 +2014,7 @@ ExpandFromContext(pat, num_file, file, files_only, options)
     else
 	ret = FAIL;
 
-    vim_free(prog);
+    vim_regfree(prog);
     return ret;
 }
 
@@ -2038,6 +2038,9 @@ ExpandGeneric(prog, num_file, file, func)
     int count = 0;
     int	loop;
     char_u  *str;
+    REGEXEC rex;
+
+    vim_regexec_init(&rex, reg_ic);
 
     /* do this loop twice:
      * loop == 0: count the number of matching names
@@ -2053,7 +2056,7 @@ ExpandGeneric(prog, num_file, file, func)
 	    if (*str == NUL)	    /* skip empty strings */
 		continue;
 
-	    if (vim_regexec(prog, str, TRUE))
+	    if (vim_regexec(&rex, prog, str, TRUE))
 	    {
 		if (loop)
 		    (*file)[count] = vim_strsave_escaped(str,
@@ -2064,17 +2067,19 @@ ExpandGeneric(prog, num_file, file, func)
 	if (loop == 0)
 	{
 	    if (count == 0)
-		return OK;
+		break;
 	    *num_file = count;
 	    *file = (char_u **)alloc((unsigned)(count * sizeof(char_u *)));
 	    if (*file == NULL)
 	    {
 		*file = (char_u **)"";
+		vim_regexec_free(&rex);
 		return FAIL;
 	    }
 	    count = 0;
 	}
     }
+    vim_regexec_free(&rex);
     return OK;
 }
 
@@ -219,6 +219,25 @@
 # define SYNTAX_HL
 #endif
 
+/*
+ * +swapmap		When MMAP_SWAP defined: Support for the 'swapmap'
+ *			option, access the swap file with mmap().  Only
+ *			possible when the system has mmap().
+ */
+#if defined(UNIX) && defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+# define MMAP_SWAP
+#endif
+
+/*
+ * +lazyread		When LAZY_READ defined: Support for the 'lazyread'
+ *			option, a big file that is edited read-only is not
+ *			copied into the swap file, unchanged lines are read
+ *			from the file again when needed.
+ */
+#if defined(UNIX) && SIZEOF_INT > 2
+# define LAZY_READ
+#endif
+
 /*
  * +sniff		When USE_SNIFF defined: Include support for Sniff
  *			interface.  This needs to be defined in the Makefile.
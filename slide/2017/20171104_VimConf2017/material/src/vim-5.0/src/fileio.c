@@ -29,7 +29,14 @@
 #endif
 
 #define BUFSIZE	    8192	    /* size of normal write buffer */
+#if SIZEOF_INT > 2
+# define BIGBUFSIZE 0x40000L	    /* size of write buffer for big files */
+#else
+# define BIGBUFSIZE BUFSIZE
+#endif
 #define SMBUFSIZE    256	    /* size of emergency write buffer */
+#define SAMPLESIZE  0x8000L	    /* part of file used to guess line length */
+#define RESTSIZE    0x10000L	    /* size of buffer for read_rest() */
 
 #ifdef VIMINFO
 static void check_marks_read __ARGS((void));
@@ -37,17 +44,35 @@ static void check_marks_read __ARGS((void));
 #ifdef UNIX
 static void set_file_time __ARGS((char_u *fname, time_t atime, time_t mtime));
 #endif
+static long guess_line_len __ARGS((int fd));
+static char_u *skip_text __ARGS((char_u *p, char_u *end, int fileformat));
 static void msg_add_fname __ARGS((BUF *, char_u *));
 static int msg_add_fileformat __ARGS((int eol_type));
 static void msg_add_lines __ARGS((int, long, long));
 static void msg_add_eol __ARGS((void));
 static int check_mtime __ARGS((BUF *buf, struct stat *s));
 static int  write_buf __ARGS((int, char_u *, int));
+#ifdef LAZY_READ
+static void read_rest_start __ARGS((BUF *, int, long, int));
+static void read_rest_modelines __ARGS((BUF *));
+#endif
 
 static linenr_t	write_no_eol_lnum = 0;	/* non-zero lnum when last line of
 					   next binary write should not have
 					   an end-of-line */
 
+#ifdef LAZY_READ
+/*
+ * A big file that is read lazily is loaded in two steps: readfile() stops
+ * after a screenful of lines, read_rest() adds the other lines later.  This
+ * is what the second step needs, it is done for one buffer at a time.
+ */
+static BUF	*rest_buf = NULL;	/* buffer being loaded or NULL */
+static int	rest_fd;		/* file to read the rest from */
+static long	rest_offset;		/* file offset of the next line */
+static int	rest_fileformat;	/* EOL_UNIX, EOL_DOS or EOL_MAC */
+#endif
+
     void
 filemess(buf, name, s, attr)
     BUF		*buf;
@@ -74,6 +99,8 @@ filemess(buf, name, s, attr)
  * 1. We allocate blocks with lalloc, as big as possible.
  * 2. Each block is filled with characters from the file with a single read().
  * 3. The lines are inserted in the buffer with ml_append().
+ * 4. For a big file that is read lazily we stop after a screenful of lines,
+ *    read_rest() loads the other lines later.
  *
  * (caller must check that fname != NULL, unless READ_STDIN is used)
  *
@@ -112,7 +139,13 @@ readfile(fname, sfname, from, lines_to_skip, lines_to_read, flags)
     long	size;
     char_u	*p;
     long	filesize;
+    long	buf_offset = 0;		/* file offset of buffer[0] */
     int		split = 0;		/* number of split lines */
+    int		bulk;			/* using ml_bulk_append() */
+#ifdef LAZY_READ
+    int		lazy;			/* lines are read lazily */
+    int		read_later = FALSE;	/* read_rest() loads the rest */
+#endif
 #define UNKNOWN	 0x0fffffff		/* file size is unknown */
     linenr_t	linecnt;
     int		error = FALSE;		/* errors encountered */
@@ -322,6 +355,13 @@ readfile(fname, sfname, from, lines_to_skip, lines_to_read, flags)
     if (newfile)
 	curbuf->b_p_eol = TRUE;
 
+    /*
+     * Before the swap file is created, use the first part of the file to
+     * select the page size for the swap file.  Long lines need big pages.
+     */
+    if (newfile && !filtering && !read_stdin)
+	ml_page_size(guess_line_len(fd));
+
     check_need_swap(newfile);	/* may create swap file now */
 
 #ifndef UNIX
@@ -402,6 +442,11 @@ readfile(fname, sfname, from, lines_to_skip, lines_to_read, flags)
     linecnt = curbuf->b_ml.ml_line_count;
 
 retry:
+    /* when editing a file load the lines in one go, much faster */
+    bulk = (newfile && ml_bulk_start() == OK);
+#ifdef LAZY_READ
+    lazy = FALSE;
+#endif
     linerest = 0;
     filesize = 0;
     skip_count = lines_to_skip;
@@ -456,6 +501,7 @@ retry:
 		break;
 	    }
 	    filesize += size;		    /* count the number of characters */
+	    buf_offset = filesize - size - linerest;
 
 	    /*
 	     * when reading the first part of a file: guess EOL type
@@ -489,6 +535,17 @@ retry:
 		if (newfile)
 		    set_fileformat(fileformat);
 	    }
+
+#ifdef LAZY_READ
+	    /*
+	     * A big file that is edited read-only doesn't need to be copied,
+	     * the lines can be read from the file again when needed.
+	     */
+	    if (bulk && filesize == size && curbuf->b_p_ro && !filtering
+		    && !read_stdin && lines_to_skip == 0
+		    && lines_to_read == MAXLNUM)
+		lazy = (ml_bulk_lazy(fname, fd, fileformat) == OK);
+#endif
 	}
 
 	/*
@@ -500,9 +557,14 @@ retry:
 	    --ptr;
 	    while (++ptr, --size >= 0)
 	    {
-		/* catch most common case first */
+		/* catch most common case first, skip the rest of the text */
 		if ((c = *ptr) != NUL && c != CR && c != NL)
+		{
+		    p = skip_text(ptr + 1, ptr + size + 1, EOL_MAC);
+		    size -= p - ptr - 1;
+		    ptr = p - 1;
 		    continue;
+		}
 		if (c == NUL)
 		    *ptr = NL;	/* NULs are replaced by newlines! */
 		else
@@ -524,6 +586,8 @@ retry:
 					&& !read_stdin
 					&& lseek(fd, (off_t)0L, SEEK_SET) == 0)
 				{
+				    if (bulk)
+					(void)ml_bulk_end();
 				    while (lnum > from)
 					ml_delete(lnum--, FALSE);
 				    if (!try_unix || ptr[-1] == NUL)
@@ -540,7 +604,9 @@ retry:
 			}
 			*ptr = NUL;	    /* end of line */
 			len = ptr - line_start + 1;
-			if (ml_append(lnum, line_start, len, newfile) == FAIL)
+			if ((bulk ? ml_bulk_append(line_start, len,
+					 buf_offset + (long)(line_start - buffer))
+			     : ml_append(lnum, line_start, len, newfile)) == FAIL)
 			{
 			    error = TRUE;
 			    break;
@@ -565,7 +631,12 @@ retry:
 	    while (++ptr, --size >= 0)
 	    {
 		if ((c = *ptr) != NUL && c != NL)  /* catch most common case */
+		{
+		    p = skip_text(ptr + 1, ptr + size + 1, fileformat);
+		    size -= p - ptr - 1;
+		    ptr = p - 1;
 		    continue;
+		}
 		if (c == NUL)
 		    *ptr = NL;	/* NULs are replaced by newlines! */
 		else
@@ -576,7 +647,7 @@ retry:
 			len = ptr - line_start + 1;
 			if (fileformat == EOL_DOS)
 			{
-			    if (ptr[-1] == CR)	/* remove CR */
+			    if (ptr > line_start && ptr[-1] == CR)  /* remove CR */
 			    {
 				ptr[-1] = NUL;
 				--len;
@@ -593,6 +664,8 @@ retry:
 					&& !read_stdin
 					&& lseek(fd, (off_t)0L, SEEK_SET) == 0)
 				{
+				    if (bulk)
+					(void)ml_bulk_end();
 				    while (lnum > from)
 					ml_delete(lnum--, FALSE);
 				    fileformat = EOL_UNIX;
@@ -604,7 +677,9 @@ retry:
 				    ff_error = EOL_DOS;
 			    }
 			}
-			if (ml_append(lnum, line_start, len, newfile) == FAIL)
+			if ((bulk ? ml_bulk_append(line_start, len,
+					 buf_offset + (long)(line_start - buffer))
+			     : ml_append(lnum, line_start, len, newfile)) == FAIL)
 			{
 			    error = TRUE;
 			    break;
@@ -625,6 +700,22 @@ retry:
 	}
 	linerest = ptr - line_start;
 	ui_breakcheck();
+
+#ifdef LAZY_READ
+	/*
+	 * When a screenful of lines of a lazily read file is there, the rest
+	 * is loaded later.  Not when the file format may still turn out to
+	 * be wrong, that would need starting all over again.
+	 */
+	if (lazy && !error && !got_int && lnum - from > Rows
+		&& (fileformat == EOL_UNIX
+		    || (fileformat == EOL_DOS && !try_unix)
+		    || (fileformat == EOL_MAC && !try_unix && !try_dos)))
+	{
+	    read_later = TRUE;
+	    break;
+	}
+#endif
     }
 
     /* not an error, max. number of lines reached */
@@ -636,19 +727,26 @@ retry:
      * complete the line ourselves.
      * In Dos format ignore a trailing CTRL-Z, unless 'binary' set.
      */
-    if (!error && !got_int && linerest != 0 &&
-	    !(!curbuf->b_p_bin && fileformat == EOL_DOS &&
+    if (!error && !got_int && linerest != 0
+#ifdef LAZY_READ
+	    && !read_later
+#endif
+	    && !(!curbuf->b_p_bin && fileformat == EOL_DOS &&
 		    *line_start == Ctrl('Z') && ptr == line_start + 1))
     {
 	if (newfile)		    /* remember for when writing */
 	    curbuf->b_p_eol = FALSE;
 	*ptr = NUL;
-	if (ml_append(lnum, line_start,
-			(colnr_t)(ptr - line_start + 1), newfile) == FAIL)
+	len = ptr - line_start + 1;
+	if ((bulk ? ml_bulk_append(line_start, len,
+					 buf_offset + (long)(line_start - buffer))
+			: ml_append(lnum, line_start, len, newfile)) == FAIL)
 	    error = TRUE;
 	else
 	    read_no_eol_lnum = ++lnum;
     }
+    if (bulk && ml_bulk_end() == FAIL)
+	error = TRUE;
     if (lnum != from && !newfile)   /* added at least one line */
 	CHANGED;
 
@@ -657,7 +755,12 @@ retry:
     if (newfile)
 	curbuf->b_start_ffc = *curbuf->b_p_ff;	/* remember 'fileformat' */
 
-    close(fd);			    /* errors are ignored */
+#ifdef LAZY_READ
+    if (read_later)		    /* read_rest() continues with "fd" */
+	read_rest_start(curbuf, fd, filesize - linerest, fileformat);
+    else
+#endif
+	close(fd);		    /* errors are ignored */
     vim_free(buffer);
 
     --no_wait_return;		    /* may wait for return now */
@@ -760,6 +863,13 @@ retry:
 		STRCAT(IObuff, "[READ ERRORS]");
 		c = TRUE;
 	    }
+#ifdef LAZY_READ
+	    if (read_later)
+	    {
+		STRCAT(IObuff, "[loading]");
+		c = TRUE;
+	    }
+#endif
 	    if (msg_add_fileformat(fileformat))
 		c = TRUE;
 	    msg_add_lines(c, (long)linecnt, filesize);
@@ -835,6 +945,284 @@ retry:
     return OK;
 }
 
+#ifdef LAZY_READ
+/*
+ * Remember that the lines of buffer 'buf' after file offset 'offset' are to
+ * be loaded later from file descriptor 'fd'.
+ */
+    static void
+read_rest_start(buf, fd, offset, fileformat)
+    BUF		*buf;
+    int		fd;
+    long	offset;
+    int		fileformat;
+{
+    read_rest(FALSE);		/* finish loading another buffer first */
+    rest_buf = buf;
+    rest_fd = fd;
+    rest_offset = offset;
+    rest_fileformat = fileformat;
+}
+
+/*
+ * Load the rest of the file for the buffer that readfile() only loaded
+ * partly.  The lines are split like readfile() does, but the text is not
+ * kept, the lines are read lazily.
+ * When 'typed' is TRUE stop when a character is typed.  The lines read so far
+ * are added to the buffer, the next call continues after them.
+ */
+    void
+read_rest(typed)
+    int		typed;
+{
+    BUF		*buf = rest_buf;
+    char_u	*buffer;
+    char_u	*p, *q;
+    long	size;
+    long	start;		/* file offset of the line being split */
+    long	len = 0;	/* length of that line so far */
+    long	n;
+    int		first = NUL;	/* first character of that line */
+    int		prev = NUL;	/* last character of that line */
+    int		c;
+    int		done = FALSE;
+    int		error = FALSE;
+
+    if (buf == NULL)
+	return;
+    if (ml_bulk_more(buf) == FAIL)
+    {
+	/* while another file is being read try again later */
+	if (buf->b_ml.ml_lazy_fd >= 0)
+	    return;
+	error = TRUE;
+    }
+
+    start = rest_offset;
+    buffer = NULL;
+    if (!error && ((buffer = alloc((unsigned)RESTSIZE)) == NULL
+		|| lseek(rest_fd, (off_t)start, SEEK_SET) != start))
+	error = TRUE;
+    while (!error && !(typed && ui_char_avail()))
+    {
+	if ((size = read(rest_fd, (char *)buffer, (size_t)RESTSIZE)) <= 0)
+	{
+	    if (size < 0)
+		error = TRUE;
+	    /*
+	     * If we get EOF in the middle of a line, complete the line
+	     * ourselves.  In Dos format ignore a trailing CTRL-Z, unless
+	     * 'binary' set.
+	     */
+	    else if (len > 0 && !(!buf->b_p_bin && rest_fileformat == EOL_DOS
+					    && first == Ctrl('Z') && len == 1))
+	    {
+		if (ml_bulk_append(NULL, (colnr_t)(len + 1), start) == FAIL)
+		    error = TRUE;
+		buf->b_p_eol = FALSE;
+	    }
+	    done = TRUE;
+	    break;
+	}
+
+	for (p = buffer; p < buffer + size; ++p)
+	{
+	    c = *p;
+	    if (c != NL && (c != CR || rest_fileformat != EOL_MAC))
+	    {
+		if (len == 0)
+		    first = c;
+		q = skip_text(p + 1, buffer + size, rest_fileformat);
+		len += q - p;
+		prev = q[-1];
+		p = q - 1;
+		continue;
+	    }
+	    n = len;
+	    if (c == NL && rest_fileformat == EOL_DOS && len > 0 && prev == CR)
+		--n;			/* remove CR */
+	    if (ml_bulk_append(NULL, (colnr_t)(n + 1), start) == FAIL)
+	    {
+		error = TRUE;
+		break;
+	    }
+	    start += len + 1;
+	    len = 0;
+	}
+    }
+    vim_free(buffer);
+    if (ml_bulk_end() == FAIL)
+	error = TRUE;
+
+    rest_offset = start;
+    if (done || error)
+    {
+	close(rest_fd);
+	rest_buf = NULL;
+	if (error)
+	{
+	    buf->b_p_ro = TRUE;	/* with errors we should not write the file */
+	    EMSG2("Error while loading \"%s\", not all lines were read",
+								 buf->b_fname);
+	}
+	else
+	    read_rest_modelines(buf);
+    }
+}
+
+/*
+ * Check the modelines of buffer "buf" after it was loaded.  The last lines
+ * were not there when readfile() did this.  The user may have gone to
+ * another buffer meanwhile.  Like ":doautoall" the current window is set to
+ * a window for "buf" for a moment, or "buf" is put in the current window.
+ */
+    static void
+read_rest_modelines(buf)
+    BUF		*buf;
+{
+    BUF		*save_win_buf = NULL;
+    WIN		*save_curwin = curwin;
+    WIN		*win;
+
+    if (buf == curbuf)
+    {
+	do_modelines();
+	return;
+    }
+
+    for (win = firstwin; win != NULL; win = win->w_next)
+	if (win->w_buffer == buf)
+	    break;
+    if (win != NULL)
+	curwin = win;
+    else
+    {
+	--curwin->w_buffer->b_nwindows;
+	save_win_buf = curwin->w_buffer;
+	curwin->w_buffer = buf;
+	++buf->b_nwindows;
+    }
+    curbuf = buf;
+
+    do_modelines();
+
+    if (win != NULL)		    /* restore curwin */
+    {
+	if (win_valid(save_curwin))
+	    curwin = save_curwin;
+    }
+    else if (buf_valid(save_win_buf))	/* restore buffer for curwin */
+    {
+	--curwin->w_buffer->b_nwindows;
+	curwin->w_buffer = save_win_buf;
+	++curwin->w_buffer->b_nwindows;
+    }
+    curbuf = curwin->w_buffer;
+}
+
+/*
+ * Return TRUE if buffer 'buf' is still being loaded by read_rest().
+ */
+    int
+read_rest_busy(buf)
+    BUF		*buf;
+{
+    return (buf != NULL && buf == rest_buf);
+}
+
+/*
+ * Stop loading buffer 'buf', used when it is unloaded.
+ */
+    void
+read_rest_stop(buf)
+    BUF		*buf;
+{
+    if (read_rest_busy(buf))
+    {
+	close(rest_fd);
+	rest_buf = NULL;
+    }
+}
+#endif
+
+/*
+ * Return a pointer to the first NUL or NL at or after "p" and before "end",
+ * or "end" when there is none.  For Mac format CR also counts.
+ * This is where most of the time for reading a file goes.  Instead of one
+ * character at a time, a long is checked at once for a zero byte in it,
+ * after XOR-ing it with the characters looked for.
+ */
+    static char_u *
+skip_text(p, end, fileformat)
+    char_u	*p;
+    char_u	*end;
+    int		fileformat;
+{
+    long_u	ones = (long_u)-1 / 0xff;	/* 0x0101...01 */
+    long_u	highs = ones << 7;		/* 0x8080...80 */
+    long_u	nls = ones * NL;
+    long_u	crs = ones * (fileformat == EOL_MAC ? CR : NL);
+    long_u	w, x, y;
+
+    /* the first few characters, until "p" is aligned */
+    while (p < end && ((long_u)p & (sizeof(long_u) - 1)) != 0)
+    {
+	if (*p == NUL || *p == NL || (*p == CR && fileformat == EOL_MAC))
+	    return p;
+	++p;
+    }
+
+    while (end - p >= (long)sizeof(long_u))
+    {
+	w = *(long_u *)p;
+	x = w ^ nls;
+	y = w ^ crs;
+	if ((((w - ones) & ~w) | ((x - ones) & ~x) | ((y - ones) & ~y)) & highs)
+	    break;
+	p += sizeof(long_u);
+    }
+
+    while (p < end && *p != NUL && *p != NL
+				    && (*p != CR || fileformat != EOL_MAC))
+	++p;
+    return p;
+}
+
+/*
+ * Guess the average line length of the file "fd" from its first SAMPLESIZE
+ * bytes.  The file position is put back at the start.
+ * Returns zero when it can't be done, e.g. for a pipe.
+ */
+    static long
+guess_line_len(fd)
+    int		fd;
+{
+    char_u	*buf;
+    long	size;
+    long	nl = 0;
+    long	cr = 0;
+    long	i;
+
+    if (lseek(fd, (off_t)0L, SEEK_CUR) != 0)
+	return 0L;
+    if ((buf = lalloc((long_u)SAMPLESIZE, FALSE)) == NULL)
+	return 0L;
+    size = read(fd, (char *)buf, (size_t)SAMPLESIZE);
+    for (i = 0; i < size; ++i)
+    {
+	if (buf[i] == NL)
+	    ++nl;
+	else if (buf[i] == CR)
+	    ++cr;
+    }
+    vim_free(buf);
+    if (lseek(fd, (off_t)0L, SEEK_SET) != 0 || size <= 0)
+	return 0L;
+    if (nl == 0)	    /* Mac format or one long line */
+	nl = cr;
+    return size / (nl + 1);
+}
+
 #ifdef VIMINFO
     static void
 check_marks_read()
@@ -914,6 +1302,8 @@ buf_write(buf, fname, sfname, start, end, append, forceit,
     char_u	    *ptr;
     char_u	    c;
     int		    len;
+    int		    n;
+    long	    linelen;
     linenr_t	    lnum;
     long	    nchars;
     char_u	    *errmsg = NULL;
@@ -1081,16 +1471,27 @@ buf_write(buf, fname, sfname, start, end, append, forceit,
 		    (char_u *)"", 0);	/* show that we are busy */
     msg_scroll = FALSE;		    /* always overwrite the file message now */
 
-    buffer = alloc(BUFSIZE);
-    if (buffer == NULL)		    /* can't allocate big buffer, use small
+    /*
+     * A big buffer means fewer write() calls.  When memory is short use a
+     * smaller one.
+     */
+    buffer = NULL;
+    for (bufsize = BIGBUFSIZE; bufsize > BUFSIZE; bufsize >>= 1)
+	if ((buffer = lalloc((long_u)bufsize, FALSE)) != NULL)
+	    break;
+    if (buffer == NULL)
+    {
+	buffer = alloc(BUFSIZE);
+	if (buffer == NULL)	    /* can't allocate big buffer, use small
 				     * one (to be able to write when out of
 				     * memory) */
-    {
-	buffer = smallbuf;
-	bufsize = SMBUFSIZE;
+	{
+	    buffer = smallbuf;
+	    bufsize = SMBUFSIZE;
+	}
+	else
+	    bufsize = BUFSIZE;
     }
-    else
-	bufsize = BUFSIZE;
 
 #if defined(UNIX) && !defined(ARCHIE)
 	/* get information about original file (if there is one) */
@@ -1291,9 +1692,9 @@ buf_write(buf, fname, sfname, start, end, append, forceit,
 			mch_setperm(backup, (perm & 0707) | ((perm & 07) << 3));
 
 		    /* copy the file. */
-		    while ((buflen = read(fd, (char *)copybuf, BUFSIZE)) > 0)
+		    while ((buflen = read(fd, (char *)buffer, bufsize)) > 0)
 		    {
-			if (write_buf(bfd, copybuf, buflen) == FAIL)
+			if (write_buf(bfd, buffer, buflen) == FAIL)
 			{
 			    errmsg = (char_u *)"Can't write to backup file (use ! to override)";
 			    break;
@@ -1468,6 +1869,16 @@ nobackup:
     if (forceit && overwriting)
 	buf->b_p_ro = FALSE;
 
+#ifdef LAZY_READ
+    /*
+     * When a buffer reads lines lazily from the file that is going to be
+     * overwritten, they must be read now.  That includes the lines of a
+     * file that is still being loaded.
+     */
+    read_rest(FALSE);
+    ml_lazy_release(fname);
+#endif
+
     /*
      * If the original file is being overwritten, there is a small chance that
      * we crash in the middle of writing. Therefore the file is preserved now.
@@ -1559,18 +1970,30 @@ nobackup:
     for (lnum = start; lnum <= end; ++lnum)
     {
 	/*
-	 * The next while loop is done once for each character written.
-	 * Keep it fast!
+	 * The next while loop is done once for each piece of text up to a
+	 * newline.  Keep it fast!
 	 */
-	ptr = ml_get_buf(buf, lnum, FALSE) - 1;
-	while ((c = *++ptr) != NUL)
+	ptr = ml_get_buf(buf, lnum, FALSE);
+	linelen = STRLEN(ptr);
+	while (linelen > 0)
 	{
-	    if (c == NL)
-		*s = NUL;		/* replace newlines with NULs */
+	    n = bufsize - len;
+	    if (n > linelen)
+		n = linelen;
+	    n = skip_text(ptr, ptr + n, EOL_UNIX) - ptr;
+	    if (n > 0)
+	    {
+		vim_memmove(s, ptr, (size_t)n);
+		s += n;
+	    }
 	    else
-		*s = c;
-	    ++s;
-	    if (++len != bufsize)
+	    {
+		*s++ = NUL;		/* replace newlines with NULs */
+		n = 1;
+	    }
+	    ptr += n;
+	    linelen -= n;
+	    if ((len += n) != bufsize)
 		continue;
 	    if (write_buf(fd, buffer, bufsize) == FAIL)
 	    {
@@ -3674,12 +4097,19 @@ auto_next_pat(apc, stop_at_last)
 {
     AutoPat	    *ap;
     vim_regexp	    *prog;
+    REGEXEC	    rex;
     AutoCmd	    *cp;
     char_u	    *name;
 
     vim_free(sourcing_name);
     sourcing_name = NULL;
 
+#ifdef CASE_INSENSITIVE_FILENAME
+    vim_regexec_init(&rex, TRUE);		/* Always ignore case */
+#else
+    vim_regexec_init(&rex, FALSE);		/* Don't ever ignore case */
+#endif
+
     for (ap = apc->curpat; ap != NULL && !got_int; ap = ap->next)
     {
 	apc->curpat = NULL;
@@ -3689,11 +4119,6 @@ auto_next_pat(apc, stop_at_last)
 	if (ap->pat != NULL && ap->cmds != NULL
 		&& (apc->group == AUGROUP_ALL || apc->group == ap->group))
 	{
-#ifdef CASE_INSENSITIVE_FILENAME
-	    reg_ic = TRUE;			/* Always ignore case */
-#else
-	    reg_ic = FALSE;			/* Don't ever ignore case */
-#endif
 	    prog = vim_regcomp(ap->reg_pat, TRUE);	/* Always use magic */
 
 	    /*
@@ -3704,11 +4129,11 @@ auto_next_pat(apc, stop_at_last)
 	     */
 	    if (   prog != NULL
 		&& ((ap->allow_dirs
-			&& (vim_regexec(prog, apc->fname, TRUE)
+			&& (vim_regexec(&rex, prog, apc->fname, TRUE)
 			    || (apc->sfname != NULL
-				&& vim_regexec(prog, apc->sfname, TRUE))))
+			       && vim_regexec(&rex, prog, apc->sfname, TRUE))))
 		    || (!ap->allow_dirs
-			&& vim_regexec(prog, apc->tail, TRUE))))
+			&& vim_regexec(&rex, prog, apc->tail, TRUE))))
 	    {
 		name = event_nr2name(apc->event);
 		sourcing_name = alloc((unsigned)(STRLEN(name)
@@ -3729,7 +4154,7 @@ auto_next_pat(apc, stop_at_last)
 		    cp->last = FALSE;
 		cp->last = TRUE;
 	    }
-	    vim_free(prog);
+	    vim_regfree(prog);
 	    line_breakcheck();
 	    if (apc->curpat != NULL)	    /* found a match */
 		break;
@@ -3737,6 +4162,7 @@ auto_next_pat(apc, stop_at_last)
 	if (stop_at_last && ap->last)
 	    break;
     }
+    vim_regexec_free(&rex);
 }
 
 /*
@@ -994,6 +994,7 @@ closescript()
  *
  * All the changed memfiles are synced if c == 0 or when the number of typed
  * characters reaches 'updatecount' and 'updatecount' is non-zero.
+ * When c == 0 the syntax of the lines below the windows is parsed too.
  */
     void
 updatescript(c)
@@ -1008,6 +1009,10 @@ updatescript(c)
 	ml_sync_all(c == 0, TRUE);
 	count = 0;
     }
+#ifdef SYNTAX_HL
+    if (c == 0)
+	syntax_idle();		/* parse ahead while waiting */
+#endif
 }
 
 #define K_NEEDMORET -1		/* keylen value for incomplete key-code */
@@ -1774,6 +1779,12 @@ inchar(buf, maxlen, wait_time)
 	 */
 	out_flush();
 
+#ifdef LAZY_READ
+	/* while waiting for the user to type, load more of a big file */
+	if (wait_time != 0)
+	    read_rest(TRUE);
+#endif
+
 	/*
 	 * fill up to a third of the buffer, because each character may be
 	 * tripled below
@@ -363,6 +363,8 @@ EXTERN int	KeyStuffed;		/* TRUE if current char from stuffbuf */
 EXTERN int	maptick INIT(= 0);	/* tick for each non-mapped char */
 
 EXTERN char_u	chartab[256];		/* table used in charset.c */
+EXTERN int	chartab_tick INIT(= 0);	/* incremented when chartab[] or
+					   b_chartab[] changes */
 
 EXTERN int	must_redraw INIT(= 0);	    /* type of redraw necessary */
 EXTERN int	skip_redraw INIT(= FALSE);  /* skip redraw once */
@@ -383,7 +385,7 @@ EXTERN int	term_console INIT(= FALSE); /* set to TRUE when consule used */
 EXTERN int	termcap_active INIT(= FALSE);	/* set by starttermcap() */
 EXTERN int	bangredo INIT(= FALSE);	    /* set to TRUE whith ! command */
 EXTERN int	searchcmdlen;		    /* length of previous search cmd */
-EXTERN int	reg_ic INIT(= 0);	    /* p_ic passed to vim_regexec() */
+EXTERN int	reg_ic INIT(= 0);	    /* ignore case, see set_reg_ic() */
 EXTERN int	reg_syn INIT(= 0);	    /* vim_regexec() used for syntax */
 
 EXTERN int	did_outofmem_msg INIT(= FALSE);
@@ -29,6 +29,15 @@
  * Under normal operation the file is created when opening the memory file and
  * deleted when closing the memory file. Only with recovery an existing memory
  * file is opened.
+ *
+ * When 'swapmap' is set and mmap() is available, the file is mapped into
+ * memory. Blocks with a positive number that are in the file are then used
+ * directly from the mapping (BH_MAPPED): they are not read, they don't take
+ * memory from 'maxmem' and they don't need to be written when changed. Only
+ * blocks with a negative number and blocks that don't fit in the mapping
+ * have allocated memory, they are copied into the mapping when written.
+ * The mapping is made inside a large reserved range of addresses, so that it
+ * can grow without moving the blocks that are in use.
  */
 
 #if defined MSDOS || defined WIN32
@@ -72,6 +81,23 @@ extern int dos2;			/* this is in os_amiga.c */
 # endif
 #endif
 
+#ifdef MMAP_SWAP
+# include <sys/mman.h>
+# if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#  define MAP_ANONYMOUS MAP_ANON
+# endif
+# ifndef MAP_NORESERVE
+#  define MAP_NORESERVE 0
+# endif
+# ifndef MAP_FAILED
+#  define MAP_FAILED ((void *)-1)
+# endif
+#endif
+
+#ifdef USE_AIO_FSYNC
+# include <aio.h>
+#endif
+
 #define MEMFILE_PAGE_SIZE 4096		/* default page size */
 
 static long_u total_mem_used = 0;	/* total memory used for memfiles */
@@ -79,6 +105,14 @@ static long_u total_mem_used = 0;	/* total memory used for memfiles */
 static void mf_ins_hash __ARGS((MEMFILE *, BHDR *));
 static void mf_rem_hash __ARGS((MEMFILE *, BHDR *));
 static BHDR *mf_find_hash __ARGS((MEMFILE *, blocknr_t));
+static void mf_hash_init __ARGS((MF_HASHTAB *));
+static void mf_hash_free __ARGS((MF_HASHTAB *));
+static void *mf_hash_find __ARGS((MF_HASHTAB *, blocknr_t));
+static int  mf_hash_room __ARGS((MF_HASHTAB *));
+static void mf_hash_add __ARGS((MF_HASHTAB *, blocknr_t, void *));
+static void mf_hash_rem __ARGS((MF_HASHTAB *, blocknr_t));
+static int  mf_hash_grow __ARGS((MF_HASHTAB *));
+static void mf_hash_stats __ARGS((char *, MF_HASHTAB *));
 static void mf_ins_used __ARGS((MEMFILE *, BHDR *));
 static void mf_rem_used __ARGS((MEMFILE *, BHDR *));
 static BHDR *mf_release __ARGS((MEMFILE *, int));
@@ -90,6 +124,15 @@ static int  mf_read __ARGS((MEMFILE *, BHDR *));
 static int  mf_write __ARGS((MEMFILE *, BHDR *));
 static int  mf_trans_add __ARGS((MEMFILE *, BHDR *));
 static void mf_do_open __ARGS((MEMFILE *, char_u *, int));
+#ifdef MMAP_SWAP
+static void mf_map_init __ARGS((MEMFILE *));
+static char_u *mf_map_addr __ARGS((MEMFILE *, blocknr_t, int, int));
+static int  mf_map_grow __ARGS((MEMFILE *, long_u));
+static void mf_map_release __ARGS((MEMFILE *));
+#endif
+#ifdef USE_AIO_FSYNC
+static int  mf_sync_start __ARGS((MEMFILE *));
+#endif
 
 /*
  * The functions for using a memfile:
@@ -99,12 +142,17 @@ static void mf_do_open __ARGS((MEMFILE *, char_u *, int));
  * mf_close()	    close (and delete) a memfile
  * mf_new()	    create a new block in a memfile and lock it
  * mf_get()	    get an existing block and lock it
+ * mf_reserve()	    reserve a negative block number for mf_get_lazy()
+ * mf_get_lazy()    get a block that the caller fills and lock it
  * mf_put()	    unlock a block, may be marked for writing
  * mf_free()	    remove a block
  * mf_sync()	    sync changed parts of memfile to disk
+ * mf_sync_wait()   wait for a background sync to finish
  * mf_release_all() release as much memory as possible
  * mf_trans_del()   may translate negative to positive block number
  * mf_fullname()    make file name full path (use before first :cd)
+ * mf_statistics()  give a message about the hash tables
+ * mf_remap()	    map the swap file again after it was reopened
  */
 
 /*
@@ -125,7 +173,6 @@ mf_open(fname, trunc_file)
     int	    trunc_file;
 {
     MEMFILE	    *mfp;
-    int		    i;
     off_t	    size;
 #if defined(STATFS) && defined(UNIX) && !defined(__QNX__)
 # define USE_FSTATFS
@@ -158,12 +205,22 @@ mf_open(fname, trunc_file)
     mfp->mf_used_last = NULL;
     mfp->mf_dirty = FALSE;
     mfp->mf_used_count = 0;
-    for (i = 0; i < MEMHASHSIZE; ++i)
-    {
-	mfp->mf_hash[i] = NULL;		/* hash lists are empty */
-	mfp->mf_trans[i] = NULL;	/* trans lists are empty */
-    }
+    mf_hash_init(&mfp->mf_hash);	/* hash table is empty */
+    mf_hash_init(&mfp->mf_trans);	/* trans table is empty */
     mfp->mf_page_size = MEMFILE_PAGE_SIZE;
+#ifdef MMAP_SWAP
+    mfp->mf_map_base = NULL;
+    mfp->mf_map_max = 0;
+    mfp->mf_map_len = 0;
+    mfp->mf_map_count = 0;
+#endif
+#ifdef USE_AIO_FSYNC
+    mfp->mf_aiocb = NULL;
+    mfp->mf_aio_busy = FALSE;
+#endif
+#ifdef LAZY_READ
+    mfp->mf_lazy_count = 0;
+#endif
 
 #ifdef USE_FSTATFS
     /*
@@ -192,6 +249,43 @@ mf_open(fname, trunc_file)
     return mfp;
 }
 
+/*
+ * mf_set_page_size: change the number of bytes in a page of memfile "mfp".
+ *		     Used for a new memfile, or by recovery when block 0 says
+ *		     the swap file uses another size.  The data of blocks in
+ *		     memory is copied into buffers of the new size.
+ *
+ * return value: FAIL for failure, OK otherwise
+ */
+    int
+mf_set_page_size(mfp, page_size)
+    MEMFILE	*mfp;
+    unsigned	page_size;
+{
+    BHDR	*hp;
+    char_u	*p;
+    unsigned	len;
+
+#ifdef MMAP_SWAP
+    if (mfp->mf_map_base != NULL)	/* mapping uses the old page size */
+	return FAIL;
+#endif
+    len = page_size < mfp->mf_page_size ? page_size : mfp->mf_page_size;
+    for (hp = mfp->mf_used_first; hp != NULL; hp = hp->bh_next)
+    {
+	if ((p = alloc_clear(page_size * hp->bh_page_count)) == NULL)
+	    return FAIL;
+	vim_memmove(p, hp->bh_data, (size_t)(len * hp->bh_page_count));
+	vim_free(hp->bh_data);
+	hp->bh_data = p;
+	total_mem_used += hp->bh_page_count * page_size;
+	total_mem_used -= hp->bh_page_count * mfp->mf_page_size;
+    }
+    mfp->mf_page_size = page_size;
+    mfp->mf_used_count_max = p_mm * 1024 / mfp->mf_page_size;
+    return OK;
+}
+
 /*
  * mf_open_file: open a file for an existing memfile. Used when updatecount
  *		 set from 0 to some value.
@@ -212,6 +306,12 @@ mf_open_file(mfp, fname)
     if (mfp->mf_fd < 0)
 	return FAIL;
 
+#ifdef MMAP_SWAP
+    if (mfp->mf_map_base != NULL)	/* still mapped from a lost file */
+	mf_remap(mfp);
+    else if (p_smp)
+	mf_map_init(mfp);
+#endif
     mfp->mf_dirty = TRUE;
     return OK;
 }
@@ -225,13 +325,13 @@ mf_close(mfp, del_file)
     int	    del_file;
 {
     BHDR	*hp, *nextp;
-    NR_TRANS	*tp, *tpnext;
-    int		i;
+    long_u	i;
 
     if (mfp == NULL)		    /* safety check */
 	return;
     if (mfp->mf_fd >= 0)
     {
+	(void)mf_sync_wait(mfp);
 	if (close(mfp->mf_fd) < 0)
 	    EMSG("Close error on swap file");
     }
@@ -240,18 +340,25 @@ mf_close(mfp, del_file)
 					    /* free entries in used list */
     for (hp = mfp->mf_used_first; hp != NULL; hp = nextp)
     {
-	total_mem_used -= hp->bh_page_count * mfp->mf_page_size;
+	if (!(hp->bh_flags & BH_MAPPED))
+	    total_mem_used -= hp->bh_page_count * mfp->mf_page_size;
 	nextp = hp->bh_next;
 	mf_free_bhdr(hp);
     }
     while (mfp->mf_free_first != NULL)	    /* free entries in free list */
 	vim_free(mf_rem_free(mfp));
-    for (i = 0; i < MEMHASHSIZE; ++i)	    /* free entries in trans lists */
-	for (tp = mfp->mf_trans[i]; tp != NULL; tp = tpnext)
-	{
-	    tpnext = tp->nt_next;
-	    vim_free(tp);
-	}
+					    /* free entries in trans table */
+    for (i = 0; i <= mfp->mf_trans.mht_mask; ++i)
+	vim_free(mfp->mf_trans.mht_items[i].mhi_ptr);
+    mf_hash_free(&mfp->mf_hash);
+    mf_hash_free(&mfp->mf_trans);
+#ifdef MMAP_SWAP
+    if (mfp->mf_map_base != NULL)
+	munmap((char *)mfp->mf_map_base, (size_t)mfp->mf_map_max);
+#endif
+#ifdef USE_AIO_FSYNC
+    vim_free(mfp->mf_aiocb);
+#endif
     vim_free(mfp->mf_fname);
     vim_free(mfp->mf_ffname);
     vim_free(mfp);
@@ -272,6 +379,9 @@ mf_new(mfp, negative, page_count)
     BHDR    *freep;	    /* first block in free list */
     char_u  *p;
 
+    if (mf_hash_room(&mfp->mf_hash) == FAIL)
+	return NULL;
+
     /*
      * If we reached the maximum size for the used memory blocks, release one
      * If a BHDR is returned, use it and adjust the page_count if necessary.
@@ -334,7 +444,21 @@ mf_new(mfp, negative, page_count)
 	    mfp->mf_blocknr_max += page_count;
 	}
     }
-    hp->bh_flags = BH_LOCKED | BH_DIRTY;	/* new block is always dirty */
+#ifdef MMAP_SWAP
+    /*
+     * A block with a positive number can be used from the mapping right away,
+     * the allocated memory is not needed then.
+     */
+    if (!negative
+	       && (p = mf_map_addr(mfp, hp->bh_bnum, page_count, TRUE)) != NULL)
+    {
+	vim_free(hp->bh_data);
+	hp->bh_data = p;
+	hp->bh_flags = BH_LOCKED | BH_MAPPED;
+    }
+    else
+#endif
+	hp->bh_flags = BH_LOCKED | BH_DIRTY;	/* new block is always dirty */
     mfp->mf_dirty = TRUE;
     hp->bh_page_count = page_count;
     mf_ins_used(mfp, hp);
@@ -361,6 +485,9 @@ mf_get(mfp, nr, page_count)
     int		page_count;
 {
     BHDR    *hp;
+#ifdef MMAP_SWAP
+    char_u  *p;
+#endif
 						/* doesn't exist */
     if (nr >= mfp->mf_blocknr_max || nr <= mfp->mf_blocknr_min)
 	return NULL;
@@ -373,40 +500,106 @@ mf_get(mfp, nr, page_count)
     {
 	if (nr < 0 || nr >= mfp->mf_infile_count)   /* can't be in the file */
 	    return NULL;
+	if (mf_hash_room(&mfp->mf_hash) == FAIL)
+	    return NULL;
 
 	/* could check here if the block is in the free list */
 
+#ifdef MMAP_SWAP
 	/*
-	 * Check if we need to flush an existing block.
-	 * If so, use that block.
-	 * If not, allocate a new block.
+	 * If the block is in the mapping, only a block header is needed.
+	 * Limit the number of these headers, they make the hash lists long.
 	 */
-	hp = mf_release(mfp, page_count);
-	if (hp == NULL && (hp = mf_alloc_bhdr(mfp, page_count)) == NULL)
-	    return NULL;
-
-	hp->bh_bnum = nr;
-	hp->bh_flags = 0;
-	hp->bh_page_count = page_count;
-	if (mf_read(mfp, hp) == FAIL)	    /* cannot read the block! */
+	if ((p = mf_map_addr(mfp, nr, page_count, FALSE)) != NULL)
 	{
-	    mf_free_bhdr(hp);
-	    return NULL;
+	    if (mfp->mf_map_count >= mfp->mf_used_count_max)
+		mf_map_release(mfp);
+	    if ((hp = (BHDR *)alloc((unsigned)sizeof(BHDR))) == NULL)
+		return NULL;
+	    hp->bh_bnum = nr;
+	    hp->bh_data = p;
+	    hp->bh_flags = BH_MAPPED;
+	    hp->bh_page_count = page_count;
+	}
+	else
+#endif
+	{
+	    /*
+	     * Check if we need to flush an existing block.
+	     * If so, use that block.
+	     * If not, allocate a new block.
+	     */
+	    hp = mf_release(mfp, page_count);
+	    if (hp == NULL && (hp = mf_alloc_bhdr(mfp, page_count)) == NULL)
+		return NULL;
+
+	    hp->bh_bnum = nr;
+	    hp->bh_flags = 0;
+	    hp->bh_page_count = page_count;
+	    if (mf_read(mfp, hp) == FAIL)	    /* cannot read the block! */
+	    {
+		mf_free_bhdr(hp);
+		return NULL;
+	    }
 	}
+	mf_ins_hash(mfp, hp);
     }
     else
-    {
 	mf_rem_used(mfp, hp);	/* remove from list, insert in front below */
-	mf_rem_hash(mfp, hp);
-    }
 
     hp->bh_flags |= BH_LOCKED;
     mf_ins_used(mfp, hp);	/* put in front of used list */
-    mf_ins_hash(mfp, hp);	/* put in front of hash list */
 
     return hp;
 }
 
+#ifdef LAZY_READ
+/*
+ * Reserve a negative block number for a block that is created later with
+ * mf_get_lazy().
+ */
+    blocknr_t
+mf_reserve(mfp)
+    MEMFILE	*mfp;
+{
+    return mfp->mf_blocknr_min--;
+}
+
+/*
+ * Get a block for number 'nr' with 'page_count' pages, which must have been
+ * obtained with mf_reserve() and is not in memory now.  The caller fills the
+ * block, it is marked with BH_LAZY: when it is not changed it can be dropped
+ * without writing it, the caller must be able to fill it again.  When it is
+ * put back dirty or "infile" it becomes a normal block.
+ */
+    BHDR *
+mf_get_lazy(mfp, nr, page_count)
+    MEMFILE	*mfp;
+    blocknr_t	nr;
+    int		page_count;
+{
+    BHDR    *hp;
+
+    if (nr >= 0 || nr <= mfp->mf_blocknr_min
+	    || mf_find_hash(mfp, nr) != NULL
+	    || mf_hash_room(&mfp->mf_hash) == FAIL)
+	return NULL;
+
+    hp = mf_release(mfp, page_count);
+    if (hp == NULL && (hp = mf_alloc_bhdr(mfp, page_count)) == NULL)
+	return NULL;
+
+    hp->bh_bnum = nr;
+    hp->bh_flags = BH_LOCKED | BH_LAZY;
+    hp->bh_page_count = page_count;
+    ++mfp->mf_lazy_count;
+    mf_ins_hash(mfp, hp);
+    mf_ins_used(mfp, hp);
+
+    return hp;
+}
+#endif
+
 /*
  * release the block *hp
  *
@@ -429,9 +622,20 @@ mf_put(mfp, hp, dirty, infile)
     if ((flags & BH_LOCKED) == 0)
 	printf("block was not locked");
     flags &= ~BH_LOCKED;
+#ifdef LAZY_READ
+    /* a changed lazy block can't be filled again, it must be written */
+    if ((flags & BH_LAZY) && (dirty || infile))
+    {
+	flags &= ~BH_LAZY;
+	dirty = TRUE;
+	--mfp->mf_lazy_count;
+	++mfp->mf_neg_count;
+    }
+#endif
     if (dirty)
     {
-	flags |= BH_DIRTY;
+	if (!(flags & BH_MAPPED))	/* a mapped block is in the file */
+	    flags |= BH_DIRTY;
 	mfp->mf_dirty = TRUE;
     }
     hp->bh_flags = flags;
@@ -447,13 +651,19 @@ mf_free(mfp, hp)
     MEMFILE *mfp;
     BHDR    *hp;
 {
-    vim_free(hp->bh_data);	/* free the memory */
+    if (!(hp->bh_flags & BH_MAPPED))
+	vim_free(hp->bh_data);	/* free the memory */
     mf_rem_hash(mfp, hp);	/* get *hp out of the hash list */
     mf_rem_used(mfp, hp);	/* get *hp out of the used list */
     if (hp->bh_bnum < 0)
     {
+#ifdef LAZY_READ
+	if (hp->bh_flags & BH_LAZY)
+	    mfp->mf_lazy_count--;
+	else
+#endif
+	    mfp->mf_neg_count--;
 	vim_free(hp);		/* don't want negative numbers in free list */
-	mfp->mf_neg_count--;
     }
     else
 	mf_ins_free(mfp, hp);	/* put *hp in the free list */
@@ -467,7 +677,8 @@ mf_free(mfp, hp)
  *  MFS_STOP	Stop syncing when a character becomes available, but sync at
  *		least one block.
  *  MFS_FLUSH	Make sure buffers are flushed to disk, so they will survive a
- *		system crash.
+ *		system crash.  Together with MFS_STOP the flush may be done in
+ *		the background, when it is still busy the memfile stays dirty.
  *  MFS_ZERO	Only write block 0.
  *
  * Return FAIL for failure, OK otherwise
@@ -522,6 +733,18 @@ mf_sync(mfp, flags)
     if (hp == NULL || status == FAIL)
 	mfp->mf_dirty = FALSE;
 
+#ifdef MMAP_SWAP
+    /*
+     * Changes in mapped blocks were not written above.  Let the system write
+     * them, only wait for it when flushing.
+     */
+    if (mfp->mf_map_len > 0 && msync((char *)mfp->mf_map_base,
+		(size_t)((flags & MFS_ZERO) ? mfp->mf_page_size
+							  : mfp->mf_map_len),
+		((flags & MFS_FLUSH) && *p_sws != NUL) ? MS_SYNC : MS_ASYNC))
+	status = FAIL;
+#endif
+
     if ((flags & MFS_FLUSH) && *p_sws != NUL)
     {
 #if defined(UNIX)
@@ -540,6 +763,15 @@ mf_sync(mfp, flags)
 #  endif
 	if (STRCMP(p_sws, "fsync") == 0)
 	{
+#  ifdef USE_AIO_FSYNC
+	    /*
+	     * When waiting for the user to type, don't block on the disk:
+	     * let the system flush the file in the background.  Block 0 was
+	     * written before and is flushed with the rest.
+	     */
+	    if (!(flags & MFS_STOP) || (flags & MFS_ZERO)
+						|| mf_sync_start(mfp) == FAIL)
+#  endif
 	    if (fsync(mfp->mf_fd))
 		status = FAIL;
 	}
@@ -598,57 +830,283 @@ mf_sync(mfp, flags)
     return status;
 }
 
+#ifdef USE_AIO_FSYNC
 /*
- * insert block *hp in front of hashlist of memfile *mfp
+ * Start flushing the swap file of memfile *mfp to disk in the background.
+ * When the previous flush is still busy nothing is started, the memfile is
+ * marked dirty to try again later.
+ * Return FAIL when the flush could not be started or the previous one
+ * failed, the caller must then use fsync().
+ */
+    static int
+mf_sync_start(mfp)
+    MEMFILE	*mfp;
+{
+    struct aiocb    *cbp;
+
+    if (mfp->mf_aio_busy)
+    {
+	if (aio_error((struct aiocb *)mfp->mf_aiocb) == EINPROGRESS)
+	{
+	    mfp->mf_dirty = TRUE;
+	    return OK;
+	}
+	if (mf_sync_wait(mfp) == FAIL)
+	    return FAIL;
+    }
+    if (mfp->mf_aiocb == NULL)
+    {
+	mfp->mf_aiocb = alloc((unsigned)sizeof(struct aiocb));
+	if (mfp->mf_aiocb == NULL)
+	    return FAIL;
+    }
+    cbp = (struct aiocb *)mfp->mf_aiocb;
+    vim_memset(cbp, 0, sizeof(struct aiocb));
+    cbp->aio_fildes = mfp->mf_fd;
+    cbp->aio_sigevent.sigev_notify = SIGEV_NONE;
+    if (aio_fsync(O_SYNC, cbp) != 0)
+	return FAIL;
+    mfp->mf_aio_busy = TRUE;
+    return OK;
+}
+#endif
+
+/*
+ * Wait for a background flush of memfile *mfp, started by mf_sync(), to
+ * finish.  Must be done before closing the swap file.
+ * Return FAIL if the flush failed.
+ */
+    int
+mf_sync_wait(mfp)
+    MEMFILE	*mfp;
+{
+#ifdef USE_AIO_FSYNC
+    const struct aiocb	*list[1];
+
+    if (!mfp->mf_aio_busy)
+	return OK;
+    list[0] = (struct aiocb *)mfp->mf_aiocb;
+    while (aio_error(list[0]) == EINPROGRESS)
+	(void)aio_suspend(list, 1, NULL);
+    mfp->mf_aio_busy = FALSE;
+    if (aio_return((struct aiocb *)mfp->mf_aiocb) != 0)
+	return FAIL;
+#endif
+    return OK;
+}
+
+/*
+ * insert block *hp in the hash table of memfile *mfp
+ * mf_hash_room() must have been called first.
  */
     static void
 mf_ins_hash(mfp, hp)
     MEMFILE *mfp;
     BHDR    *hp;
 {
-    BHDR    *hhp;
-    int	    hash;
-
-    hash = MEMHASH(hp->bh_bnum);
-    hhp = mfp->mf_hash[hash];
-    hp->bh_hash_next = hhp;
-    hp->bh_hash_prev = NULL;
-    if (hhp != NULL)
-	hhp->bh_hash_prev = hp;
-    mfp->mf_hash[hash] = hp;
+    mf_hash_add(&mfp->mf_hash, hp->bh_bnum, (void *)hp);
 }
 
 /*
- * remove block *hp from hashlist of memfile list *mfp
+ * remove block *hp from the hash table of memfile *mfp
  */
     static void
 mf_rem_hash(mfp, hp)
     MEMFILE *mfp;
     BHDR    *hp;
 {
-    if (hp->bh_hash_prev == NULL)
-	mfp->mf_hash[MEMHASH(hp->bh_bnum)] = hp->bh_hash_next;
-    else
-	hp->bh_hash_prev->bh_hash_next = hp->bh_hash_next;
-
-    if (hp->bh_hash_next)
-	hp->bh_hash_next->bh_hash_prev = hp->bh_hash_prev;
+    mf_hash_rem(&mfp->mf_hash, hp->bh_bnum);
 }
 
 /*
- * look in hash lists of memfile *mfp for block header with number 'nr'
+ * look in the hash table of memfile *mfp for block header with number 'nr'
  */
     static BHDR *
 mf_find_hash(mfp, nr)
     MEMFILE	*mfp;
     blocknr_t	nr;
 {
-    BHDR	*hp;
+    return (BHDR *)mf_hash_find(&mfp->mf_hash, nr);
+}
+
+/*
+ * The hash tables use open addressing with linear probing.  Multiplying with
+ * an odd number keeps consecutive block numbers in different items, but
+ * spreads them out, so that they don't form one long run of used items.
+ */
+#define MHT_HASH(nr)	((long_u)(nr) * 0x9e3779b1)
+
+/*
+ * Initialize an empty hash table.
+ */
+    static void
+mf_hash_init(mht)
+    MF_HASHTAB	*mht;
+{
+    int		i;
 
-    for (hp = mfp->mf_hash[MEMHASH(nr)]; hp != NULL; hp = hp->bh_hash_next)
-	if (hp->bh_bnum == nr)
+    mht->mht_mask = MHT_INIT_SIZE - 1;
+    mht->mht_count = 0;
+    mht->mht_items = mht->mht_small_items;
+    for (i = 0; i < MHT_INIT_SIZE; ++i)
+	mht->mht_items[i].mhi_ptr = NULL;
+    mht->mht_hits = 0;
+    mht->mht_misses = 0;
+    mht->mht_probes = 0;
+}
+
+/*
+ * Free the array of a hash table.  The items it points to are not freed.
+ */
+    static void
+mf_hash_free(mht)
+    MF_HASHTAB	*mht;
+{
+    if (mht->mht_items != mht->mht_small_items)
+	vim_free(mht->mht_items);
+}
+
+/*
+ * Find the item with number "key" in hash table "mht".
+ * Returns the pointer stored with it, NULL when not found.
+ */
+    static void *
+mf_hash_find(mht, key)
+    MF_HASHTAB	*mht;
+    blocknr_t	key;
+{
+    MF_HASHITEM	*mhi;
+    long_u	idx;
+
+    for (idx = MHT_HASH(key) & mht->mht_mask; ;
+					    idx = (idx + 1) & mht->mht_mask)
+    {
+	++mht->mht_probes;
+	mhi = &mht->mht_items[idx];
+	if (mhi->mhi_ptr == NULL)
+	{
+	    ++mht->mht_misses;
+	    return NULL;
+	}
+	if (mhi->mhi_key == key)
+	{
+	    ++mht->mht_hits;
+	    return mhi->mhi_ptr;
+	}
+    }
+}
+
+/*
+ * Make sure there is room in hash table "mht" to add one item.
+ * The table is made bigger when it gets half full.  When that fails it is
+ * still used until only one empty item is left, lookups need it to stop.
+ *
+ * Return FAIL when there is no room, OK otherwise.
+ */
+    static int
+mf_hash_room(mht)
+    MF_HASHTAB	*mht;
+{
+    if ((mht->mht_count + 1) * 2 > mht->mht_mask + 1
+	    && mf_hash_grow(mht) == FAIL
+	    && mht->mht_count + 2 > mht->mht_mask + 1)
+	return FAIL;
+    return OK;
+}
+
+/*
+ * Add item "ptr" with number "key" to hash table "mht".
+ * The number must not be in the table yet and mf_hash_room() must have been
+ * called first.
+ */
+    static void
+mf_hash_add(mht, key, ptr)
+    MF_HASHTAB	*mht;
+    blocknr_t	key;
+    void	*ptr;
+{
+    long_u	idx;
+
+    idx = MHT_HASH(key) & mht->mht_mask;
+    while (mht->mht_items[idx].mhi_ptr != NULL)
+	idx = (idx + 1) & mht->mht_mask;
+    mht->mht_items[idx].mhi_key = key;
+    mht->mht_items[idx].mhi_ptr = ptr;
+    ++mht->mht_count;
+}
+
+/*
+ * Remove the item with number "key" from hash table "mht".
+ * The items after it in the same run are moved back into the hole, unless
+ * that would put them before their hash position.
+ */
+    static void
+mf_hash_rem(mht, key)
+    MF_HASHTAB	*mht;
+    blocknr_t	key;
+{
+    MF_HASHITEM	*items = mht->mht_items;
+    long_u	mask = mht->mht_mask;
+    long_u	idx;
+    long_u	hole;
+
+    for (idx = MHT_HASH(key) & mask; ; idx = (idx + 1) & mask)
+    {
+	if (items[idx].mhi_ptr == NULL)
+	    return;			/* not found */
+	if (items[idx].mhi_key == key)
 	    break;
-    return hp;
+    }
+
+    hole = idx;
+    for (;;)
+    {
+	idx = (idx + 1) & mask;
+	if (items[idx].mhi_ptr == NULL)
+	    break;
+	/* can move the item if its hash position is not after the hole */
+	if (((idx - MHT_HASH(items[idx].mhi_key)) & mask)
+						      >= ((idx - hole) & mask))
+	{
+	    items[hole] = items[idx];
+	    hole = idx;
+	}
+    }
+    items[hole].mhi_ptr = NULL;
+    --mht->mht_count;
+}
+
+/*
+ * Double the size of hash table "mht".
+ *
+ * Return FAIL for failure (out of memory), OK otherwise.
+ */
+    static int
+mf_hash_grow(mht)
+    MF_HASHTAB	*mht;
+{
+    MF_HASHITEM	*old_items = mht->mht_items;
+    long_u	old_size = mht->mht_mask + 1;
+    long_u	i;
+
+    mht->mht_items = (MF_HASHITEM *)lalloc(
+			       old_size * 2 * sizeof(MF_HASHITEM), FALSE);
+    if (mht->mht_items == NULL)
+    {
+	mht->mht_items = old_items;
+	return FAIL;
+    }
+    mht->mht_mask = old_size * 2 - 1;
+    mht->mht_count = 0;
+    for (i = 0; i <= mht->mht_mask; ++i)
+	mht->mht_items[i].mhi_ptr = NULL;
+    for (i = 0; i < old_size; ++i)
+	if (old_items[i].mhi_ptr != NULL)
+	    mf_hash_add(mht, old_items[i].mhi_key, old_items[i].mhi_ptr);
+
+    if (old_items != mht->mht_small_items)
+	vim_free(old_items);
+    return OK;
 }
 
 /*
@@ -666,8 +1124,15 @@ mf_ins_used(mfp, hp)
 	mfp->mf_used_last = hp;
     else
 	hp->bh_next->bh_prev = hp;
-    mfp->mf_used_count += hp->bh_page_count;
-    total_mem_used += hp->bh_page_count * mfp->mf_page_size;
+#ifdef MMAP_SWAP
+    if (hp->bh_flags & BH_MAPPED)	    /* doesn't use memory */
+	mfp->mf_map_count += hp->bh_page_count;
+    else
+#endif
+    {
+	mfp->mf_used_count += hp->bh_page_count;
+	total_mem_used += hp->bh_page_count * mfp->mf_page_size;
+    }
 }
 
 /*
@@ -686,8 +1151,15 @@ mf_rem_used(mfp, hp)
 	mfp->mf_used_first = hp->bh_next;
     else
 	hp->bh_prev->bh_next = hp->bh_next;
-    mfp->mf_used_count -= hp->bh_page_count;
-    total_mem_used -= hp->bh_page_count * mfp->mf_page_size;
+#ifdef MMAP_SWAP
+    if (hp->bh_flags & BH_MAPPED)
+	mfp->mf_map_count -= hp->bh_page_count;
+    else
+#endif
+    {
+	mfp->mf_used_count -= hp->bh_page_count;
+	total_mem_used -= hp->bh_page_count * mfp->mf_page_size;
+    }
 }
 
 /*
@@ -729,17 +1201,29 @@ mf_release(mfp, page_count)
 
     /*
      * don't release a block if
-     *	there is no file for this memfile
+     *	there is no file for this memfile (and no lazy block)
      * or
      *	the number of blocks for this memfile is lower than the maximum
      *	  and
      *	total memory used is not up to 'maxmemtot'
      */
-    if (mfp->mf_fd < 0 || !need_release)
+    if ((mfp->mf_fd < 0
+#ifdef LAZY_READ
+		&& mfp->mf_lazy_count == 0
+#endif
+		) || !need_release)
 	return NULL;
 
+    /*
+     * A mapped block has no memory that can be re-used.  Without a file only
+     * a lazy block can be released.
+     */
     for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
-	if (!(hp->bh_flags & BH_LOCKED))
+	if (!(hp->bh_flags & (BH_LOCKED | BH_MAPPED))
+#ifdef LAZY_READ
+		&& (mfp->mf_fd >= 0 || (hp->bh_flags & BH_LAZY))
+#endif
+		)
 	    break;
     if (hp == NULL)	/* not a single one that can be released */
 	return NULL;
@@ -753,6 +1237,10 @@ mf_release(mfp, page_count)
 
     mf_rem_used(mfp, hp);
     mf_rem_hash(mfp, hp);
+#ifdef LAZY_READ
+    if (hp->bh_flags & BH_LAZY)
+	mfp->mf_lazy_count--;
+#endif
 
     /*
      * If a BHDR is returned, make sure that the page_count of bh_data is right
@@ -796,6 +1284,10 @@ mf_release_all()
 		{
 		    mf_rem_used(mfp, hp);
 		    mf_rem_hash(mfp, hp);
+#ifdef LAZY_READ
+		    if (hp->bh_flags & BH_LAZY)
+			mfp->mf_lazy_count--;
+#endif
 		    mf_free_bhdr(hp);
 		    hp = mfp->mf_used_last;	/* re-start, list was changed */
 		    retval = TRUE;
@@ -837,7 +1329,8 @@ mf_alloc_bhdr(mfp, page_count)
 mf_free_bhdr(hp)
     BHDR	*hp;
 {
-    vim_free(hp->bh_data);
+    if (!(hp->bh_flags & BH_MAPPED))
+	vim_free(hp->bh_data);
     vim_free(hp);
 }
 
@@ -917,6 +1410,9 @@ mf_write(mfp, hp)
     unsigned	page_size;  /* number of bytes in a page */
     unsigned	page_count; /* number of pages written */
     unsigned	size;	    /* number of bytes written */
+#ifdef MMAP_SWAP
+    char_u	*p;
+#endif
 
     if (mfp->mf_fd < 0)	    /* there is no file, can't write */
 	return FAIL;
@@ -927,6 +1423,20 @@ mf_write(mfp, hp)
 
     page_size = mfp->mf_page_size;
 
+#ifdef MMAP_SWAP
+    /*
+     * If the block fits in the mapping, copy it there.  The file is extended
+     * by mf_map_grow(), thus there are no gaps to fill.
+     */
+    if ((p = mf_map_addr(mfp, hp->bh_bnum, hp->bh_page_count, TRUE)) != NULL)
+    {
+	if (!(hp->bh_flags & BH_MAPPED))
+	    vim_memmove(p, hp->bh_data, (size_t)(page_size * hp->bh_page_count));
+	hp->bh_flags &= ~BH_DIRTY;
+	return OK;
+    }
+#endif
+
     /*
      * We don't want gaps in the file. Write the blocks in front of *hp
      * to extend the file.
@@ -993,14 +1503,14 @@ mf_trans_add(mfp, hp)
 {
     BHDR	*freep;
     blocknr_t	new_bnum;
-    int		hash;
     NR_TRANS	*np;
     int		page_count;
 
     if (hp->bh_bnum >= 0)		    /* it's already positive */
 	return OK;
 
-    if ((np = (NR_TRANS *)alloc((unsigned)sizeof(NR_TRANS))) == NULL)
+    if (mf_hash_room(&mfp->mf_trans) == FAIL
+	    || (np = (NR_TRANS *)alloc((unsigned)sizeof(NR_TRANS))) == NULL)
 	return FAIL;
 
 /*
@@ -1037,22 +1547,18 @@ mf_trans_add(mfp, hp)
     np->nt_old_bnum = hp->bh_bnum;	    /* adjust number */
     np->nt_new_bnum = new_bnum;
 
-    mf_rem_hash(mfp, hp);		    /* remove from old hash list */
+    mf_rem_hash(mfp, hp);		    /* remove with old number */
     hp->bh_bnum = new_bnum;
-    mf_ins_hash(mfp, hp);		    /* insert in new hash list */
+    mf_ins_hash(mfp, hp);		    /* insert with new number */
 
-    hash = MEMHASH(np->nt_old_bnum);	    /* insert in trans list */
-    np->nt_next = mfp->mf_trans[hash];
-    mfp->mf_trans[hash] = np;
-    if (np->nt_next != NULL)
-	np->nt_next->nt_prev = np;
-    np->nt_prev = NULL;
+					    /* insert in trans table */
+    mf_hash_add(&mfp->mf_trans, np->nt_old_bnum, (void *)np);
 
     return OK;
 }
 
 /*
- * Lookup a tranlation from the trans lists and delete the entry
+ * Lookup a tranlation from the trans table and delete the entry
  *
  * Return the positive new number when found, the old number when not found
  */
@@ -1061,25 +1567,16 @@ mf_trans_del(mfp, old_nr)
     MEMFILE	*mfp;
     blocknr_t	old_nr;
 {
-    int		hash;
     NR_TRANS	*np;
     blocknr_t	new_bnum;
 
-    hash = MEMHASH(old_nr);
-    for (np = mfp->mf_trans[hash]; np != NULL; np = np->nt_next)
-	if (np->nt_old_bnum == old_nr)
-	    break;
+    np = (NR_TRANS *)mf_hash_find(&mfp->mf_trans, old_nr);
     if (np == NULL)		/* not found */
 	return old_nr;
 
     mfp->mf_neg_count--;
     new_bnum = np->nt_new_bnum;
-    if (np->nt_prev != NULL)		/* remove entry from the trans list */
-	np->nt_prev->nt_next = np->nt_next;
-    else
-	mfp->mf_trans[hash] = np->nt_next;
-    if (np->nt_next != NULL)
-	np->nt_next->nt_prev = np->nt_prev;
+    mf_hash_rem(&mfp->mf_trans, old_nr);    /* remove entry from trans table */
     vim_free(np);
 
     return new_bnum;
@@ -1123,6 +1620,35 @@ mf_need_trans(mfp)
     return (mfp->mf_fname != NULL && mfp->mf_neg_count > 0);
 }
 
+/*
+ * List the number of blocks in memory and how well the hash tables of memfile
+ * "mfp" are doing.  Used for ":swapname" when 'verbose' is set.
+ */
+    void
+mf_statistics(mfp)
+    MEMFILE	*mfp;
+{
+    msg_putchar('\n');
+    sprintf((char *)IObuff, "%ld pages in memory, %ld pages in file",
+	    (long)mfp->mf_used_count, (long)mfp->mf_infile_count);
+    msg_outtrans(IObuff);
+    mf_hash_stats("blocks", &mfp->mf_hash);
+    mf_hash_stats("translations", &mfp->mf_trans);
+}
+
+    static void
+mf_hash_stats(name, mht)
+    char	*name;
+    MF_HASHTAB	*mht;
+{
+    msg_putchar('\n');
+    sprintf((char *)IObuff,
+		      "%s: %ld of %ld used, %ld hits, %ld misses, %ld probes",
+	    name, (long)mht->mht_count, (long)(mht->mht_mask + 1),
+	    mht->mht_hits, mht->mht_misses, mht->mht_probes);
+    msg_outtrans(IObuff);
+}
+
 /*
  * Open a swap file for a memfile.
  * The "fname" must be in allocated memory, and is consumed (also when an
@@ -1178,3 +1704,189 @@ mf_do_open(mfp, fname, trunc_file)
     else
 	mch_hide(mfp->mf_fname);    /* try setting the 'hidden' flag */
 }
+
+/*
+ * Map the swap file again after it has been closed and opened, e.g. when it
+ * was renamed.  If the opened file is shorter than the mapping, the blocks
+ * are first copied from the old mapping, so that nothing is lost.
+ */
+    void
+mf_remap(mfp)
+    MEMFILE	*mfp;
+{
+#ifdef MMAP_SWAP
+    off_t	size;
+    size_t	len;
+
+    if (mfp->mf_map_base == NULL || mfp->mf_map_len == 0 || mfp->mf_fd < 0)
+	return;
+    size = lseek(mfp->mf_fd, (off_t)0L, SEEK_END);
+    if (size < 0)
+	return;
+    if ((long_u)size < mfp->mf_map_len)
+    {
+	len = (size_t)(mfp->mf_map_len - size);
+	if ((size_t)write(mfp->mf_fd, (char *)mfp->mf_map_base + size, len)
+								       != len)
+	{
+	    EMSG("Write error in swap file");
+	    return;
+	}
+    }
+    if (mmap((char *)mfp->mf_map_base, (size_t)mfp->mf_map_len,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+		mfp->mf_fd, (off_t)0L) == MAP_FAILED)
+	EMSG("Cannot map swap file");
+#endif
+}
+
+#ifdef MMAP_SWAP
+/*
+ * Setup for using a mapping for the swap file of "mfp".  Only reserves the
+ * addresses, the file is mapped when blocks are written.
+ * When something fails the swap file is used without a mapping.
+ */
+    static void
+mf_map_init(mfp)
+    MEMFILE	*mfp;
+{
+# ifdef MAP_ANONYMOUS
+    long	sys_page_size;
+    long_u	max;
+    char_u	*p;
+
+#  ifdef _SC_PAGESIZE
+    sys_page_size = sysconf(_SC_PAGESIZE);
+#  else
+    sys_page_size = getpagesize();
+#  endif
+    /* the file is mapped in pieces, the offsets must be aligned */
+    if (sys_page_size <= 0 || mfp->mf_page_size % sys_page_size != 0)
+	return;
+
+    max = 0x10000000L;			/* 256 Mbyte */
+    if (sizeof(char_u *) > 4)
+	max *= 256;			/* 64 Gbyte */
+    p = (char_u *)mmap(NULL, (size_t)max, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, (off_t)0L);
+    if (p == (char_u *)MAP_FAILED)
+	return;
+    mfp->mf_map_base = p;
+    mfp->mf_map_max = max;
+    mfp->mf_map_len = 0;
+# endif
+}
+
+/*
+ * Return a pointer to block "nr" with "page_count" pages in the mapping.
+ * If "grow" is TRUE the mapping is extended when needed.
+ * Return NULL if the block is not in the mapping.
+ */
+    static char_u *
+mf_map_addr(mfp, nr, page_count, grow)
+    MEMFILE	*mfp;
+    blocknr_t	nr;
+    int		page_count;
+    int		grow;
+{
+    long_u	end;
+
+    if (mfp->mf_map_base == NULL || nr < 0)
+	return NULL;
+    end = (long_u)(nr + page_count) * mfp->mf_page_size;
+    if (end > mfp->mf_map_len && (!grow || mf_map_grow(mfp, end) == FAIL))
+	return NULL;
+    if (nr + page_count > mfp->mf_infile_count)
+	mfp->mf_infile_count = nr + page_count;
+    return mfp->mf_map_base + (long_u)nr * mfp->mf_page_size;
+}
+
+/*
+ * Extend the file and the mapping to at least "need" bytes.
+ * The file is filled with zeros instead of making it sparse, so that a full
+ * disk results in a write error now and not in a signal later.
+ * Return FAIL for failure, OK otherwise
+ */
+    static int
+mf_map_grow(mfp, need)
+    MEMFILE	*mfp;
+    long_u	need;
+{
+    long_u	page_size = mfp->mf_page_size;
+    long_u	pages;
+    long_u	len;
+    off_t	size;
+    char_u	*zeros;
+    unsigned	n;
+
+    if (mfp->mf_fd < 0)
+	return FAIL;
+
+    /* grow by half the current size, but at least 16 and at most 1024 pages */
+    pages = mfp->mf_map_len / page_size / 2;
+    if (pages < 16)
+	pages = 16;
+    else if (pages > 1024)
+	pages = 1024;
+    len = mfp->mf_map_len + pages * page_size;
+    if (len < need)
+	len = need;
+    if (len > mfp->mf_map_max)
+    {
+	if (need > mfp->mf_map_max)
+	    return FAIL;
+	len = need;
+    }
+
+    /* the file may already be longer, blocks written without the mapping */
+    size = lseek(mfp->mf_fd, (off_t)0L, SEEK_END);
+    if (size < 0)
+	return FAIL;
+    if ((long_u)size < len)
+    {
+	if ((zeros = alloc_clear((unsigned)page_size)) == NULL)
+	    return FAIL;
+	while ((long_u)size < len)
+	{
+	    n = (unsigned)page_size;
+	    if (len - size < (long_u)n)
+		n = (unsigned)(len - size);
+	    if ((unsigned)write(mfp->mf_fd, (char *)zeros, (size_t)n) != n)
+	    {
+		vim_free(zeros);
+		return FAIL;
+	    }
+	    size += n;
+	}
+	vim_free(zeros);
+    }
+
+    if (mmap((char *)mfp->mf_map_base + mfp->mf_map_len,
+		(size_t)(len - mfp->mf_map_len), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_FIXED, mfp->mf_fd,
+		(off_t)mfp->mf_map_len) == MAP_FAILED)
+	return FAIL;
+    mfp->mf_map_len = len;
+    return OK;
+}
+
+/*
+ * Release the least recently used header of a mapped block that is not
+ * locked.  The data stays in the mapping, it is found again by mf_get().
+ */
+    static void
+mf_map_release(mfp)
+    MEMFILE	*mfp;
+{
+    BHDR	*hp;
+
+    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+	if ((hp->bh_flags & (BH_MAPPED | BH_LOCKED)) == BH_MAPPED)
+	{
+	    mf_rem_used(mfp, hp);
+	    mf_rem_hash(mfp, hp);
+	    vim_free(hp);
+	    break;
+	}
+}
+#endif /* MMAP_SWAP */
@@ -38,6 +38,24 @@
  *  changed (lines appended/deleted/changed) or when it is flushed it gets a
  *  positive number. Use mf_trans_del() to get the new number, before calling
  *  mf_get().
+ *
+ *  To avoid walking down the tree for every line that is not in the locked
+ *  block, a line index is kept with an entry for each data block (ml_idx).
+ *  It is built the first time it is needed.  The line count of the locked
+ *  block is updated when it is released, like with ml_locked_lineadd, and
+ *  entries are added and removed when data blocks are split or freed.  A
+ *  block found through the index is locked without filling the stack.
+ *
+ *  When a file is read into an empty buffer the lines are not appended one
+ *  by one.  Data blocks are filled up completely and the pointer blocks are
+ *  built bottom-up from them, see ml_bulk_start().
+ *
+ *  For a big file that is edited read-only the data blocks are not even
+ *  filled, only their position in the file is remembered (ml_lazy).  A data
+ *  block is read from the file when it is needed and dropped again when
+ *  memory is needed, unless it was changed.  See ml_bulk_lazy().  Such a
+ *  file may be loaded in two steps: the lines of the rest of the file are
+ *  added later as a new branch of the root block, see ml_bulk_more().
  */
 
 #if defined MSDOS  ||  defined WIN32
@@ -183,19 +201,86 @@ static linenr_t	lowest_marked = 0;
 #define ML_DELETE	0x11	    /* delete line */
 #define ML_INSERT	0x12	    /* insert line */
 #define ML_FIND		0x13	    /* just find the line */
+#define ML_WALK		0x14	    /* find the line without using the index */
 #define ML_FLUSH	0x02	    /* flush locked block */
-#define ML_SIMPLE(x)	(x & 0x10)  /* DEL, INS or FIND */
+#define ML_SIMPLE(x)	(x & 0x10)  /* DEL, INS, FIND or WALK */
+
+/*
+ * ml_page_size() makes the pages bigger until a data block can hold at least
+ * ML_PAGE_LINES lines of the average length, but not above ML_PAGE_SIZE_MAX.
+ * Not for 16 bit systems, the offsets in a data block must fit in an int.
+ */
+#define ML_PAGE_LINES	4
+#if SIZEOF_INT > 2
+# define ML_PAGE_SIZE_MAX 0x10000L
+#else
+# define ML_PAGE_SIZE_MAX 0L
+#endif
+
+/*
+ * Info for loading lines with ml_bulk_append().  For each level of the tree
+ * there is one pointer block that is being filled, level 0 points to data
+ * blocks.
+ */
+#define BULK_LEVELS	10	    /* maximum depth of the tree */
+
+struct bulk_info
+{
+    BUF		*bi_buf;		/* buffer being loaded, NULL if none */
+    linenr_t	bi_line_count;		/* number of lines appended so far */
+    BHDR	*bi_data;		/* data block being filled or NULL */
+    linenr_t	bi_data_lnum;		/* first line in bi_data */
+    int		bi_levels;		/* number of levels used in bi_ptr[] */
+    BHDR	*bi_ptr[BULK_LEVELS];	/* pointer block being filled or NULL */
+    linenr_t	bi_ptr_lnum[BULK_LEVELS]; /* first line in bi_ptr[] */
+#ifdef LAZY_READ
+    int		bi_lazy;		/* data blocks are read later */
+    int		bi_page_count;		/* pages of lazy data block or zero */
+    int		bi_free;		/* free bytes in lazy data block */
+    long	bi_offset;		/* file offset of lazy data block */
+    linenr_t	bi_line_base;		/* lines in the buffer before, when
+					   appending with ml_bulk_more() */
+#endif
+};
+
+static struct bulk_info bulk;
 
+static int ml_open_page __ARGS((unsigned));
 static void set_b0_fname __ARGS((ZERO_BL *, BUF *buf));
 static void swapfile_info __ARGS((char_u *));
 static int recov_file_names __ARGS((char_u **, char_u *, int prepend_dot));
 static int ml_append_int __ARGS((BUF *, linenr_t, char_u *, colnr_t, int));
+static void ml_bulk_init __ARGS((BUF *));
+static int ml_bulk_data __ARGS((MEMFILE *));
+static int ml_bulk_add __ARGS((int, blocknr_t, int, linenr_t, linenr_t));
+static int ml_bulk_ptr __ARGS((MEMFILE *, int, linenr_t));
+#ifdef LAZY_READ
+static int ml_bulk_lazy_data __ARGS((MEMFILE *));
+static int ml_bulk_graft __ARGS((BUF *, PTR_BL *, BHDR *));
+static int ml_ptr_has_data __ARGS((BUF *, PTR_BL *));
+static MLLAZY *ml_lazy_find __ARGS((BUF *, blocknr_t));
+static BHDR *ml_lazy_get __ARGS((BUF *, blocknr_t, int));
+static void ml_lazy_copy __ARGS((BUF *));
+static void ml_lazy_close __ARGS((BUF *));
+#endif
 static int ml_delete_int __ARGS((BUF *, linenr_t, int));
 static char_u *findswapname __ARGS((BUF *, char_u **, char_u *));
 static void ml_flush_line __ARGS((BUF *));
 static BHDR *ml_new_data __ARGS((MEMFILE *, int, int));
 static BHDR *ml_new_ptr __ARGS((MEMFILE *));
 static BHDR *ml_find_line __ARGS((BUF *, linenr_t, int));
+static BHDR *ml_idx_find_line __ARGS((BUF *, linenr_t));
+static int ml_idx_build __ARGS((BUF *));
+static int ml_idx_add_branch __ARGS((BUF *, blocknr_t, int));
+static void ml_idx_tree __ARGS((BUF *, int));
+static linenr_t ml_idx_low __ARGS((BUF *, int));
+static int ml_idx_search __ARGS((BUF *, linenr_t));
+static int ml_idx_insert __ARGS((BUF *, int, linenr_t, blocknr_t, int));
+static int ml_idx_entry __ARGS((BUF *, linenr_t));
+static void ml_idx_sync __ARGS((BUF *, linenr_t, BHDR *));
+static void ml_idx_split __ARGS((BUF *, linenr_t, blocknr_t, int, linenr_t, blocknr_t, int, linenr_t));
+static void ml_idx_remove __ARGS((BUF *, linenr_t));
+static void ml_idx_clear __ARGS((BUF *));
 static int ml_add_stack __ARGS((BUF *));
 static char_u *makeswapname __ARGS((BUF *, char_u *));
 static void ml_lineadd __ARGS((BUF *, int));
@@ -213,6 +298,65 @@ static long char_to_long __ARGS((char_u *));
  */
     int
 ml_open()
+{
+    return ml_open_page(0);
+}
+
+/*
+ * ml_page_size() is called before reading a file into an empty buffer, with
+ * the average length of the lines in the file.  For long lines the memline is
+ * opened again with bigger pages, to avoid that each line ends up in its own
+ * (multi-page) data block.  The page size is stored in block 0, thus recovery
+ * will use it too.
+ * Can only be done as long as there is no swap file.
+ */
+    void
+ml_page_size(line_len)
+    long	line_len;
+{
+    MEMLINE	old_ml;
+    MEMLINE	new_ml;
+    long	page_size;
+
+    if (curbuf->b_ml.ml_mfp == NULL || curbuf->b_ml.ml_mfp->mf_fd >= 0
+	    || !(curbuf->b_ml.ml_flags & ML_EMPTY)
+	    || curbuf->b_ml.ml_line_count != 1)
+	return;
+
+    /*
+     * Lines that don't fit ML_PAGE_LINES times in the biggest page go in a
+     * block of several small pages, that wastes less space.
+     */
+    page_size = curbuf->b_ml.ml_mfp->mf_page_size;
+    while (page_size <= ML_PAGE_SIZE_MAX
+				       && line_len > page_size / ML_PAGE_LINES)
+	page_size *= 4;
+    if (page_size > ML_PAGE_SIZE_MAX
+				|| page_size == curbuf->b_ml.ml_mfp->mf_page_size)
+	return;
+
+    /*
+     * Open the new memline first, keep the old one when it fails.
+     */
+    old_ml = curbuf->b_ml;
+    if (ml_open_page((unsigned)page_size) == FAIL)
+    {
+	curbuf->b_ml = old_ml;
+	return;
+    }
+    new_ml = curbuf->b_ml;
+    curbuf->b_ml = old_ml;
+    ml_close(curbuf, TRUE);
+    curbuf->b_ml = new_ml;
+}
+
+/*
+ * open a new memline for 'curbuf', using pages of "page_size" bytes
+ * (zero for the default)
+ */
+    static int
+ml_open_page(page_size)
+    unsigned	page_size;
 {
     MEMFILE	*mfp;
     BHDR	*hp = NULL;
@@ -228,6 +372,15 @@ ml_open()
     curbuf->b_ml.ml_stack_top = 0;	/* nothing in the stack */
     curbuf->b_ml.ml_locked = NULL;	/* no cached block */
     curbuf->b_ml.ml_line_lnum = 0;	/* no cached line */
+    ga_init(&curbuf->b_ml.ml_idx);	/* no line index yet */
+    curbuf->b_ml.ml_idx.ga_itemsize = sizeof(MLIDX);
+    curbuf->b_ml.ml_idx.ga_growsize = 100;
+#ifdef LAZY_READ
+    curbuf->b_ml.ml_lazy_fd = -1;	/* no lazy data blocks */
+    ga_init(&curbuf->b_ml.ml_lazy);
+    curbuf->b_ml.ml_lazy.ga_itemsize = sizeof(MLLAZY);
+    curbuf->b_ml.ml_lazy.ga_growsize = 100;
+#endif
 
 /*
  * When 'updatecount' is non-zero, flag that a swap file may be opened later.
@@ -241,6 +394,8 @@ ml_open()
     mfp = mf_open(NULL, TRUE);
     if (mfp == NULL)
 	goto error;
+    if (page_size != 0 && mf_set_page_size(mfp, page_size) == FAIL)
+	goto error;
 
 #if defined(MSDOS) && !defined(DJGPP)
     /* for 16 bit MS-DOS create a swapfile now, because we run out of
@@ -402,6 +557,7 @@ ml_setname()
 	    /* need to close the swap file before renaming */
 	if (mfp->mf_fd >= 0)
 	{
+	    (void)mf_sync_wait(mfp);
 	    close(mfp->mf_fd);
 	    mfp->mf_fd = -1;
 	}
@@ -432,6 +588,7 @@ ml_setname()
 	    EMSG("Oops, lost the swap file!!!");
 	    return;
 	}
+	mf_remap(mfp);		    /* mapping must use the new file */
     }
     if (!success)
 	EMSG("Could not rename swap file");
@@ -536,6 +693,14 @@ ml_close(buf, del_file)
     if (buf->b_ml.ml_line_lnum != 0 && (buf->b_ml.ml_flags & ML_LINE_DIRTY))
 	vim_free(buf->b_ml.ml_line_ptr);
     vim_free(buf->b_ml.ml_stack);
+    ml_idx_clear(buf);
+#ifdef EXTRA_SEARCH
+    search_hl_clear(buf);
+#endif
+#ifdef LAZY_READ
+    read_rest_stop(buf);
+    ml_lazy_close(buf);
+#endif
     buf->b_ml.ml_mfp = NULL;
 }
 
@@ -754,6 +919,7 @@ ml_recover()
     buf->b_ml.ml_line_lnum = 0;		/* no cached line */
     buf->b_ml.ml_locked = NULL;		/* no locked block */
     buf->b_ml.ml_flags = 0;
+    ga_init(&buf->b_ml.ml_idx);		/* no line index */
 
 /*
  * open the memfile from the old swap file
@@ -827,7 +993,10 @@ ml_recover()
      */
     if (mfp->mf_page_size != (unsigned)char_to_long(b0p->b0_page_size))
     {
-	mfp->mf_page_size = (unsigned)char_to_long(b0p->b0_page_size);
+	if (mf_set_page_size(mfp, (unsigned)char_to_long(b0p->b0_page_size))
+									== FAIL)
+	    goto theend;
+	b0p = (ZERO_BL *)(hp->bh_data);
 	if ((size = lseek(mfp->mf_fd, (off_t)0L, SEEK_END)) <= 0)
 	    mfp->mf_blocknr_max = 0;	    /* no file or empty file */
 	else
@@ -981,6 +1150,7 @@ ml_recover()
 		    bnum = pp->pb_pointer[idx].pe_bnum;
 		    line_count = pp->pb_pointer[idx].pe_line_count;
 		    page_count = pp->pb_pointer[idx].pe_page_count;
+		    idx = 0;
 		    continue;
 		}
 	    }
@@ -1581,14 +1751,15 @@ ml_preserve(buf, message)
      * we hit the end of the file, which can only happen in case a write fails,
      * e.g. when file system if full).
      * ml_find_line() does the work by translating the negative block numbers
-     * when getting the first line of each data block.
+     * when getting the first line of each data block.  The line index is
+     * not used for this, it would skip the pointer blocks.
      */
     if (mf_need_trans(mfp))
     {
 	lnum = 1;
 	while (mf_need_trans(mfp) && lnum <= buf->b_ml.ml_line_count)
 	{
-	    hp = ml_find_line(buf, lnum, ML_FIND);
+	    hp = ml_find_line(buf, lnum, ML_WALK);
 	    if (hp == NULL)
 	    {
 		status = FAIL;
@@ -1716,6 +1887,9 @@ errorret:
 #ifdef SYNTAX_HL
 	if (buf->b_syn_change_lnum > lnum)
 	    buf->b_syn_change_lnum = lnum;
+#endif
+#ifdef EXTRA_SEARCH
+	search_hl_changed(buf, lnum, 0L);
 #endif
     }
 
@@ -1751,6 +1925,9 @@ ml_append(lnum, line, len, newfile)
     if (curbuf->b_syn_change_lnum > lnum + 1)
 	curbuf->b_syn_change_lnum = lnum + 1;
 #endif
+#ifdef EXTRA_SEARCH
+    search_hl_changed(curbuf, lnum + 1, 1L);
+#endif
 
     if (curbuf->b_ml.ml_line_lnum != 0)
 	ml_flush_line(curbuf);
@@ -2050,6 +2227,13 @@ ml_append_int(buf, lnum, line, len, newfile)
 	dp_left->db_line_count = line_count_left;
 	dp_right->db_line_count = line_count_right;
 
+	/*
+	 * the line index gets an entry for the new data block
+	 */
+	ml_idx_split(buf, buf->b_ml.ml_locked_low, bnum_left, page_count_left,
+			(linenr_t)line_count_left, bnum_right, page_count_right,
+			(linenr_t)line_count_right);
+
 	/*
 	 * release the two data blocks
 	 * The new one (hp_new) already has a correct blocknumber.
@@ -2079,12 +2263,16 @@ ml_append_int(buf, lnum, line, len, newfile)
 	    ip = &(buf->b_ml.ml_stack[stack_idx]);
 	    pb_idx = ip->ip_index;
 	    if ((hp = mf_get(mfp, ip->ip_bnum, 1)) == NULL)
+	    {
+		ml_idx_clear(buf);
 		return FAIL;
+	    }
 	    pp = (PTR_BL *)(hp->bh_data);   /* must be pointer block */
 	    if (pp->pb_id != PTR_ID)
 	    {
 		EMSG("pointer block id wrong 3");
 		mf_put(mfp, hp, FALSE, FALSE);
+		ml_idx_clear(buf);
 		return FAIL;
 	    }
 	    /*
@@ -2138,7 +2326,10 @@ ml_append_int(buf, lnum, line, len, newfile)
 		{
 		    hp_new = ml_new_ptr(mfp);
 		    if (hp_new == NULL)	    /* TODO: try to fix tree */
+		    {
+			ml_idx_clear(buf);
 			return FAIL;
+		    }
 		    pp_new = (PTR_BL *)(hp_new->bh_data);
 
 		    if (hp->bh_bnum != 1)
@@ -2217,174 +2408,866 @@ ml_append_int(buf, lnum, line, len, newfile)
 	}
 	EMSG("Updated too many blocks?");
 	buf->b_ml.ml_stack_top = 0;	/* invalidate stack */
+	ml_idx_clear(buf);
     }
     return OK;
 }
 
 /*
- * replace line lnum, with buffering, in current buffer
+ * Start loading lines into the current buffer with ml_bulk_append().  Only
+ * possible when the buffer is empty.  Used when starting to edit a file,
+ * data blocks get negative numbers like with ml_append() for a new file.
+ * The lines are not in the buffer until ml_bulk_end() is called, they are
+ * put before the empty line.
  *
- * If copy is TRUE, make a copy of the line, otherwise the line has been
- * copied to allocated memory already.
- *
- * return FAIL for failure, OK otherwise
+ * return FAIL when ml_append() must be used, OK otherwise
  */
     int
-ml_replace(lnum, line, copy)
-    linenr_t	lnum;
-    char_u	*line;
-    int		copy;
+ml_bulk_start()
 {
-    if (line == NULL)		/* just checking... */
-	return FAIL;
-
-    if (curbuf->b_ml.ml_line_lnum != lnum)	    /* other line buffered */
-	ml_flush_line(curbuf);			    /* flush it */
-    else if (curbuf->b_ml.ml_flags & ML_LINE_DIRTY) /* same line allocated */
-	vim_free(curbuf->b_ml.ml_line_ptr);	    /* free it */
-    if (copy && (line = vim_strsave(line)) == NULL) /* allocate memory */
+    if (bulk.bi_buf != NULL || curbuf->b_ml.ml_mfp == NULL
+	    || !(curbuf->b_ml.ml_flags & ML_EMPTY)
+	    || curbuf->b_ml.ml_line_count != 1)
 	return FAIL;
-    curbuf->b_ml.ml_line_ptr = line;
-    curbuf->b_ml.ml_line_lnum = lnum;
-    curbuf->b_ml.ml_flags = (curbuf->b_ml.ml_flags | ML_LINE_DIRTY) & ~ML_EMPTY;
 
+    ml_bulk_init(curbuf);
+#ifdef LAZY_READ
+    /* an empty buffer has no lazy blocks, forget about an older file */
+    ml_lazy_close(curbuf);
+#endif
     return OK;
 }
 
+    static void
+ml_bulk_init(buf)
+    BUF		*buf;
+{
+    int		i;
+
+    bulk.bi_buf = buf;
+    bulk.bi_line_count = 0;
+    bulk.bi_data = NULL;
+    bulk.bi_levels = 0;
+    for (i = 0; i < BULK_LEVELS; ++i)
+	bulk.bi_ptr[i] = NULL;
+#ifdef LAZY_READ
+    bulk.bi_lazy = FALSE;
+    bulk.bi_page_count = 0;
+    bulk.bi_line_base = 0;
+#endif
+}
+
+#ifdef LAZY_READ
 /*
- * delete line 'lnum'
+ * Make bulk loading lazy: the lines appended with ml_bulk_append() are not
+ * copied, only the file offset of each data block is remembered.  The block
+ * is read from file "fname" when it is needed.  "fd" is the file descriptor
+ * the lines are read from, "fileformat" the format used to split them.  Only
+ * done for a regular file of at least 'lazyread' Kbyte.  Must be called before
+ * the first ml_bulk_append().
  *
- * return FAIL for failure, OK otherwise
+ * return FAIL when the lines must be copied, OK otherwise
  */
     int
-ml_delete(lnum, message)
-    linenr_t	lnum;
-    int		message;
+ml_bulk_lazy(fname, fd, fileformat)
+    char_u	*fname;
+    int		fd;
+    int		fileformat;
 {
-#ifdef SYNTAX_HL
-    if (curbuf->b_syn_change_lnum > lnum)
-	curbuf->b_syn_change_lnum = lnum;
-#endif
+    BUF		*buf = bulk.bi_buf;
+    struct stat	st, st_lazy;
+    int		lazy_fd;
+
+    if (buf == NULL || bulk.bi_line_count > 0 || p_lzr <= 0
+	    || fstat(fd, &st) < 0
+	    || !S_ISREG(st.st_mode)
+	    || st.st_size < p_lzr * 1024L)
+	return FAIL;
 
-    ml_flush_line(curbuf);
-    return ml_delete_int(curbuf, lnum, message);
+    /*
+     * Use another file descriptor, it has its own file offset.  It must be
+     * for the same file.
+     */
+    if ((lazy_fd = open((char *)fname, O_RDONLY | O_EXTRA)) < 0)
+	return FAIL;
+    if (fstat(lazy_fd, &st_lazy) < 0
+	    || st_lazy.st_dev != st.st_dev || st_lazy.st_ino != st.st_ino)
+    {
+	close(lazy_fd);
+	return FAIL;
+    }
+
+    buf->b_ml.ml_lazy_fd = lazy_fd;
+    buf->b_ml.ml_lazy_ff = fileformat;
+    bulk.bi_lazy = TRUE;
+    return OK;
 }
 
-    static int
-ml_delete_int(buf, lnum, message)
+/*
+ * Start appending more lines to buffer 'buf' with ml_bulk_append(), after
+ * the first part of the file was loaded lazily.  The lines continue in the
+ * same file, thus the text of the lines is not needed.  ml_bulk_end() adds
+ * them after the last line.
+ *
+ * return FAIL when not possible
+ */
+    int
+ml_bulk_more(buf)
     BUF		*buf;
-    linenr_t	lnum;
-    int		message;
 {
-    BHDR    *hp;
-    MEMFILE *mfp;
-    DATA_BL *dp;
-    PTR_BL  *pp;
-    IPTR    *ip;
-    int	    count;	    /* number of entries in block */
-    int	    idx;
-    int	    stack_idx;
-    int	    text_start;
-    int	    line_start;
-    int	    line_size;
-    int	    i;
-
-    if (lnum < 1 || lnum > buf->b_ml.ml_line_count)
+    if (bulk.bi_buf != NULL || buf->b_ml.ml_mfp == NULL
+	    || (buf->b_ml.ml_flags & ML_EMPTY)
+	    || buf->b_ml.ml_lazy_fd < 0)
 	return FAIL;
 
-    if (lowest_marked && lowest_marked > lnum)
-	lowest_marked--;
+    ml_bulk_init(buf);
+    bulk.bi_lazy = TRUE;
+    /* line numbers continue after the lines already in the buffer */
+    bulk.bi_line_base = buf->b_ml.ml_line_count;
+    bulk.bi_line_count = bulk.bi_line_base;
+    return OK;
+}
+#endif
 
 /*
- * If the file becomes empty the last line is replaced by an empty line.
+ * Append a line while bulk loading.  The line is copied into the data block
+ * being filled, when it doesn't fit a new data block is started.
+ *
+ * return FAIL for failure, OK otherwise
  */
-    if (buf->b_ml.ml_line_count == 1)	    /* file becomes empty */
+    int
+ml_bulk_append(line, len, offset)
+    char_u	*line;		/* text of the new line */
+    colnr_t	len;		/* length of line, including NUL, or 0 */
+    long	offset;		/* file offset of the line, for lazy loading */
+{
+    MEMFILE	*mfp = bulk.bi_buf->b_ml.ml_mfp;
+    DATA_BL	*dp;
+    int		page_size;
+    int		page_count;
+
+    if (len == 0)
+	len = STRLEN(line) + 1;
+
+#ifdef LAZY_READ
+    /* lazy: only count the space the line would take in the data block */
+    if (bulk.bi_lazy)
     {
-	if (message)
+	if (bulk.bi_page_count > 0 && bulk.bi_free < (int)(len + INDEX_SIZE)
+		&& ml_bulk_lazy_data(mfp) == FAIL)
+	    return FAIL;
+	if (bulk.bi_page_count == 0)
 	{
-	    keep_msg = no_lines_msg;
-	    keep_msg_attr = 0;
+	    page_size = mfp->mf_page_size;
+	    bulk.bi_page_count = (len + INDEX_SIZE + HEADER_SIZE
+						 + page_size - 1) / page_size;
+	    bulk.bi_free = bulk.bi_page_count * page_size - HEADER_SIZE;
+	    bulk.bi_offset = offset;
+	    bulk.bi_data_lnum = bulk.bi_line_count + 1;
 	}
-	i = ml_replace((linenr_t)1, (char_u *)"", TRUE);
-	buf->b_ml.ml_flags |= ML_EMPTY;
-	return i;
+	bulk.bi_free -= len + INDEX_SIZE;
+	++bulk.bi_line_count;
+	return OK;
     }
+#endif
 
-/*
- * find the data block containing the line
- * This also fills the stack with the blocks from the root to the data block
- * This also releases any locked block.
- */
-    mfp = buf->b_ml.ml_mfp;
-    if (mfp == NULL)
+    /* when the data block is full add it to the tree */
+    if (bulk.bi_data != NULL
+	    && (int)((DATA_BL *)(bulk.bi_data->bh_data))->db_free
+						    < (int)(len + INDEX_SIZE)
+	    && ml_bulk_data(mfp) == FAIL)
 	return FAIL;
+    if (bulk.bi_data == NULL)
+    {
+	page_size = mfp->mf_page_size;
+	page_count = (len + INDEX_SIZE + HEADER_SIZE + page_size - 1)
+								   / page_size;
+	if ((bulk.bi_data = ml_new_data(mfp, TRUE, page_count)) == NULL)
+	    return FAIL;
+	bulk.bi_data_lnum = bulk.bi_line_count + 1;
+    }
 
-    if ((hp = ml_find_line(buf, lnum, ML_DELETE)) == NULL)
-	return FAIL;
+    dp = (DATA_BL *)(bulk.bi_data->bh_data);
+    dp->db_txt_start -= len;
+    dp->db_free -= len + INDEX_SIZE;
+    dp->db_index[dp->db_line_count] = dp->db_txt_start;
+    ++(dp->db_line_count);
+    vim_memmove((char *)dp + dp->db_txt_start, line, (size_t)len);
+    ++bulk.bi_line_count;
+    return OK;
+}
 
-    dp = (DATA_BL *)(hp->bh_data);
-	    /* compute line count before the delete */
-    count = (long)(buf->b_ml.ml_locked_high) - (long)(buf->b_ml.ml_locked_low) + 2;
-    idx = lnum - buf->b_ml.ml_locked_low;
+/*
+ * Release the data block being filled and add it to the tree.
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    static int
+ml_bulk_data(mfp)
+    MEMFILE	*mfp;
+{
+    BHDR	*hp = bulk.bi_data;
+    blocknr_t	bnum = hp->bh_bnum;
+    int		page_count = hp->bh_page_count;
+    linenr_t	line_count = ((DATA_BL *)(hp->bh_data))->db_line_count;
 
-    --buf->b_ml.ml_line_count;
+    bulk.bi_data = NULL;
+    mf_put(mfp, hp, TRUE, FALSE);
+    return ml_bulk_add(0, bnum, page_count, bulk.bi_data_lnum, line_count);
+}
 
+#ifdef LAZY_READ
 /*
- * special case: If there is only one line in the data block it becomes empty.
- * Then we have to remove the entry, pointing to this data block, from the
- * pointer block. If this pointer block also becomes empty, we go up another
- * block, and so on, up to the root if necessary.
- * The line counts in the pointer blocks have already been adjusted by
- * ml_find_line().
+ * Add the lazy data block being counted to the tree: reserve a block number
+ * for it and remember where its lines are in the file.
+ *
+ * return FAIL for failure, OK otherwise
  */
-    if (count == 1)
-    {
-	mf_free(mfp, hp);	/* free the data block */
-	buf->b_ml.ml_locked = NULL;
+    static int
+ml_bulk_lazy_data(mfp)
+    MEMFILE	*mfp;
+{
+    struct growarray	*gap = &bulk.bi_buf->b_ml.ml_lazy;
+    MLLAZY		*lzp;
+    int			page_count = bulk.bi_page_count;
 
-	for (stack_idx = buf->b_ml.ml_stack_top - 1; stack_idx >= 0; --stack_idx)
-	{
-	    buf->b_ml.ml_stack_top = 0;	    /* stack is invalid when failing */
-	    ip = &(buf->b_ml.ml_stack[stack_idx]);
-	    idx = ip->ip_index;
-	    if ((hp = mf_get(mfp, ip->ip_bnum, 1)) == NULL)
-		return FAIL;
-	    pp = (PTR_BL *)(hp->bh_data);   /* must be pointer block */
-	    if (pp->pb_id != PTR_ID)
-	    {
-		EMSG("pointer block id wrong 4");
-		mf_put(mfp, hp, FALSE, FALSE);
-		return FAIL;
-	    }
-	    count = --(pp->pb_count);
-	    if (count == 0)	    /* the pointer block becomes empty! */
-		mf_free(mfp, hp);
-	    else
-	    {
-		if (count != idx)	/* move entries after the deleted one */
-		    vim_memmove(&pp->pb_pointer[idx], &pp->pb_pointer[idx + 1],
-				      (size_t)(count - idx) * sizeof(PTR_EN));
-		mf_put(mfp, hp, TRUE, FALSE);
+    if (ga_grow(gap, 1) == FAIL)
+	return FAIL;
+    lzp = (MLLAZY *)gap->ga_data + gap->ga_len;
+    lzp->lz_bnum = mf_reserve(mfp);
+    lzp->lz_offset = bulk.bi_offset;
+    lzp->lz_line_count = bulk.bi_line_count + 1 - bulk.bi_data_lnum;
+    ++gap->ga_len;
+    --gap->ga_room;
+
+    bulk.bi_page_count = 0;
+    return ml_bulk_add(0, lzp->lz_bnum, page_count, bulk.bi_data_lnum,
+							  lzp->lz_line_count);
+}
+#endif
 
-		buf->b_ml.ml_stack_top = stack_idx;	/* truncate stack */
-		    /* fix line count for rest of blocks in the stack */
-		if (buf->b_ml.ml_locked_lineadd)
-		{
-		    ml_lineadd(buf, buf->b_ml.ml_locked_lineadd);
-		    buf->b_ml.ml_stack[buf->b_ml.ml_stack_top].ip_high +=
-						buf->b_ml.ml_locked_lineadd;
-		}
-		++(buf->b_ml.ml_stack_top);
+/*
+ * Add an entry for block 'bnum', starting at line 'lnum', to the pointer
+ * block at 'level'.  When that pointer block is full it is added to the
+ * level above first.
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    static int
+ml_bulk_add(level, bnum, page_count, lnum, line_count)
+    int		level;
+    blocknr_t	bnum;
+    int		page_count;
+    linenr_t	lnum;
+    linenr_t	line_count;
+{
+    MEMFILE	*mfp = bulk.bi_buf->b_ml.ml_mfp;
+    PTR_BL	*pp;
+    PTR_EN	*pe;
 
-		return OK;
-	    }
-	}
-	CHECK(1, "deleted block 1?");
+    if (level >= BULK_LEVELS)
+	return FAIL;
 
-	return OK;
+    /* when the pointer block is full add it to the level above */
+    if (bulk.bi_ptr[level] != NULL)
+    {
+	pp = (PTR_BL *)(bulk.bi_ptr[level]->bh_data);
+	if (pp->pb_count >= pp->pb_count_max
+			       && ml_bulk_ptr(mfp, level, lnum) == FAIL)
+	    return FAIL;
+    }
+    if (bulk.bi_ptr[level] == NULL)
+    {
+	if ((bulk.bi_ptr[level] = ml_new_ptr(mfp)) == NULL)
+	    return FAIL;
+	bulk.bi_ptr_lnum[level] = lnum;
+	if (bulk.bi_levels <= level)
+	    bulk.bi_levels = level + 1;
     }
 
-    /*
+    pp = (PTR_BL *)(bulk.bi_ptr[level]->bh_data);
+    pe = &pp->pb_pointer[pp->pb_count];
+    pe->pe_bnum = bnum;
+    pe->pe_line_count = line_count;
+    pe->pe_old_lnum = lnum;
+    pe->pe_page_count = page_count;
+    ++pp->pb_count;
+    return OK;
+}
+
+/*
+ * Release the pointer block being filled at 'level' and add it to the level
+ * above.  'lnum' is the line after the last line in it.
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    static int
+ml_bulk_ptr(mfp, level, lnum)
+    MEMFILE	*mfp;
+    int		level;
+    linenr_t	lnum;
+{
+    BHDR	*hp = bulk.bi_ptr[level];
+    blocknr_t	bnum = hp->bh_bnum;
+
+    bulk.bi_ptr[level] = NULL;
+    mf_put(mfp, hp, TRUE, FALSE);
+    return ml_bulk_add(level + 1, bnum, 1, bulk.bi_ptr_lnum[level],
+					      lnum - bulk.bi_ptr_lnum[level]);
+}
+
+/*
+ * Finish bulk loading: put the loaded lines in the buffer, before the empty
+ * line.  The branches of the root block are added after the loaded data
+ * blocks, then the pointer blocks are linked up to the top one, which is
+ * copied into the root block.  When appending after ml_bulk_more() the top
+ * pointer block becomes a branch of the root block instead.
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    int
+ml_bulk_end()
+{
+    BUF		*buf = bulk.bi_buf;
+    MEMFILE	*mfp;
+    BHDR	*hp;
+    BHDR	*root_hp;
+    PTR_BL	*root;
+    linenr_t	lnum;
+    linenr_t	line_base = 0;
+    int		level;
+    int		i;
+    int		retval = OK;
+
+    if (buf == NULL)
+	return OK;
+    mfp = buf->b_ml.ml_mfp;
+#ifdef LAZY_READ
+    line_base = bulk.bi_line_base;
+#endif
+
+    if (bulk.bi_data != NULL)
+	retval = ml_bulk_data(mfp);
+#ifdef LAZY_READ
+    else if (bulk.bi_page_count > 0)
+	retval = ml_bulk_lazy_data(mfp);
+#endif
+
+    if (retval == OK && bulk.bi_line_count > line_base)
+    {
+	/* the tree is changed: release the locked block and buffered line */
+	ml_flush_line(buf);
+	(void)ml_find_line(buf, (linenr_t)0, ML_FLUSH);
+
+	if ((root_hp = mf_get(mfp, (blocknr_t)1, 1)) == NULL)
+	    retval = FAIL;
+	else
+	{
+	    root = (PTR_BL *)(root_hp->bh_data);
+	    lnum = bulk.bi_line_count + 1;
+	    for (i = 0; i < (int)root->pb_count && retval == OK
+						      && line_base == 0; ++i)
+	    {
+		retval = ml_bulk_add(0, root->pb_pointer[i].pe_bnum,
+			 root->pb_pointer[i].pe_page_count, lnum,
+			 root->pb_pointer[i].pe_line_count);
+		lnum += root->pb_pointer[i].pe_line_count;
+	    }
+
+	    /* the levels above may grow while adding to them */
+	    for (level = 0; level < bulk.bi_levels - 1 && retval == OK;
+								      ++level)
+		retval = ml_bulk_ptr(mfp, level, lnum);
+
+	    if (retval == OK)
+	    {
+		hp = bulk.bi_ptr[level];
+		bulk.bi_ptr[level] = NULL;
+#ifdef LAZY_READ
+		if (line_base > 0)
+		    retval = ml_bulk_graft(buf, root, hp);
+		else
+#endif
+		{
+		    vim_memmove(root, hp->bh_data, (size_t)mfp->mf_page_size);
+		    mf_free(mfp, hp);
+		}
+	    }
+	    if (retval == OK)
+	    {
+		buf->b_ml.ml_line_count += bulk.bi_line_count - line_base;
+		buf->b_ml.ml_flags &= ~ML_EMPTY;
+		buf->b_ml.ml_stack_top = 0;
+		ml_idx_clear(buf);
+		if (lowest_marked)
+		    lowest_marked = 1;
+#ifdef SYNTAX_HL
+		if (buf->b_syn_change_lnum > line_base + 1)
+		    buf->b_syn_change_lnum = line_base + 1;
+#endif
+#ifdef EXTRA_SEARCH
+		search_hl_changed(buf, line_base + 1,
+				       (long)(bulk.bi_line_count - line_base));
+#endif
+	    }
+	    mf_put(mfp, root_hp, retval == OK, FALSE);
+	}
+    }
+
+    /* after a failure the buffer is unchanged, the loaded lines are lost */
+    for (level = 0; level < bulk.bi_levels; ++level)
+	if (bulk.bi_ptr[level] != NULL)
+	    mf_free(mfp, bulk.bi_ptr[level]);
+#ifdef LAZY_READ
+    /* when appending the lines before are still needed */
+    if ((retval == FAIL && line_base == 0) || buf->b_ml.ml_lazy.ga_len == 0)
+	ml_lazy_close(buf);
+#endif
+    bulk.bi_buf = NULL;
+    return retval;
+}
+
+#ifdef LAZY_READ
+/*
+ * Add the tree of appended lines with top block 'hp' as the last branch of
+ * the root block 'root'.  A pointer block must not have both data blocks and
+ * pointer blocks as branches.  When the root block is full or its branches
+ * are data blocks they are moved to a new pointer block first, which then is
+ * the only branch.
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    static int
+ml_bulk_graft(buf, root, hp)
+    BUF		*buf;
+    PTR_BL	*root;
+    BHDR	*hp;
+{
+    MEMFILE	*mfp = buf->b_ml.ml_mfp;
+    BHDR	*hp_new;
+    PTR_EN	*pe;
+
+    if (root->pb_count >= root->pb_count_max || ml_ptr_has_data(buf, root))
+    {
+	if ((hp_new = ml_new_ptr(mfp)) == NULL)
+	{
+	    mf_free(mfp, hp);
+	    return FAIL;
+	}
+	vim_memmove(hp_new->bh_data, root, (size_t)mfp->mf_page_size);
+	pe = &root->pb_pointer[0];
+	pe->pe_bnum = hp_new->bh_bnum;
+	pe->pe_line_count = buf->b_ml.ml_line_count;
+	pe->pe_old_lnum = 1;
+	pe->pe_page_count = 1;
+	root->pb_count = 1;
+	mf_put(mfp, hp_new, TRUE, FALSE);
+    }
+
+    pe = &root->pb_pointer[root->pb_count];
+    pe->pe_bnum = hp->bh_bnum;
+    pe->pe_line_count = bulk.bi_line_count - bulk.bi_line_base;
+    pe->pe_old_lnum = bulk.bi_line_base + 1;
+    pe->pe_page_count = 1;
+    ++root->pb_count;
+    mf_put(mfp, hp, TRUE, FALSE);
+    return OK;
+}
+
+/*
+ * Return TRUE when the branches of pointer block 'pp' are data blocks, also
+ * when that can't be found out.
+ */
+    static int
+ml_ptr_has_data(buf, pp)
+    BUF		*buf;
+    PTR_BL	*pp;
+{
+    MEMFILE	*mfp = buf->b_ml.ml_mfp;
+    PTR_EN	*pe = &pp->pb_pointer[0];
+    BHDR	*hp;
+    int		retval = TRUE;
+
+    if (pp->pb_count == 0 || ml_lazy_find(buf, pe->pe_bnum) != NULL)
+	return TRUE;
+    if (pe->pe_bnum < 0)	/* a negative block number may have changed */
+	pe->pe_bnum = mf_trans_del(mfp, pe->pe_bnum);
+    if ((hp = mf_get(mfp, pe->pe_bnum, pe->pe_page_count)) != NULL)
+    {
+	retval = (((PTR_BL *)(hp->bh_data))->pb_id != PTR_ID);
+	mf_put(mfp, hp, FALSE, FALSE);
+    }
+    return retval;
+}
+#endif
+
+#ifdef LAZY_READ
+/*
+ * Find the ml_lazy entry for data block 'bnum'.
+ * Return NULL when 'bnum' is not a lazy data block.
+ */
+    static MLLAZY *
+ml_lazy_find(buf, bnum)
+    BUF		*buf;
+    blocknr_t	bnum;
+{
+    MLLAZY	*lzp = (MLLAZY *)buf->b_ml.ml_lazy.ga_data;
+    int		bot = 0;
+    int		top = buf->b_ml.ml_lazy.ga_len - 1;
+    int		mid;
+
+    if (bnum >= 0)
+	return NULL;
+    while (bot <= top)		/* block numbers are decreasing */
+    {
+	mid = (bot + top) / 2;
+	if (lzp[mid].lz_bnum == bnum)
+	    return &lzp[mid];
+	if (lzp[mid].lz_bnum > bnum)
+	    bot = mid + 1;
+	else
+	    top = mid - 1;
+    }
+    return NULL;
+}
+
+/*
+ * Read lazy data block 'bnum' from the file.  Must only be called for a
+ * block number found in the tree and not in the memfile: the block was not
+ * changed since it was loaded.  The lines are split like readfile() did.
+ *
+ * Return the locked block, NULL when 'bnum' is not a lazy data block or
+ * there is not enough memory.
+ */
+    static BHDR *
+ml_lazy_get(buf, bnum, page_count)
+    BUF		*buf;
+    blocknr_t	bnum;
+    int		page_count;
+{
+    MEMFILE	*mfp = buf->b_ml.ml_mfp;
+    int		fd = buf->b_ml.ml_lazy_fd;
+    int		fileformat = buf->b_ml.ml_lazy_ff;
+    MLLAZY	*lzp;
+    BHDR	*hp;
+    DATA_BL	*dp;
+    char_u	*buffer;
+    char_u	*p, *line, *end;
+    long	size;
+    linenr_t	n;
+    int		len;
+    int		room;
+    int		changed = FALSE;
+
+    if ((lzp = ml_lazy_find(buf, bnum)) == NULL)
+	return NULL;
+
+    /*
+     * A block ends where the next one starts.  The last one can't be bigger
+     * than twice the block size: each line has at most two bytes for the
+     * line break where the block has a NUL and an index entry.
+     */
+    if (lzp == (MLLAZY *)buf->b_ml.ml_lazy.ga_data
+					       + buf->b_ml.ml_lazy.ga_len - 1)
+	size = 2L * page_count * mfp->mf_page_size;
+    else
+	size = lzp[1].lz_offset - lzp->lz_offset;
+    if ((buffer = lalloc((long_u)size, TRUE)) == NULL)
+	return NULL;
+    if (lseek(fd, (off_t)lzp->lz_offset, SEEK_SET) != (off_t)lzp->lz_offset
+	    || (size = read(fd, (char *)buffer, (size_t)size)) < 0)
+	size = 0;			/* read error: lines become empty */
+
+    if ((hp = mf_get_lazy(mfp, bnum, page_count)) == NULL)
+    {
+	vim_free(buffer);
+	return NULL;
+    }
+    dp = (DATA_BL *)(hp->bh_data);
+    dp->db_id = DATA_ID;
+    dp->db_txt_start = dp->db_txt_end = page_count * mfp->mf_page_size;
+    dp->db_free = dp->db_txt_start - HEADER_SIZE;
+    dp->db_line_count = 0;
+
+    end = buffer + size;
+    p = buffer;
+    for (n = lzp->lz_line_count; n > 0; --n)
+    {
+	line = p;
+	while (p < end && *p != NL && (*p != CR || fileformat != EOL_MAC))
+	{
+	    if (*p == NUL)
+		*p = NL;	/* NULs are replaced by newlines! */
+	    ++p;
+	}
+	len = p - line;
+	if (p < end)
+	{
+	    if (fileformat == EOL_DOS && *p == NL
+					    && len > 0 && line[len - 1] == CR)
+		--len;		/* remove CR */
+	    ++p;
+	}
+	else if (len == 0)	/* the file is shorter now */
+	    changed = TRUE;
+
+	/* keep room for the remaining lines, the file may have changed */
+	room = dp->db_free - (int)INDEX_SIZE - 1
+					 - (int)(n - 1) * (int)(INDEX_SIZE + 1);
+	if (len > room)
+	{
+	    len = room;
+	    changed = TRUE;
+	}
+	dp->db_txt_start -= len + 1;
+	dp->db_free -= len + 1 + INDEX_SIZE;
+	dp->db_index[dp->db_line_count] = dp->db_txt_start;
+	++(dp->db_line_count);
+	vim_memmove((char *)dp + dp->db_txt_start, line, (size_t)len);
+	*((char_u *)dp + dp->db_txt_start + len) = NUL;
+    }
+    vim_free(buffer);
+
+    if (changed)
+	EMSG2("File \"%s\" was changed, lines read from it may be wrong",
+							      buf->b_fname);
+    return hp;
+}
+
+/*
+ * File "fname" is going to be written.  When a buffer reads data blocks from
+ * it, read them all now, they are kept in memory or in the swap file.
+ */
+    void
+ml_lazy_release(fname)
+    char_u	*fname;
+{
+    BUF		*buf;
+    struct stat	st, st_lazy;
+
+    if (stat((char *)fname, &st) < 0)	    /* new file */
+	return;
+    for (buf = firstbuf; buf != NULL; buf = buf->b_next)
+	if (buf->b_ml.ml_mfp != NULL && buf->b_ml.ml_lazy_fd >= 0
+		&& fstat(buf->b_ml.ml_lazy_fd, &st_lazy) >= 0
+		&& st_lazy.st_dev == st.st_dev && st_lazy.st_ino == st.st_ino)
+	    ml_lazy_copy(buf);
+}
+
+/*
+ * Read all lazy data blocks of "buf" and mark them changed, so that they
+ * don't need to be read from the file again.
+ */
+    static void
+ml_lazy_copy(buf)
+    BUF		*buf;
+{
+    linenr_t	lnum;
+
+    ml_flush_line(buf);
+    for (lnum = 1; lnum <= buf->b_ml.ml_line_count;
+					  lnum = buf->b_ml.ml_locked_high + 1)
+    {
+	if (ml_find_line(buf, lnum, ML_FIND) == NULL)
+	    return;		/* keep the file, blocks may still be lazy */
+	if (buf->b_ml.ml_locked->bh_flags & BH_LAZY)
+	    buf->b_ml.ml_flags |= ML_LOCKED_DIRTY;
+    }
+    (void)ml_find_line(buf, (linenr_t)0, ML_FLUSH);
+    ml_lazy_close(buf);
+}
+
+/*
+ * Forget about the lazy data blocks of "buf".
+ */
+    static void
+ml_lazy_close(buf)
+    BUF		*buf;
+{
+    if (buf->b_ml.ml_lazy_fd >= 0)
+    {
+	close(buf->b_ml.ml_lazy_fd);
+	buf->b_ml.ml_lazy_fd = -1;
+    }
+    ga_clear(&buf->b_ml.ml_lazy);
+}
+#endif
+
+/*
+ * replace line lnum, with buffering, in current buffer
+ *
+ * If copy is TRUE, make a copy of the line, otherwise the line has been
+ * copied to allocated memory already.
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    int
+ml_replace(lnum, line, copy)
+    linenr_t	lnum;
+    char_u	*line;
+    int		copy;
+{
+    if (line == NULL)		/* just checking... */
+	return FAIL;
+
+    if (curbuf->b_ml.ml_line_lnum != lnum)	    /* other line buffered */
+	ml_flush_line(curbuf);			    /* flush it */
+    else if (curbuf->b_ml.ml_flags & ML_LINE_DIRTY) /* same line allocated */
+	vim_free(curbuf->b_ml.ml_line_ptr);	    /* free it */
+    if (copy && (line = vim_strsave(line)) == NULL) /* allocate memory */
+	return FAIL;
+    curbuf->b_ml.ml_line_ptr = line;
+    curbuf->b_ml.ml_line_lnum = lnum;
+    curbuf->b_ml.ml_flags = (curbuf->b_ml.ml_flags | ML_LINE_DIRTY) & ~ML_EMPTY;
+#ifdef EXTRA_SEARCH
+    search_hl_changed(curbuf, lnum, 0L);
+#endif
+
+    return OK;
+}
+
+/*
+ * delete line 'lnum'
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    int
+ml_delete(lnum, message)
+    linenr_t	lnum;
+    int		message;
+{
+#ifdef SYNTAX_HL
+    if (curbuf->b_syn_change_lnum > lnum)
+	curbuf->b_syn_change_lnum = lnum;
+#endif
+#ifdef EXTRA_SEARCH
+    search_hl_changed(curbuf, lnum, -1L);
+#endif
+
+    ml_flush_line(curbuf);
+    return ml_delete_int(curbuf, lnum, message);
+}
+
+    static int
+ml_delete_int(buf, lnum, message)
+    BUF		*buf;
+    linenr_t	lnum;
+    int		message;
+{
+    BHDR    *hp;
+    MEMFILE *mfp;
+    DATA_BL *dp;
+    PTR_BL  *pp;
+    IPTR    *ip;
+    int	    count;	    /* number of entries in block */
+    int	    idx;
+    int	    stack_idx;
+    int	    text_start;
+    int	    line_start;
+    int	    line_size;
+    int	    i;
+
+    if (lnum < 1 || lnum > buf->b_ml.ml_line_count)
+	return FAIL;
+
+    if (lowest_marked && lowest_marked > lnum)
+	lowest_marked--;
+
+/*
+ * If the file becomes empty the last line is replaced by an empty line.
+ */
+    if (buf->b_ml.ml_line_count == 1)	    /* file becomes empty */
+    {
+	if (message)
+	{
+	    keep_msg = no_lines_msg;
+	    keep_msg_attr = 0;
+	}
+	i = ml_replace((linenr_t)1, (char_u *)"", TRUE);
+	buf->b_ml.ml_flags |= ML_EMPTY;
+	return i;
+    }
+
+/*
+ * find the data block containing the line
+ * This also fills the stack with the blocks from the root to the data block
+ * This also releases any locked block.
+ */
+    mfp = buf->b_ml.ml_mfp;
+    if (mfp == NULL)
+	return FAIL;
+
+    if ((hp = ml_find_line(buf, lnum, ML_DELETE)) == NULL)
+	return FAIL;
+
+    dp = (DATA_BL *)(hp->bh_data);
+	    /* compute line count before the delete */
+    count = (long)(buf->b_ml.ml_locked_high) - (long)(buf->b_ml.ml_locked_low) + 2;
+    idx = lnum - buf->b_ml.ml_locked_low;
+
+    --buf->b_ml.ml_line_count;
+
+/*
+ * special case: If there is only one line in the data block it becomes empty.
+ * Then we have to remove the entry, pointing to this data block, from the
+ * pointer block. If this pointer block also becomes empty, we go up another
+ * block, and so on, up to the root if necessary.
+ * The line counts in the pointer blocks have already been adjusted by
+ * ml_find_line().
+ */
+    if (count == 1)
+    {
+	mf_free(mfp, hp);	/* free the data block */
+	buf->b_ml.ml_locked = NULL;
+	ml_idx_remove(buf, buf->b_ml.ml_locked_low);
+
+	for (stack_idx = buf->b_ml.ml_stack_top - 1; stack_idx >= 0; --stack_idx)
+	{
+	    buf->b_ml.ml_stack_top = 0;	    /* stack is invalid when failing */
+	    ip = &(buf->b_ml.ml_stack[stack_idx]);
+	    idx = ip->ip_index;
+	    if ((hp = mf_get(mfp, ip->ip_bnum, 1)) == NULL)
+	    {
+		ml_idx_clear(buf);
+		return FAIL;
+	    }
+	    pp = (PTR_BL *)(hp->bh_data);   /* must be pointer block */
+	    if (pp->pb_id != PTR_ID)
+	    {
+		EMSG("pointer block id wrong 4");
+		mf_put(mfp, hp, FALSE, FALSE);
+		ml_idx_clear(buf);
+		return FAIL;
+	    }
+	    count = --(pp->pb_count);
+	    if (count == 0)	    /* the pointer block becomes empty! */
+		mf_free(mfp, hp);
+	    else
+	    {
+		if (count != idx)	/* move entries after the deleted one */
+		    vim_memmove(&pp->pb_pointer[idx], &pp->pb_pointer[idx + 1],
+				      (size_t)(count - idx) * sizeof(PTR_EN));
+		mf_put(mfp, hp, TRUE, FALSE);
+
+		buf->b_ml.ml_stack_top = stack_idx;	/* truncate stack */
+		    /* fix line count for rest of blocks in the stack */
+		if (buf->b_ml.ml_locked_lineadd)
+		{
+		    ml_lineadd(buf, buf->b_ml.ml_locked_lineadd);
+		    buf->b_ml.ml_stack[buf->b_ml.ml_stack_top].ip_high +=
+						buf->b_ml.ml_locked_lineadd;
+		}
+		++(buf->b_ml.ml_stack_top);
+
+		return OK;
+	    }
+	}
+	CHECK(1, "deleted block 1?");
+
+	return OK;
+    }
+
+    /*
      * delete the text by moving the next lines forwards
      */
     text_start = dp->db_txt_start;
@@ -2549,6 +3432,71 @@ ml_clearmarked()
     return;
 }
 
+/*
+ * Find the first line from "lnum" to "end" in buffer "buf" that matches
+ * "prog", going in direction "dir".  Matching is done with context "rex".
+ * The text of the data blocks is used directly: a block is skipped when the
+ * strings that a match must include don't appear anywhere in it, only the
+ * lines of the other blocks are matched one by one.
+ * Returns the number of the matching line, "end" when there is none (that
+ * line must still be checked by the caller).  When interrupted the line where
+ * it stopped is returned.
+ */
+    linenr_t
+ml_find_match(buf, lnum, end, dir, rex, prog)
+    BUF		*buf;
+    linenr_t	lnum;
+    linenr_t	end;
+    int		dir;
+    REGEXEC	*rex;
+    vim_regexp	*prog;
+{
+    BHDR	*hp;
+    DATA_BL	*dp;
+    linenr_t	low;
+    linenr_t	last;
+
+    if (buf->b_ml.ml_mfp == NULL)
+	return end;
+    ml_flush_line(buf);			/* flush buffered line */
+
+    while (dir == FORWARD ? lnum < end : lnum > end)
+    {
+	if ((hp = ml_find_line(buf, lnum, ML_FIND)) == NULL)
+	    return lnum;
+	dp = (DATA_BL *)(hp->bh_data);
+	low = buf->b_ml.ml_locked_low;
+
+	/* "last" is the last line in this block to look at */
+	if (dir == FORWARD)
+	    last = (end < buf->b_ml.ml_locked_high)
+					      ? end : buf->b_ml.ml_locked_high;
+	else
+	    last = (end > low) ? end : low;
+
+	if (vim_regmust_found(rex, prog, (char_u *)dp + dp->db_txt_start,
+					       (char_u *)dp + dp->db_txt_end))
+	{
+	    for ( ; ; lnum += dir)
+	    {
+		if (vim_regexec(rex, prog, (char_u *)dp
+			    + (dp->db_index[lnum - low] & DB_INDEX_MASK), TRUE))
+		    return lnum;
+		if (lnum == last)
+		    break;
+	    }
+	}
+	if (last == end)
+	    break;
+	lnum = last + dir;
+
+	line_breakcheck();
+	if (got_int)
+	    return lnum;
+    }
+    return end;
+}
+
 /*
  * flush ml_line if necessary
  */
@@ -2692,12 +3640,15 @@ ml_new_ptr(mfp)
  *   action: if ML_DELETE or ML_INSERT the line count is updated while searching
  *	     if ML_FLUSH only flush a locked block
  *	     if ML_FIND just find the line
+ *	     if ML_WALK find the line through the pointer blocks
  *
  * If the block was found it is locked and put in ml_locked.
  * The stack is updated to lead to the locked block. The ip_high field in
  * the stack is updated to reflect the last line in the block AFTER the
  * insert or delete, also if the pointer block has not been updated yet. But
  * if if ml_locked != NULL ml_locked_lineadd must be added to ip_high.
+ * For ML_FIND the block may be found with the line index, then the stack is
+ * empty.
  *
  * return: NULL for failure, pointer to block header otherwise
  */
@@ -2719,6 +3670,7 @@ ml_find_line(buf, lnum, action)
     int		top;
     int		page_count;
     int		idx;
+    linenr_t	walk_lnum = 0;
 
     mfp = buf->b_ml.ml_mfp;
 
@@ -2727,11 +3679,15 @@ ml_find_line(buf, lnum, action)
      * If not, flush and release the locked block.
      * Don't do this for ML_INSERT_SAME, because the stack need to be updated.
      * Don't do this for ML_FLUSH, because we want to flush the locked block.
+     * Don't do this for ML_INSERT and ML_DELETE when the block was found with
+     * the line index, the stack is empty then.
      */
     if (buf->b_ml.ml_locked)
     {
 	if (ML_SIMPLE(action) && buf->b_ml.ml_locked_low <= lnum &&
-				    buf->b_ml.ml_locked_high >= lnum)
+				    buf->b_ml.ml_locked_high >= lnum &&
+		       (buf->b_ml.ml_stack_top > 0 || action == ML_FIND ||
+							  action == ML_WALK))
 	{
 		/* remember to update pointer blocks and stack later */
 	    if (action == ML_INSERT)
@@ -2747,9 +3703,24 @@ ml_find_line(buf, lnum, action)
 	    return (buf->b_ml.ml_locked);
 	}
 
-	mf_put(mfp, buf->b_ml.ml_locked, buf->b_ml.ml_flags & ML_LOCKED_DIRTY,
+	/*
+	 * A block with a negative number that was found with the line index
+	 * may get a positive number now.  The pointer block must then be
+	 * updated, walk the tree to it below.
+	 */
+	hp = buf->b_ml.ml_locked;
+	ml_idx_sync(buf, buf->b_ml.ml_locked_low, hp);
+	if (buf->b_ml.ml_stack_top == 0 && hp->bh_bnum < 0
+				       && (buf->b_ml.ml_flags & ML_LOCKED_POS))
+	    walk_lnum = buf->b_ml.ml_locked_low;
+	mf_put(mfp, hp, buf->b_ml.ml_flags & ML_LOCKED_DIRTY,
 					    buf->b_ml.ml_flags & ML_LOCKED_POS);
 	buf->b_ml.ml_locked = NULL;
+	if (walk_lnum != 0 && hp->bh_bnum >= 0)
+	{
+	    (void)ml_find_line(buf, walk_lnum, ML_WALK);
+	    (void)ml_find_line(buf, (linenr_t)0, ML_FLUSH);
+	}
 
 	    /*
 	     * if lines have been added or deleted in the locked block, need to
@@ -2767,7 +3738,7 @@ ml_find_line(buf, lnum, action)
     low = 1;
     high = buf->b_ml.ml_line_count;
 
-    if (action == ML_FIND)	/* first try stack entries */
+    if (action == ML_FIND || action == ML_WALK)	/* first try stack entries */
     {
 	for (top = buf->b_ml.ml_stack_top - 1; top >= 0; --top)
 	{
@@ -2781,6 +3752,13 @@ ml_find_line(buf, lnum, action)
 		break;
 	    }
 	}
+	/*
+	 * When only the root contains the line, use the line index instead of
+	 * walking down the whole tree.
+	 */
+	if (top <= 0 && action == ML_FIND
+				&& (hp = ml_idx_find_line(buf, lnum)) != NULL)
+	    return hp;
 	if (top < 0)
 	    buf->b_ml.ml_stack_top = 0;		/* not found, start at the root */
     }
@@ -2792,7 +3770,12 @@ ml_find_line(buf, lnum, action)
  */
     for (;;)
     {
-	if ((hp = mf_get(mfp, bnum, page_count)) == NULL)
+	hp = mf_get(mfp, bnum, page_count);
+#ifdef LAZY_READ
+	if (hp == NULL)		/* may have to read it from the file */
+	    hp = ml_lazy_get(buf, bnum, page_count);
+#endif
+	if (hp == NULL)
 	    goto error_noblock;
 
 	/*
@@ -2806,6 +3789,17 @@ ml_find_line(buf, lnum, action)
 	dp = (DATA_BL *)(hp->bh_data);
 	if (dp->db_id == DATA_ID)	/* data block */
 	{
+	    /* the line index may have an old number for this block */
+	    if (buf->b_ml.ml_idx.ga_len > 0)
+	    {
+		idx = ml_idx_search(buf, low);
+		if (idx >= 0 && ml_idx_low(buf, idx) == low)
+		{
+		    ((MLIDX *)buf->b_ml.ml_idx.ga_data)[idx].ie_bnum = bnum;
+		    ((MLIDX *)buf->b_ml.ml_idx.ga_data)[idx].ie_page_count =
+								   page_count;
+		}
+	    }
 	    buf->b_ml.ml_locked = hp;
 	    buf->b_ml.ml_locked_low = low;
 	    buf->b_ml.ml_locked_high = high;
@@ -2970,6 +3964,364 @@ ml_lineadd(buf, count)
     }
 }
 
+/*
+ * Find the data block for line 'lnum' with the line index.  The index is
+ * built when it doesn't exist yet.
+ * The block is locked and put in ml_locked, like ml_find_line() does, but the
+ * stack is emptied.
+ *
+ * return: NULL when the index can't be used, pointer to block header otherwise
+ */
+    static BHDR *
+ml_idx_find_line(buf, lnum)
+    BUF		*buf;
+    linenr_t	lnum;
+{
+    MLIDX	*ep;
+    BHDR	*hp;
+    DATA_BL	*dp;
+    linenr_t	low;
+    int		idx;
+
+    if (lnum > buf->b_ml.ml_line_count)
+	return NULL;
+    if (buf->b_ml.ml_idx.ga_len == 0 && ml_idx_build(buf) == FAIL)
+	return NULL;
+    idx = ml_idx_search(buf, lnum);
+    if (idx < 0)
+	return NULL;
+    ep = (MLIDX *)buf->b_ml.ml_idx.ga_data + idx;
+    low = ml_idx_low(buf, idx);
+
+    /*
+     * A negative number is not found when the block got a positive number
+     * since the index entry was made.  Walking the tree updates the entry.
+     */
+    if ((hp = mf_get(buf->b_ml.ml_mfp, ep->ie_bnum, ep->ie_page_count)) == NULL)
+	return NULL;
+    dp = (DATA_BL *)(hp->bh_data);
+    if (dp->db_id != DATA_ID || dp->db_line_count != ep->ie_line_count)
+    {
+	/* index doesn't match the tree: don't use it */
+	mf_put(buf->b_ml.ml_mfp, hp, FALSE, FALSE);
+	ml_idx_clear(buf);
+	return NULL;
+    }
+
+    buf->b_ml.ml_stack_top = 0;
+    buf->b_ml.ml_locked = hp;
+    buf->b_ml.ml_locked_low = low;
+    buf->b_ml.ml_locked_high = low + ep->ie_line_count - 1;
+    buf->b_ml.ml_locked_lineadd = 0;
+    buf->b_ml.ml_flags &= ~(ML_LOCKED_DIRTY | ML_LOCKED_POS);
+    return hp;
+}
+
+/*
+ * Build the line index for 'buf' by going through all the pointer blocks.
+ * Must not be called while a block is locked.
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    static int
+ml_idx_build(buf)
+    BUF		*buf;
+{
+    ml_idx_clear(buf);
+    if (ml_idx_add_branch(buf, (blocknr_t)1, 1) == FAIL)
+    {
+	ml_idx_clear(buf);
+	return FAIL;
+    }
+    ml_idx_tree(buf, 0);
+    return OK;
+}
+
+/*
+ * Add the data blocks of the branch at block 'bnum' to the line index.
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    static int
+ml_idx_add_branch(buf, bnum, page_count)
+    BUF		*buf;
+    blocknr_t	bnum;
+    int		page_count;
+{
+    MEMFILE	*mfp = buf->b_ml.ml_mfp;
+    BHDR	*hp;
+    PTR_BL	*pp;
+    PTR_EN	*pe;
+    blocknr_t	bnum2;
+    int		dirty = FALSE;
+    int		retval = OK;
+    int		idx;
+#ifdef LAZY_READ
+    MLLAZY	*lzp;
+#endif
+
+    if ((hp = mf_get(mfp, bnum, page_count)) == NULL)
+    {
+#ifdef LAZY_READ
+	/* a lazy data block was not changed, don't read it */
+	if ((lzp = ml_lazy_find(buf, bnum)) != NULL)
+	    return ml_idx_insert(buf, buf->b_ml.ml_idx.ga_len,
+				     lzp->lz_line_count, bnum, page_count);
+#endif
+	return FAIL;
+    }
+    pp = (PTR_BL *)(hp->bh_data);
+    if (((DATA_BL *)pp)->db_id == DATA_ID)
+	retval = ml_idx_insert(buf, buf->b_ml.ml_idx.ga_len,
+			 ((DATA_BL *)pp)->db_line_count, bnum, page_count);
+    else if (pp->pb_id != PTR_ID)
+	retval = FAIL;
+    else
+	for (idx = 0; idx < (int)pp->pb_count && retval == OK; ++idx)
+	{
+	    pe = &pp->pb_pointer[idx];
+	    if (pe->pe_bnum < 0)	/* may have been changed, see ml_find_line() */
+	    {
+		bnum2 = mf_trans_del(mfp, pe->pe_bnum);
+		if (pe->pe_bnum != bnum2)
+		{
+		    pe->pe_bnum = bnum2;
+		    dirty = TRUE;
+		}
+	    }
+	    retval = ml_idx_add_branch(buf, pe->pe_bnum, pe->pe_page_count);
+	}
+    mf_put(mfp, hp, dirty, FALSE);
+    return retval;
+}
+
+/*
+ * Fill in ie_tree for entries 'idx' and further of the line index.  Needed
+ * after entries were inserted or removed.
+ * Entry k - 1 holds the line count of entries k - (k & -k) to k - 1, like a
+ * binary indexed tree.  It is computed from the entries that it covers, which
+ * come before it and are already right.
+ */
+    static void
+ml_idx_tree(buf, idx)
+    BUF		*buf;
+    int		idx;
+{
+    MLIDX	*ep = (MLIDX *)buf->b_ml.ml_idx.ga_data;
+    int		n = buf->b_ml.ml_idx.ga_len;
+    int		k, step;
+
+    for (k = idx + 1; k <= n; ++k)
+    {
+	ep[k - 1].ie_tree = ep[k - 1].ie_line_count;
+	for (step = 1; step < (k & -k); step <<= 1)
+	    ep[k - 1].ie_tree += ep[k - step - 1].ie_tree;
+    }
+}
+
+/*
+ * Return the first line in the data block of line index entry 'idx'.
+ */
+    static linenr_t
+ml_idx_low(buf, idx)
+    BUF		*buf;
+    int		idx;
+{
+    MLIDX	*ep = (MLIDX *)buf->b_ml.ml_idx.ga_data;
+    linenr_t	low = 1;
+    int		k;
+
+    for (k = idx; k > 0; k -= k & -k)
+	low += ep[k - 1].ie_tree;
+    return low;
+}
+
+/*
+ * Find the line index entry for the data block that contains line 'lnum'.
+ *
+ * return: -1 when not found, index of the entry otherwise
+ */
+    static int
+ml_idx_search(buf, lnum)
+    BUF		*buf;
+    linenr_t	lnum;
+{
+    MLIDX	*ep = (MLIDX *)buf->b_ml.ml_idx.ga_data;
+    int		n = buf->b_ml.ml_idx.ga_len;
+    int		pos = 0;
+    int		step;
+    linenr_t	before = 0;
+
+    if (n == 0 || lnum < 1)
+	return -1;
+    /* find the number of entries that end before 'lnum' */
+    for (step = 1; step * 2 <= n; step *= 2)
+	;
+    for ( ; step > 0; step /= 2)
+	if (pos + step <= n && before + ep[pos + step - 1].ie_tree < lnum)
+	{
+	    pos += step;
+	    before += ep[pos - 1].ie_tree;
+	}
+    if (pos >= n)
+	return -1;
+    return pos;
+}
+
+/*
+ * Insert an entry in the line index at position 'idx', for a data block
+ * with 'line_count' lines.  The caller must call ml_idx_tree() afterwards.
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    static int
+ml_idx_insert(buf, idx, line_count, bnum, page_count)
+    BUF		*buf;
+    int		idx;
+    linenr_t	line_count;
+    blocknr_t	bnum;
+    int		page_count;
+{
+    struct growarray	*gap = &buf->b_ml.ml_idx;
+    MLIDX		*ep;
+
+    /* grow by half the size, the index can get big */
+    if (gap->ga_growsize < gap->ga_len / 2)
+	gap->ga_growsize = gap->ga_len / 2;
+    if (ga_grow(gap, 1) == FAIL)
+	return FAIL;
+    ep = (MLIDX *)gap->ga_data + idx;
+    if (idx < gap->ga_len)
+	vim_memmove(ep + 1, ep, (size_t)(gap->ga_len - idx) * sizeof(MLIDX));
+    ++gap->ga_len;
+    --gap->ga_room;
+
+    ep->ie_line_count = line_count;
+    ep->ie_bnum = bnum;
+    ep->ie_page_count = page_count;
+    return OK;
+}
+
+/*
+ * Find the line index entry for the data block starting at line 'low'.
+ * The index is thrown away when there is no such entry.
+ *
+ * return: -1 when there is no index, index of the entry for 'low' otherwise
+ */
+    static int
+ml_idx_entry(buf, low)
+    BUF		*buf;
+    linenr_t	low;
+{
+    int		idx;
+
+    if (buf->b_ml.ml_idx.ga_len == 0)	    /* no index */
+	return -1;
+    idx = ml_idx_search(buf, low);
+    if (idx < 0 || ml_idx_low(buf, idx) != low)
+    {
+	ml_idx_clear(buf);		    /* index is wrong, rebuild later */
+	return -1;
+    }
+    return idx;
+}
+
+/*
+ * The locked data block 'hp', starting at line 'low', is being released.
+ * Lines may have been appended or deleted in it, adjust the line count in the
+ * line index.  Only the tree entries that include this block are updated.
+ * This is not done for each line, like ml_locked_lineadd.
+ */
+    static void
+ml_idx_sync(buf, low, hp)
+    BUF		*buf;
+    linenr_t	low;
+    BHDR	*hp;
+{
+    MLIDX	*ep;
+    int		n = buf->b_ml.ml_idx.ga_len;
+    int		idx;
+    int		k;
+    linenr_t	count;
+
+    if ((idx = ml_idx_entry(buf, low)) < 0)
+	return;
+    ep = (MLIDX *)buf->b_ml.ml_idx.ga_data;
+    /* after a split the entry is for the other half, it is already right */
+    if (ep[idx].ie_bnum != hp->bh_bnum)
+	return;
+    count = ((DATA_BL *)(hp->bh_data))->db_line_count - ep[idx].ie_line_count;
+    if (count == 0)
+	return;
+    ep[idx].ie_line_count += count;
+    for (k = idx + 1; k <= n; k += k & -k)
+	ep[k - 1].ie_tree += count;
+}
+
+/*
+ * A line was appended to the data block starting at line 'low' and it was
+ * split in two.  Update the line index for the left and right block.
+ */
+    static void
+ml_idx_split(buf, low, bnum_left, page_count_left, line_count_left,
+			     bnum_right, page_count_right, line_count_right)
+    BUF		*buf;
+    linenr_t	low;
+    blocknr_t	bnum_left;
+    int		page_count_left;
+    linenr_t	line_count_left;
+    blocknr_t	bnum_right;
+    int		page_count_right;
+    linenr_t	line_count_right;
+{
+    MLIDX	*ep;
+    int		idx;
+
+    if ((idx = ml_idx_entry(buf, low)) < 0)
+	return;
+    ep = (MLIDX *)buf->b_ml.ml_idx.ga_data + idx;
+    ep->ie_line_count = line_count_left;
+    ep->ie_bnum = bnum_left;
+    ep->ie_page_count = page_count_left;
+    if (ml_idx_insert(buf, idx + 1, line_count_right, bnum_right,
+						  page_count_right) == FAIL)
+	ml_idx_clear(buf);
+    else
+	ml_idx_tree(buf, idx);
+}
+
+/*
+ * The data block starting at line 'low' was freed, because its only line
+ * was deleted.  Remove it from the line index.
+ */
+    static void
+ml_idx_remove(buf, low)
+    BUF		*buf;
+    linenr_t	low;
+{
+    struct growarray	*gap = &buf->b_ml.ml_idx;
+    MLIDX		*ep;
+    int			idx;
+
+    if ((idx = ml_idx_entry(buf, low)) < 0)
+	return;
+    ep = (MLIDX *)gap->ga_data + idx;
+    vim_memmove(ep, ep + 1, (size_t)(gap->ga_len - idx - 1) * sizeof(MLIDX));
+    --gap->ga_len;
+    ++gap->ga_room;
+    ml_idx_tree(buf, idx);
+}
+
+/*
+ * Throw away the line index of 'buf'.  It will be built again when needed.
+ */
+    static void
+ml_idx_clear(buf)
+    BUF		*buf;
+{
+    ga_clear(&buf->b_ml.ml_idx);
+}
+
 /*
  * make swap file name out of the file name and a directory name
  */
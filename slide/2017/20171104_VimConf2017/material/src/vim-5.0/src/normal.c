@@ -61,6 +61,9 @@ static int	do_replace __ARGS((CMDARG *cap));
 static void	switch_visual __ARGS((CMDARG *cap));
 static void	do_swapchar __ARGS((CMDARG *cap));
 static void	do_cursormark __ARGS((CMDARG *cap, int flag, FPOS *pos));
+#ifdef LAZY_READ
+static int	lazy_motion __ARGS((CMDARG *cap));
+#endif
 static void	do_visop __ARGS((CMDARG *cap));
 static void	do_optrans __ARGS((CMDARG *cap));
 static void	do_gomark __ARGS((CMDARG *cap, int flag));
@@ -257,6 +260,15 @@ getcount:
 
     ca.count1 = (ca.count0 == 0 ? 1 : ca.count0);
 
+#ifdef LAZY_READ
+    /*
+     * When the file is still being loaded, read the rest of it now.  Not for
+     * a command that stays in the lines that are already there.
+     */
+    if (read_rest_busy(curbuf) && !lazy_motion(&ca))
+	read_rest(FALSE);
+#endif
+
     /*
      * Get an additional character if we need one.
      * For CTRL-W we already got it when looking for a count.
@@ -3763,6 +3775,36 @@ do_cursormark(cap, flag, pos)
     curwin->w_set_curswant = TRUE;
 }
 
+#ifdef LAZY_READ
+/*
+ * Return TRUE when command "cap" does not need the lines of a file that is
+ * still being loaded: it only moves the cursor or scrolls and stays well
+ * within the lines that were loaded already.
+ */
+    static int
+lazy_motion(cap)
+    CMDARG	*cap;
+{
+    if (cap->oap->op_type != OP_NOP || VIsual_active)
+	return FALSE;
+    switch (cap->cmdchar)
+    {
+	case ':':		/* checked in do_one_cmd() */
+	    return TRUE;
+
+	case 'h':   case K_LEFT:    case 'l':	case K_RIGHT:	case ' ':
+	case 'j':   case K_DOWN:    case Ctrl('N'):
+	case 'k':   case K_UP:	    case Ctrl('P'):
+	case '+':   case '-':	    case CR:	case NL:
+	case Ctrl('E'):	case Ctrl('Y'):	case Ctrl('D'):	case Ctrl('U'):
+	case Ctrl('F'):	case Ctrl('B'):	case K_PAGEDOWN: case K_PAGEUP:
+	    return (curwin->w_botline + (cap->count1 + 1) * curwin->w_height
+					    < curbuf->b_ml.ml_line_count);
+    }
+    return FALSE;
+}
+#endif
+
 /*
  * Handle commands that are operators in Visual mode.
  */
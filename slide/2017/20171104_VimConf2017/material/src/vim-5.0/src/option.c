@@ -457,6 +457,13 @@ static struct vimoption options[] =
     {"laststatus",  "ls",   P_NUM|P_VI_DEF|P_RALL,
 			    (char_u *)&p_ls,
 			    {(char_u *)1L, (char_u *)0L}},
+    {"lazyread",    "lzr",  P_NUM|P_VI_DEF,
+#ifdef LAZY_READ
+			    (char_u *)&p_lzr,
+#else
+			    (char_u *)NULL,
+#endif
+			    {(char_u *)1024L, (char_u *)0L}},
     {"lazyredraw",  "lz",   P_BOOL|P_VI_DEF,
 			    (char_u *)&p_lz,
 			    {(char_u *)FALSE, (char_u *)0L}},
@@ -579,6 +586,9 @@ static struct vimoption options[] =
     {"redraw",	    NULL,   P_BOOL|P_VI_DEF,
 			    (char_u *)NULL,
 			    {(char_u *)FALSE, (char_u *)0L}},
+    {"regexpengine", "re",  P_NUM|P_VI_DEF,
+			    (char_u *)&p_re,
+			    {(char_u *)0L, (char_u *)0L}},
     {"remap",	    NULL,   P_BOOL|P_VI_DEF,
 			    (char_u *)&p_remap,
 			    {(char_u *)TRUE, (char_u *)0L}},
@@ -748,6 +758,13 @@ static struct vimoption options[] =
 			    (char_u *)&p_su,
 			    {(char_u *)".bak,~,.o,.h,.info,.swp",
 				(char_u *)0L}},
+    {"swapmap",	    "smp",  P_BOOL|P_VI_DEF,
+#ifdef MMAP_SWAP
+			    (char_u *)&p_smp,
+#else
+			    (char_u *)NULL,
+#endif
+			    {(char_u *)FALSE, (char_u *)0L}},
     {"swapsync",    "sws",  P_STRING|P_VI_DEF,
 			    (char_u *)&p_sws,
 			    {(char_u *)"fsync", (char_u *)0L}},
@@ -2779,6 +2796,11 @@ set_num_option(opt_idx, varp, value, errbuf)
 	errmsg = e_positive;
 	p_report = 1;
     }
+    if (p_re < 0 || p_re > 2)
+    {
+	errmsg = e_invarg;
+	p_re = 0;
+    }
     if ((p_sj < 0 || p_sj >= Rows) && full_screen)
     {
 	if (Rows != old_Rows)	    /* Rows changed, just adjust p_sj */
@@ -3757,7 +3779,10 @@ ExpandSettings(prog, num_file, file)
     int	loop;
     int is_term_opt;
     char_u  name_buf[MAX_KEY_NAME_LEN];
-    int	save_reg_ic;
+    int	save_ic;
+    REGEXEC rex;
+
+    vim_regexec_init(&rex, reg_ic);
 
     /* do this loop twice:
      * loop == 0: count the number of matching options
@@ -3767,14 +3792,14 @@ ExpandSettings(prog, num_file, file)
     {
 	if (expand_context != EXPAND_BOOL_SETTINGS)
 	{
-	    if (vim_regexec(prog, (char_u *)"all", TRUE))
+	    if (vim_regexec(&rex, prog, (char_u *)"all", TRUE))
 	    {
 		if (loop == 0)
 		    num_normal++;
 		else
 		    (*file)[count++] = vim_strsave((char_u *)"all");
 	    }
-	    if (vim_regexec(prog, (char_u *)"termcap", TRUE))
+	    if (vim_regexec(&rex, prog, (char_u *)"termcap", TRUE))
 	    {
 		if (loop == 0)
 		    num_normal++;
@@ -3794,9 +3819,9 @@ ExpandSettings(prog, num_file, file)
 	    if (is_term_opt && num_normal > 0)
 		continue;
 	    match = FALSE;
-	    if (vim_regexec(prog, str, TRUE) ||
+	    if (vim_regexec(&rex, prog, str, TRUE) ||
 					(options[opt_idx].shortname != NULL &&
-			 vim_regexec(prog,
+			 vim_regexec(&rex, prog,
 				 (char_u *)options[opt_idx].shortname, TRUE)))
 		match = TRUE;
 	    else if (is_term_opt)
@@ -3808,7 +3833,7 @@ ExpandSettings(prog, num_file, file)
 		name_buf[4] = str[3];
 		name_buf[5] = '>';
 		name_buf[6] = NUL;
-		if (vim_regexec(prog, name_buf, TRUE))
+		if (vim_regexec(&rex, prog, name_buf, TRUE))
 		{
 		    match = TRUE;
 		    str = name_buf;
@@ -3844,7 +3869,7 @@ ExpandSettings(prog, num_file, file)
 		name_buf[4] = NUL;
 
 		match = FALSE;
-		if (vim_regexec(prog, name_buf, TRUE))
+		if (vim_regexec(&rex, prog, name_buf, TRUE))
 		    match = TRUE;
 		else
 		{
@@ -3856,7 +3881,7 @@ ExpandSettings(prog, num_file, file)
 		    name_buf[5] = '>';
 		    name_buf[6] = NUL;
 
-		    if (vim_regexec(prog, name_buf, TRUE))
+		    if (vim_regexec(&rex, prog, name_buf, TRUE))
 			match = TRUE;
 		}
 		if (match)
@@ -3876,16 +3901,16 @@ ExpandSettings(prog, num_file, file)
 		STRCPY(name_buf + 1, str);
 		STRCAT(name_buf, ">");
 
-		save_reg_ic = reg_ic;
-		reg_ic = TRUE;			/* ignore case here */
-		if (vim_regexec(prog, name_buf, TRUE))
+		save_ic = rex.rx_ic;
+		rex.rx_ic = TRUE;		/* ignore case here */
+		if (vim_regexec(&rex, prog, name_buf, TRUE))
 		{
 		    if (loop == 0)
 			num_term++;
 		    else
 			(*file)[count++] = vim_strsave(name_buf);
 		}
-		reg_ic = save_reg_ic;
+		rex.rx_ic = save_ic;
 	    }
 	}
 	if (loop == 0)
@@ -3895,15 +3920,17 @@ ExpandSettings(prog, num_file, file)
 	    else if (num_term > 0)
 		*num_file = num_term;
 	    else
-		return OK;
+		break;
 	    *file = (char_u **) alloc((unsigned)(*num_file * sizeof(char_u *)));
 	    if (*file == NULL)
 	    {
 		*file = (char_u **)"";
+		vim_regexec_free(&rex);
 		return FAIL;
 	    }
 	}
     }
+    vim_regexec_free(&rex);
     return OK;
 }
 
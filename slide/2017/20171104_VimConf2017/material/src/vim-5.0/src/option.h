@@ -246,6 +246,9 @@ EXTERN char_u  *p_kp;		/* keyword program */
 EXTERN char_u  *p_langmap;	/* mapping for some language */
 #endif
 EXTERN long	p_ls;		/* last window has status line */
+#ifdef LAZY_READ
+EXTERN long	p_lzr;		/* minimal file size for lazy reading */
+#endif
 EXTERN int	p_lz;		/* lazy redraw, only when key typed */
 EXTERN int	p_magic;	/* use some characters for reg exp */
 EXTERN char_u  *p_mef;		/* name of make errorfile */
@@ -265,6 +268,7 @@ EXTERN char_u  *p_para;		/* paragraphs */
 EXTERN int	p_paste;	/* paste mode */
 EXTERN char_u  *p_pm;		/* patchmode file suffix */
 EXTERN char_u  *p_path;		/* path for "]f" and "^Wf" */
+EXTERN long	p_re;		/* regexp engine to use */
 EXTERN int	p_remap;	/* remap */
 EXTERN long	p_report;	/* minimum number of lines for report */
 #ifdef WIN32
@@ -297,6 +301,9 @@ EXTERN int	p_sta;		/* smart-tab for expand-tab */
 EXTERN int	p_sb;		/* split window backwards */
 EXTERN int	p_sol;		/* Move cursor to start-of-line? */
 EXTERN char_u  *p_su;		/* suffixes for wildcard expansion */
+#ifdef MMAP_SWAP
+EXTERN int	p_smp;		/* use mmap() for swap file */
+#endif
 EXTERN char_u  *p_sws;		/* swap file syncing */
 EXTERN int	p_tbs;		/* tag binary search */
 EXTERN long	p_tl;		/* used tag length */
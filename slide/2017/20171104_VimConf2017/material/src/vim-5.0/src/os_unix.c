@@ -2439,6 +2439,7 @@ mch_expandpath(gap, path, flags)
     char_u		*pat;
     DIR			*dirp;
     vim_regexp		*prog;
+    REGEXEC		rex;
     struct dirent	*dp;
     int			starts_with_dot;
     int			matches;
@@ -2487,7 +2488,6 @@ mch_expandpath(gap, path, flags)
     }
 
     /* compile the regexp into a program */
-    reg_ic = FALSE;			    /* Don't ever ignore case */
     prog = vim_regcomp(pat, TRUE);
     vim_free(pat);
 
@@ -2506,13 +2506,14 @@ mch_expandpath(gap, path, flags)
     /* Find all matching entries */
     if (dirp != NULL)
     {
+	vim_regexec_init(&rex, FALSE);	    /* Don't ever ignore case */
 	for (;;)
 	{
 	    dp = readdir(dirp);
 	    if (dp == NULL)
 		break;
 	    if ((dp->d_name[0] != '.' || starts_with_dot)
-			     && vim_regexec(prog, (char_u *)dp->d_name, TRUE))
+			&& vim_regexec(&rex, prog, (char_u *)dp->d_name, TRUE))
 	    {
 		STRCPY(s, dp->d_name);
 		STRCAT(buf, path);
@@ -2522,11 +2523,13 @@ mch_expandpath(gap, path, flags)
 		    addfile(gap, buf, flags);
 	    }
 	}
+	vim_regexec_free(&rex);
 
 	closedir(dirp);
     }
 
     vim_free(buf);
+    vim_regfree(prog);
 
     matches = gap->ga_len - start_len;
     if (matches)
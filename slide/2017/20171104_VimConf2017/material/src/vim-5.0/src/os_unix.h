@@ -58,6 +58,14 @@
 # define USE_GETCWD
 #endif
 
+/*
+ * When aio_fsync() is available the swap file is flushed to disk in the
+ * background when syncing while waiting for the user to type something.
+ */
+#if defined(HAVE_AIO_H) && defined(HAVE_AIO_FSYNC) && defined(HAVE_FSYNC)
+# define USE_AIO_FSYNC
+#endif
+
 #ifndef __ARGS
 # if defined(__STDC__) || defined(__GNUC__)
 #  define __ARGS(x) x
@@ -1,6 +1,9 @@
 /* fileio.c */
 void filemess __ARGS((BUF *buf, char_u *name, char_u *s, int attr));
 int readfile __ARGS((char_u *fname, char_u *sfname, linenr_t from, linenr_t lines_to_skip, linenr_t lines_to_read, int flags));
+void read_rest __ARGS((int typed));
+int read_rest_busy __ARGS((BUF *buf));
+void read_rest_stop __ARGS((BUF *buf));
 int buf_write __ARGS((BUF *buf, char_u *fname, char_u *sfname, linenr_t start, linenr_t end, int append, int forceit, int reset_changed, int filtering));
 char_u *shorten_fname __ARGS((char_u *full_path, char_u *dir_name));
 char_u *modname __ARGS((char_u *fname, char_u *ext, int prepend_dot));
@@ -1,5 +1,6 @@
 /* memline.c */
 int ml_open __ARGS((void));
+void ml_page_size __ARGS((long line_len));
 void ml_setname __ARGS((void));
 void ml_open_files __ARGS((void));
 void ml_open_file __ARGS((BUF *buf));
@@ -19,10 +20,17 @@ char_u *ml_get_cursor __ARGS((void));
 char_u *ml_get_buf __ARGS((BUF *buf, linenr_t lnum, int will_change));
 int ml_line_alloced __ARGS((void));
 int ml_append __ARGS((linenr_t lnum, char_u *line, colnr_t len, int newfile));
+int ml_bulk_start __ARGS((void));
+int ml_bulk_lazy __ARGS((char_u *fname, int fd, int fileformat));
+int ml_bulk_more __ARGS((BUF *buf));
+int ml_bulk_append __ARGS((char_u *line, colnr_t len, long offset));
+int ml_bulk_end __ARGS((void));
+void ml_lazy_release __ARGS((char_u *fname));
 int ml_replace __ARGS((linenr_t lnum, char_u *line, int copy));
 int ml_delete __ARGS((linenr_t lnum, int message));
 void ml_setmarked __ARGS((linenr_t lnum));
 linenr_t ml_firstmarked __ARGS((void));
 int ml_has_mark __ARGS((linenr_t lnum));
 void ml_clearmarked __ARGS((void));
+linenr_t ml_find_match __ARGS((BUF *buf, linenr_t lnum, linenr_t end, int dir, REGEXEC *rex, vim_regexp *prog));
 char_u *get_file_in_dir __ARGS((char_u *fname, char_u *dname));
@@ -1,8 +1,16 @@
 /* regexp.c */
 char_u *skip_regexp __ARGS((char_u *p, int dirc, int magic));
 vim_regexp *vim_regcomp __ARGS((char_u *exp, int magic));
-int vim_regcomp_had_eol __ARGS((void));
-int vim_regexec __ARGS((vim_regexp *prog, char_u *string, int at_bol));
+void do_regcache __ARGS((int forceit));
+int vim_regcomp_had_eol __ARGS((vim_regexp *prog));
+void vim_regexec_init __ARGS((REGEXEC *rex, int ic));
+void vim_regexec_free __ARGS((REGEXEC *rex));
+int vim_regexec __ARGS((REGEXEC *rex, vim_regexp *prog, char_u *string, int at_bol));
+int vim_regexec_all __ARGS((REGEXEC *rex, vim_regexp *prog, char_u *line, struct growarray *gap, int skip));
+int vim_regsame __ARGS((vim_regexp *prog1, vim_regexp *prog2));
+void vim_regfree __ARGS((vim_regexp *prog));
+int vim_regmust_found __ARGS((REGEXEC *rex, vim_regexp *prog, char_u *s, char_u *end));
+int vim_regfirst __ARGS((vim_regexp *prog, char_u *set, int ic));
 char_u *regtilde __ARGS((char_u *source, int magic));
-int vim_regsub __ARGS((vim_regexp *prog, char_u *source, char_u *dest, int copy, int magic));
+int vim_regsub __ARGS((REGEXEC *rex, char_u *source, char_u *dest, int copy, int magic));
 int vim_iswildc __ARGS((int c));
@@ -11,6 +11,8 @@ void status_redraw_all __ARGS((void));
 void win_redr_status __ARGS((WIN *wp));
 void screen_putchar __ARGS((int c, int row, int col, int attr));
 void screen_puts __ARGS((char_u *text, int row, int col, int attr));
+void search_hl_changed __ARGS((BUF *buf, linenr_t lnum, long amount));
+void search_hl_clear __ARGS((BUF *buf));
 void screen_start __ARGS((void));
 void screen_down __ARGS((void));
 void screen_stop_highlight __ARGS((void));
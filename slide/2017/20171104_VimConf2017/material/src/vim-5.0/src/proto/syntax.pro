@@ -1,5 +1,6 @@
 /* syntax.c */
 void syntax_start __ARGS((WIN *wp, linenr_t lnum));
+void syntax_idle __ARGS((void));
 int syntax_check_changed __ARGS((linenr_t lnum));
 int get_syntax_attr __ARGS((colnr_t col, char_u *line));
 void syntax_clear __ARGS((BUF *buf));
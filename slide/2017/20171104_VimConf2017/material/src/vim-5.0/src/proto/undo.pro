@@ -2,6 +2,7 @@
 int u_save_cursor __ARGS((void));
 int u_save __ARGS((linenr_t top, linenr_t bot));
 int u_savesub __ARGS((linenr_t lnum));
+int u_savesublines __ARGS((linenr_t first, linenr_t last));
 int u_inssub __ARGS((linenr_t lnum));
 int u_savedel __ARGS((linenr_t lnum, long nlines));
 void u_undo __ARGS((int count));
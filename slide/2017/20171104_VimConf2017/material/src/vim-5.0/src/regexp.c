@@ -51,17 +51,25 @@
  *
  * regstart	char that must begin a match; '\0' if none obvious
  * reganch	is the match anchored (at beginning-of-line only)?
- * regmust	string (pointer into program) that match must include, or NULL
- * regmlen	length of regmust string
+ * regmust	strings (pointers into program) that a match must include
+ * regmlen	lengths of the regmust strings
+ * regnmust	number of regmust strings, zero if none
+ * regmustany	when TRUE one of the regmust strings must appear, otherwise
+ *		all of them
+ * regbackref	does the r.e. contain a back reference \1 - \9?
+ * regnsub	number of rx_startp[] and rx_endp[] entries used, including [0]
+ * regnbrace	number of complex \{} used
+ * regeol	does the r.e. contain "$"?  See vim_regcomp_had_eol().
+ * regsize	size of the program, in bytes
+ * regdfa	DFA states, made while matching, see regdfa()
  *
  * Regstart and reganch permit very fast decisions on suitable starting points
  * for a match, cutting down the work a lot.  Regmust permits fast rejection
- * of lines that cannot possibly match.  The regmust tests are costly enough
- * that vim_regcomp() supplies a regmust only if the r.e. contains something
- * potentially expensive (at present, the only such thing detected is * or +
- * at the start of the r.e., which can involve a lot of backup).  Regmlen is
+ * of lines that cannot possibly match, see vim_regmust_found().  Regmlen is
  * supplied because the test in vim_regexec() needs it and vim_regcomp() is
- * computing it anyway.
+ * computing it anyway.  Regbackref, regnsub, regnbrace and regsize are used
+ * to decide whether the NFA matcher can be used and to size its work arrays,
+ * see regnfa().
  */
 
 /*
@@ -181,8 +189,12 @@
 #define MAX_LIMIT	32767
 
 static int re_ismult __ARGS((int));
-static int cstrncmp __ARGS((char_u *s1, char_u *s2, int n));
-static char_u *cstrchr __ARGS((char_u *, int));
+static int cstrncmp __ARGS((char_u *s1, char_u *s2, int n, int ic));
+static char_u *cstrchr __ARGS((char_u *, int, int));
+static int regmust_found __ARGS((vim_regexp *, char_u *, char_u *, int));
+static char_u *cstrstr __ARGS((char_u *, char_u *, char_u *, int, int));
+static char_u *cstrskip __ARGS((char_u *, char_u *, int, int));
+static int regfirst __ARGS((REGEXEC *, char_u *, char_u *, int));
 
 #ifdef DEBUG
 static void	regdump __ARGS((char_u *, vim_regexp *));
@@ -206,7 +218,7 @@ re_ismult(c)
 #define WORST		0	/* Worst case. */
 
 /*
- * When regcode is set to this value, code is not emitted and size is computed
+ * When cs_code is set to this value, code is not emitted and size is computed
  * instead.
  */
 #define JUST_CALC_SIZE	((char_u *) -1)
@@ -280,20 +292,25 @@ skip_range(p)
 }
 
 /*
- * Global work variables for vim_regcomp().
+ * Work variables for compiling one pattern, see regcomp_prog().  They are
+ * passed to vim_regcomp()'s friends instead of being global.
  */
-
-static char_u	*regparse;  /* Input-scan pointer. */
-static int	num_complex_braces; /* Complex \{...} count */
-static int	regnpar;	/* () count. */
-static char_u	*regcode;	/* Code-emit pointer, or JUST_CALC_SIZE */
-static long	regsize;	/* Code size. */
-static char_u	**regendp;	/* Pointer to endp array */
-static int	brace_min[10];	/* Minimums for complex brace repeats */
-static int	brace_max[10];	/* Maximums for complex brace repeats */
-static int	brace_count[10]; /* Current counts for complex brace repeats */
-static int	had_eol;	/* TRUE when EOL found by vim_regcomp() */
-static int	reg_magic;	/* p_magic passed to vim_regexec() */
+typedef struct
+{
+    char_u	*cs_parse;	/* Input-scan pointer. */
+    int		cs_ncomplex;	/* Complex \{...} count */
+    int		cs_npar;	/* () count. */
+    char_u	*cs_code;	/* Code-emit pointer, or JUST_CALC_SIZE */
+    long	cs_size;	/* Code size. */
+    char_u	**cs_endp;	/* close paren seen, NULL in the first pass */
+    int		cs_had_eol;	/* TRUE when EOL found */
+    int		cs_had_backref;	/* TRUE when \1 - \9 found */
+    int		cs_magic;	/* p_magic passed to vim_regcomp() */
+    int		cs_curchr;	/* current character, see peekchr() */
+    int		cs_prevchr;	/* previous character, see ungetchr() */
+    int		cs_nextchr;	/* used for ungetchr() */
+    int		cs_at_start;	/* True when we are on the first character */
+} REGCOMP;
 
 /*
  * META contains all characters that may be magic, except '^' and '$'.
@@ -304,26 +321,66 @@ static char_u META[] = ".[()|=+*<>iIkKfFpPsS~123456789{";
 /*
  * Forward declarations for vim_regcomp()'s friends.
  */
-static void	initchr __ARGS((char_u *));
-static int	getchr __ARGS((void));
-static int	peekchr __ARGS((void));
-#define PeekChr() curchr    /* shortcut only when last action was peekchr() */
-static int	curchr;
-static void	skipchr __ARGS((void));
-static void	ungetchr __ARGS((void));
-static char_u	*reg __ARGS((int, int *));
-static char_u	*regbranch __ARGS((int *));
-static char_u	*regpiece __ARGS((int *));
-static char_u	*regatom __ARGS((int *));
-static char_u	*regnode __ARGS((int));
+static void	initchr __ARGS((REGCOMP *, char_u *));
+static int	getchr __ARGS((REGCOMP *));
+static int	peekchr __ARGS((REGCOMP *));
+/* shortcut only when last action was peekchr() */
+#define PeekChr() cs->cs_curchr
+static void	skipchr __ARGS((REGCOMP *));
+static void	ungetchr __ARGS((REGCOMP *));
+static char_u	*reg __ARGS((REGCOMP *, int, int *));
+static char_u	*regbranch __ARGS((REGCOMP *, int *));
+static char_u	*regpiece __ARGS((REGCOMP *, int *));
+static char_u	*regatom __ARGS((REGCOMP *, int *));
+static char_u	*regnode __ARGS((REGCOMP *, int));
 static char_u	*regnext __ARGS((char_u *));
-static void	regc __ARGS((int));
-static void	unregc __ARGS((void));
-static void	reginsert __ARGS((int, char_u *));
-static void	reginsert_limits __ARGS((int, int, int, char_u *));
-static int	read_limits __ARGS((int, int, int *, int *));
+static void	regc __ARGS((REGCOMP *, int));
+static void	unregc __ARGS((REGCOMP *));
+static void	reginsert __ARGS((REGCOMP *, int, char_u *));
+static void	reginsert_limits __ARGS((REGCOMP *, int, int, int, char_u *));
+static int	read_limits __ARGS((REGCOMP *, int, int, int *, int *));
 static void	regtail __ARGS((char_u *, char_u *));
 static void	regoptail __ARGS((char_u *, char_u *));
+static int	regmustbranch __ARGS((char_u *, char_u **, int *, int));
+static vim_regexp *regcomp_prog __ARGS((char_u *, int));
+static vim_regexp *regcopy __ARGS((vim_regexp *));
+static vim_regexp *regcache_find __ARGS((char_u *, int));
+static void	regcache_add __ARGS((char_u *, int, vim_regexp *));
+
+/*
+ * The cache of compiled programs.
+ *
+ * The same patterns are compiled again and again: the last search pattern
+ * for every redraw with 'hlsearch', match() in a loop, autocommand patterns
+ * for every file.  Compiling takes two passes over the pattern, copying a
+ * compiled program is much quicker.  The cache keeps a program for the last
+ * REGCACHE_SIZE patterns, vim_regcomp() returns a copy of it, thus the caller
+ * still owns the program it gets and nothing changes for using it.  When the
+ * cache is full the least recently used entry is replaced.
+ * A pattern with a '~' is not cached: "~" or "\~" is replaced with the
+ * previous substitute string when compiling, which can change in between.
+ * ":regcache" shows the statistics.
+ */
+#define REGCACHE_SIZE	16
+
+/* rc_flags: what the compiled program depends on besides the pattern */
+#define RC_MAGIC	1	/* 'magic' */
+#define RC_CPOLIT	2	/* 'l' flag in 'cpoptions' */
+#define RC_NFA		4	/* 'regexpengine' is 2 */
+
+typedef struct
+{
+    char_u	*rc_exp;	/* the pattern, NULL for an unused entry */
+    int		rc_flags;	/* RC_ flags for rc_exp */
+    long	rc_used;	/* regcache_tick when last used */
+    long	rc_hits;	/* number of times it was found */
+    vim_regexp	*rc_prog;	/* the compiled program */
+} REGCACHE;
+
+static REGCACHE	regcache[REGCACHE_SIZE];
+static long	regcache_tick = 0;
+static long	regcache_hits = 0;
+static long	regcache_misses = 0;
 
 /*
  * Skip past regular expression.
@@ -361,10 +418,13 @@ skip_regexp(p, dirc, magic)
  * code and thus invalidate pointers into it.  (Note that it has to be in
  * one piece because vim_free() must be able to free it all.)
  *
- * Does not use reg_ic, see vim_regexec() for that.
+ * Ignoring case is not part of the program, see vim_regexec_init() for that.
  *
  * Beware that the optimization-preparation code in here knows about some
  * of the structure of the compiled regexp.
+ *
+ * A program compiled before for the same pattern is copied from the cache,
+ * see regcache_find().
  */
     vim_regexp *
 vim_regcomp(exp, magic)
@@ -372,47 +432,85 @@ vim_regcomp(exp, magic)
     int		magic;
 {
     vim_regexp	*r;
-    char_u	*scan;
-    char_u	*longest;
-    int		len;
     int		flags;
 
     if (exp == NULL)
 	EMSG_RETURN(e_null);
 
-    reg_magic = magic;
+    /* The result depends on 'magic', the 'l' flag in 'cpoptions' and on
+     * 'regexpengine' being 2 (back references are an error then). */
+    flags = 0;
+    if (magic)
+	flags |= RC_MAGIC;
+    if (!reg_syn && vim_strchr(p_cpo, CPO_LITERAL) != NULL)
+	flags |= RC_CPOLIT;
+    if (p_re == 2)
+	flags |= RC_NFA;
+
+    /* "~" depends on reg_prev_sub, don't use the cache for it. */
+    if (vim_strchr(exp, '~') != NULL)
+	return regcomp_prog(exp, magic);
+
+    r = regcache_find(exp, flags);
+    if (r == NULL)
+    {
+	r = regcomp_prog(exp, magic);
+	if (r != NULL)
+	    regcache_add(exp, flags, r);
+    }
+    return r;
+}
+
+/*
+ * Compile "exp" into a program, for vim_regcomp().
+ */
+    static vim_regexp *
+regcomp_prog(exp, magic)
+    char_u	*exp;
+    int		magic;
+{
+    REGCOMP	comp;
+    REGCOMP	*cs = &comp;
+    char_u	*endp[NSUBEXP];	/* close paren nodes, for back references */
+    vim_regexp	*r;
+    char_u	*scan;
+    int		flags;
+    int		n;
+
+    cs->cs_magic = magic;
 
     /* First pass: determine size, legality. */
-    initchr((char_u *)exp);
-    num_complex_braces = 0;
-    regnpar = 1;
-    regsize = 0L;
-    regcode = JUST_CALC_SIZE;
-    regendp = NULL;
-    had_eol = FALSE;
-    regc(MAGIC);
-    if (reg(0, &flags) == NULL)
+    initchr(cs, (char_u *)exp);
+    cs->cs_ncomplex = 0;
+    cs->cs_npar = 1;
+    cs->cs_size = 0L;
+    cs->cs_code = JUST_CALC_SIZE;
+    cs->cs_endp = NULL;
+    cs->cs_had_eol = FALSE;
+    cs->cs_had_backref = FALSE;
+    regc(cs, MAGIC);
+    if (reg(cs, 0, &flags) == NULL)
 	return NULL;
 
     /* Small enough for pointer-storage convention? */
 #ifdef SMALL_MALLOC		/* 16 bit storage allocation */
-    if (regsize >= 65536L - 256L)
+    if (cs->cs_size >= 65536L - 256L)
 	EMSG_RETURN(e_toolong);
 #endif
 
     /* Allocate space. */
-    r = (vim_regexp *)lalloc(sizeof(vim_regexp) + regsize, TRUE);
+    r = (vim_regexp *)lalloc(sizeof(vim_regexp) + cs->cs_size, TRUE);
     if (r == NULL)
 	return NULL;
 
     /* Second pass: emit code. */
-    initchr((char_u *)exp);
-    num_complex_braces = 0;
-    regnpar = 1;
-    regcode = r->program;
-    regendp = r->endp;
-    regc(MAGIC);
-    if (reg(0, &flags) == NULL)
+    initchr(cs, (char_u *)exp);
+    cs->cs_ncomplex = 0;
+    cs->cs_npar = 1;
+    cs->cs_code = r->program;
+    cs->cs_endp = endp;
+    regc(cs, MAGIC);
+    if (reg(cs, 0, &flags) == NULL)
     {
 	vim_free(r);
 	return NULL;
@@ -421,8 +519,14 @@ vim_regcomp(exp, magic)
     /* Dig out information for optimizations. */
     r->regstart = '\0';		/* Worst-case defaults. */
     r->reganch = 0;
-    r->regmust = NULL;
-    r->regmlen = 0;
+    r->regnmust = 0;
+    r->regmustany = FALSE;
+    r->regbackref = cs->cs_had_backref;
+    r->regeol = cs->cs_had_eol;
+    r->regnsub = cs->cs_npar;
+    r->regnbrace = cs->cs_ncomplex;
+    r->regsize = cs->cs_size;
+    r->regdfa = NULL;
     scan = r->program + 1;	/* First BRANCH. */
     if (OP(regnext(scan)) == END)   /* Only one top-level choice. */
     {
@@ -441,29 +545,26 @@ vim_regcomp(exp, magic)
 	    r->regstart = *OPERAND(regnext(scan));
 
 	/*
-	 * If there's something expensive in the r.e., find the longest
-	 * literal string that must appear and make it the regmust.  Resolve
-	 * ties in favor of later strings, since the regstart check works
-	 * with the beginning of the r.e. and avoiding duplication
-	 * strengthens checking.  Not a strong reason, but sufficient in the
-	 * absence of others.
+	 * Find the longest literal strings that every match must include.
+	 * Checking for them is quick, thus it's done for every r.e. that has
+	 * them.
 	 */
+	r->regnmust = regmustbranch(scan, r->regmust, r->regmlen, NMUST);
+    }
+    else
+    {
 	/*
-	 * When the r.e. starts with BOW, it is faster to look for a regmust
-	 * first. Used a lot for "#" and "*" commands. (Added by mool).
+	 * Several top-level choices: when each of them has a literal string
+	 * that it must include, one of these strings must appear.
 	 */
-	if (flags & SPSTART || OP(scan) == BOW || OP(scan) == EOW)
+	for (n = 0; OP(scan) == BRANCH; scan = regnext(scan), ++n)
+	    if (n == NMUST || regmustbranch(OPERAND(scan), r->regmust + n,
+						      r->regmlen + n, 1) == 0)
+		break;
+	if (OP(scan) != BRANCH)
 	{
-	    longest = NULL;
-	    len = 0;
-	    for (; scan != NULL; scan = regnext(scan))
-		if (OP(scan) == EXACTLY && STRLEN(OPERAND(scan)) >= (size_t)len)
-		{
-		    longest = OPERAND(scan);
-		    len = STRLEN(OPERAND(scan));
-		}
-	    r->regmust = longest;
-	    r->regmlen = len;
+	    r->regnmust = n;
+	    r->regmustany = TRUE;
 	}
     }
 #ifdef DEBUG
@@ -473,13 +574,209 @@ vim_regcomp(exp, magic)
 }
 
 /*
- * Check if during the previous call to vim_regcomp the EOL item "$" has been
- * found.  This is messy, but it works fine.
+ * Find the literal strings a match must include, on the way from node "scan"
+ * to the end of its branch.  A BRANCH without alternatives, from \( \), is
+ * followed into, other choices and repeats are skipped.
+ * The "max" longest strings are stored in "must[]" and their lengths in
+ * "mlen[]", longest first.  Returns the number of strings stored.
+ */
+    static int
+regmustbranch(scan, must, mlen, max)
+    char_u	*scan;
+    char_u	**must;
+    int		*mlen;
+    int		max;
+{
+    int		n = 0;
+    int		len;
+    int		i;
+
+    while (scan != NULL && OP(scan) != END && OP(scan) != BACK)
+    {
+	if (OP(scan) == BRANCH)
+	{
+	    if (OP(regnext(scan)) != BRANCH)
+	    {
+		scan = OPERAND(scan);
+		continue;
+	    }
+	    while (OP(scan) == BRANCH)
+		scan = regnext(scan);
+	    continue;
+	}
+	if (OP(scan) == EXACTLY)
+	{
+	    len = STRLEN(OPERAND(scan));
+	    for (i = n; i > 0 && mlen[i - 1] < len; --i)
+		if (i < max)
+		{
+		    must[i] = must[i - 1];
+		    mlen[i] = mlen[i - 1];
+		}
+	    if (i < max)
+	    {
+		must[i] = OPERAND(scan);
+		mlen[i] = len;
+		if (n < max)
+		    ++n;
+	    }
+	}
+	scan = regnext(scan);
+    }
+    return n;
+}
+
+/*
+ * Return a copy of "prog", NULL when out of memory.
+ */
+    static vim_regexp *
+regcopy(prog)
+    vim_regexp	*prog;
+{
+    vim_regexp	*r;
+    int		i;
+
+    r = (vim_regexp *)lalloc(sizeof(vim_regexp) + prog->regsize, TRUE);
+    if (r != NULL)
+    {
+	vim_memmove(r, prog, sizeof(vim_regexp) + prog->regsize);
+	/* the "must appear" strings point into the program */
+	for (i = 0; i < prog->regnmust; ++i)
+	    r->regmust[i] = r->program + (prog->regmust[i] - prog->program);
+	r->regdfa = NULL;
+    }
+    return r;
+}
+
+/*
+ * Find pattern "exp" compiled with "flags" in the cache.
+ * Returns a copy of the program, NULL when not found.
+ */
+    static vim_regexp *
+regcache_find(exp, flags)
+    char_u	*exp;
+    int		flags;
+{
+    REGCACHE	*rc;
+    int		i;
+
+    for (i = 0; i < REGCACHE_SIZE; ++i)
+    {
+	rc = &regcache[i];
+	if (rc->rc_exp != NULL && rc->rc_flags == flags
+						 && STRCMP(rc->rc_exp, exp) == 0)
+	{
+	    rc->rc_used = ++regcache_tick;
+	    ++rc->rc_hits;
+	    ++regcache_hits;
+	    return regcopy(rc->rc_prog);
+	}
+    }
+    ++regcache_misses;
+    return NULL;
+}
+
+/*
+ * Add a copy of program "prog", compiled from "exp" with "flags", to the
+ * cache, replacing the least recently used entry.
+ */
+    static void
+regcache_add(exp, flags, prog)
+    char_u	*exp;
+    int		flags;
+    vim_regexp	*prog;
+{
+    REGCACHE	*rc;
+    int		i;
+
+    rc = &regcache[0];
+    for (i = 1; i < REGCACHE_SIZE && rc->rc_exp != NULL; ++i)
+	if (regcache[i].rc_exp == NULL || regcache[i].rc_used < rc->rc_used)
+	    rc = &regcache[i];
+    vim_free(rc->rc_exp);
+    vim_free(rc->rc_prog);
+    rc->rc_prog = regcopy(prog);
+    rc->rc_exp = vim_strsave(exp);
+    if (rc->rc_prog == NULL || rc->rc_exp == NULL)
+    {
+	vim_free(rc->rc_prog);
+	vim_free(rc->rc_exp);
+	rc->rc_exp = NULL;
+	rc->rc_prog = NULL;
+	return;
+    }
+    rc->rc_flags = flags;
+    rc->rc_used = ++regcache_tick;
+    rc->rc_hits = 0;
+}
+
+/*
+ * ":regcache": list the patterns in the cache of compiled programs and how
+ * well it works.
+ * ":regcache!": empty the cache and reset the counts.
+ */
+    void
+do_regcache(forceit)
+    int		forceit;
+{
+    REGCACHE	*rc;
+    int		i;
+    int		n = 0;
+    long	size = 0;
+
+    for (i = 0; i < REGCACHE_SIZE; ++i)
+    {
+	rc = &regcache[i];
+	if (rc->rc_exp == NULL)
+	    continue;
+	if (forceit)
+	{
+	    vim_free(rc->rc_exp);
+	    vim_free(rc->rc_prog);
+	    rc->rc_exp = NULL;
+	    rc->rc_prog = NULL;
+	    continue;
+	}
+	++n;
+	size += sizeof(vim_regexp) + rc->rc_prog->regsize
+						     + STRLEN(rc->rc_exp) + 1;
+    }
+    if (forceit)
+    {
+	regcache_hits = regcache_misses = 0;
+	return;
+    }
+
+    MSG_PUTS_TITLE("\n  hits  size  pattern");
+    for (i = 0; i < REGCACHE_SIZE; ++i)
+    {
+	rc = &regcache[i];
+	if (rc->rc_exp == NULL)
+	    continue;
+	msg_putchar('\n');
+	sprintf((char *)IObuff, "%6ld %5ld  ", rc->rc_hits,
+			       (long)(sizeof(vim_regexp) + rc->rc_prog->regsize));
+	msg_puts(IObuff);
+	msg_outtrans(rc->rc_exp);
+	out_flush();
+    }
+    msg_putchar('\n');
+    sprintf((char *)IObuff,
+	    "%d patterns, %ld bytes; %ld found, %ld compiled (%ld%% found)",
+	    n, size, regcache_hits, regcache_misses,
+	    (regcache_hits + regcache_misses) == 0 ? 0L
+		   : regcache_hits * 100 / (regcache_hits + regcache_misses));
+    msg_puts(IObuff);
+}
+
+/*
+ * Check if the EOL item "$" was found when compiling "prog".
  */
     int
-vim_regcomp_had_eol()
+vim_regcomp_had_eol(prog)
+    vim_regexp	*prog;
 {
-    return had_eol;
+    return prog->regeol;
 }
 
 /*
@@ -492,7 +789,8 @@ vim_regcomp_had_eol()
  * follows makes it hard to avoid.
  */
     static char_u *
-reg(paren, flagp)
+reg(cs, paren, flagp)
+    REGCOMP	*cs;
     int		    paren;	/* Parenthesized? */
     int		    *flagp;
 {
@@ -507,19 +805,19 @@ reg(paren, flagp)
     /* Make an MOPEN node, if parenthesized. */
     if (paren)
     {
-	if (regnpar >= NSUBEXP)
+	if (cs->cs_npar >= NSUBEXP)
 	    EMSG_RETURN(e_toombra);
-	parno = regnpar;
-	regnpar++;
-	ret = regnode(MOPEN + parno);
-	if (regendp)
-	    regendp[parno] = NULL;  /* haven't seen the close paren yet */
+	parno = cs->cs_npar;
+	cs->cs_npar++;
+	ret = regnode(cs, MOPEN + parno);
+	if (cs->cs_endp)
+	    cs->cs_endp[parno] = NULL;  /* haven't seen the close paren yet */
     }
     else
 	ret = NULL;
 
     /* Pick up the branches, linking them together. */
-    br = regbranch(&flags);
+    br = regbranch(cs, &flags);
     if (br == NULL)
 	return NULL;
     if (ret != NULL)
@@ -529,10 +827,10 @@ reg(paren, flagp)
     if (!(flags & HASWIDTH))
 	*flagp &= ~HASWIDTH;
     *flagp |= flags & SPSTART;
-    while (peekchr() == Magic('|'))
+    while (peekchr(cs) == Magic('|'))
     {
-	skipchr();
-	br = regbranch(&flags);
+	skipchr(cs);
+	br = regbranch(cs, &flags);
 	if (br == NULL)
 	    return NULL;
 	regtail(ret, br);	/* BRANCH -> BRANCH. */
@@ -542,7 +840,7 @@ reg(paren, flagp)
     }
 
     /* Make a closing node, and hook it on the end. */
-    ender = regnode((paren) ? MCLOSE + parno : END);
+    ender = regnode(cs, (paren) ? MCLOSE + parno : END);
     regtail(ret, ender);
 
     /* Hook the tails of the branches to the closing node. */
@@ -550,9 +848,9 @@ reg(paren, flagp)
 	regoptail(br, ender);
 
     /* Check for proper termination. */
-    if (paren && getchr() != Magic(')'))
+    if (paren && getchr(cs) != Magic(')'))
 	EMSG_RETURN(e_toombra)
-    else if (!paren && peekchr() != '\0')
+    else if (!paren && peekchr(cs) != '\0')
     {
 	if (PeekChr() == Magic(')'))
 	    EMSG_RETURN(e_toomket)
@@ -564,8 +862,8 @@ reg(paren, flagp)
      * Here we set the flag allowing back references to this set of
      * parentheses.
      */
-    if (paren && regendp)
-	regendp[parno] = ender;	/* have seen the close paren */
+    if (paren && cs->cs_endp)
+	cs->cs_endp[parno] = ender;	/* have seen the close paren */
     return ret;
 }
 
@@ -575,7 +873,8 @@ reg(paren, flagp)
  * Implements the concatenation operator.
  */
     static char_u    *
-regbranch(flagp)
+regbranch(cs, flagp)
+    REGCOMP	*cs;
     int		    *flagp;
 {
     char_u	    *ret;
@@ -585,12 +884,12 @@ regbranch(flagp)
 
     *flagp = WORST;		/* Tentatively. */
 
-    ret = regnode(BRANCH);
+    ret = regnode(cs, BRANCH);
     chain = NULL;
-    while (peekchr() != '\0' && PeekChr() != Magic('|') &&
+    while (peekchr(cs) != '\0' && PeekChr() != Magic('|') &&
 						      PeekChr() != Magic(')'))
     {
-	latest = regpiece(&flags);
+	latest = regpiece(cs, &flags);
 	if (latest == NULL)
 	    return NULL;
 	*flagp |= flags & HASWIDTH;
@@ -601,7 +900,7 @@ regbranch(flagp)
 	chain = latest;
     }
     if (chain == NULL)		/* Loop ran zero times. */
-	(void) regnode(NOTHING);
+	(void) regnode(cs, NOTHING);
 
     return ret;
 }
@@ -616,7 +915,8 @@ regbranch(flagp)
  * endmarker role is not redundant.
  */
     static char_u *
-regpiece(flagp)
+regpiece(cs, flagp)
+    REGCOMP	*cs;
     int		    *flagp;
 {
     char_u	    *ret;
@@ -626,11 +926,11 @@ regpiece(flagp)
     int		    minval;
     int		    maxval;
 
-    ret = regatom(&flags);
+    ret = regatom(cs, &flags);
     if (ret == NULL)
 	return NULL;
 
-    op = peekchr();
+    op = peekchr(cs);
     if (!re_ismult(op))
     {
 	*flagp = flags;
@@ -640,66 +940,66 @@ regpiece(flagp)
 	EMSG_RETURN((char_u *)"*, \\+, or \\{ operand could be empty");
     *flagp = (WORST | SPSTART);		    /* default flags */
 
-    skipchr();
+    skipchr(cs);
     if (op == Magic('*') && (flags & SIMPLE))
-	reginsert(STAR, ret);
+	reginsert(cs, STAR, ret);
     else if (op == Magic('*'))
     {
 	/* Emit x* as (x&|), where & means "self". */
-	reginsert(BRANCH, ret); /* Either x */
-	regoptail(ret, regnode(BACK));	/* and loop */
+	reginsert(cs, BRANCH, ret); /* Either x */
+	regoptail(ret, regnode(cs, BACK));	/* and loop */
 	regoptail(ret, ret);	/* back */
-	regtail(ret, regnode(BRANCH));	/* or */
-	regtail(ret, regnode(NOTHING)); /* null. */
+	regtail(ret, regnode(cs, BRANCH));	/* or */
+	regtail(ret, regnode(cs, NOTHING)); /* null. */
     }
     else if (op == Magic('+') && (flags & SIMPLE))
     {
-	reginsert(PLUS, ret);
+	reginsert(cs, PLUS, ret);
 	*flagp = (WORST | HASWIDTH);
     }
     else if (op == Magic('+'))
     {
 	/* Emit x+ as x(&|), where & means "self". */
-	next = regnode(BRANCH); /* Either */
+	next = regnode(cs, BRANCH); /* Either */
 	regtail(ret, next);
-	regtail(regnode(BACK), ret);	/* loop back */
-	regtail(next, regnode(BRANCH)); /* or */
-	regtail(ret, regnode(NOTHING)); /* null. */
+	regtail(regnode(cs, BACK), ret);	/* loop back */
+	regtail(next, regnode(cs, BRANCH)); /* or */
+	regtail(ret, regnode(cs, NOTHING)); /* null. */
 	*flagp = (WORST | HASWIDTH);
     }
     else if (op == Magic('='))
     {
 	/* Emit x= as (x|) */
-	reginsert(BRANCH, ret); /* Either x */
-	regtail(ret, regnode(BRANCH));	/* or */
-	next = regnode(NOTHING);/* null. */
+	reginsert(cs, BRANCH, ret); /* Either x */
+	regtail(ret, regnode(cs, BRANCH));	/* or */
+	next = regnode(cs, NOTHING);/* null. */
 	regtail(ret, next);
 	regoptail(ret, next);
     }
     else if (op == Magic('{') && (flags & SIMPLE))
     {
-	if (!read_limits('{', '}', &minval, &maxval))
+	if (!read_limits(cs, '{', '}', &minval, &maxval))
 	    return NULL;
-	reginsert(BRACE_SIMPLE, ret);
-	reginsert_limits(BRACE_LIMITS, minval, maxval, ret);
+	reginsert(cs, BRACE_SIMPLE, ret);
+	reginsert_limits(cs, BRACE_LIMITS, minval, maxval, ret);
 	if (minval > 0)
 	    *flagp = (WORST | HASWIDTH);
     }
     else if (op == Magic('{'))
     {
-	if (!read_limits('{', '}', &minval, &maxval))
+	if (!read_limits(cs, '{', '}', &minval, &maxval))
 	    return NULL;
-	if (num_complex_braces >= 10)
+	if (cs->cs_ncomplex >= 10)
 	    EMSG_RETURN((char_u *)"Too many complex \\{...}s");
-	reginsert(BRACE_COMPLEX + num_complex_braces, ret);
-	regoptail(ret, regnode(BACK));
+	reginsert(cs, BRACE_COMPLEX + cs->cs_ncomplex, ret);
+	regoptail(ret, regnode(cs, BACK));
 	regoptail(ret, ret);
-	reginsert_limits(BRACE_LIMITS, minval, maxval, ret);
+	reginsert_limits(cs, BRACE_LIMITS, minval, maxval, ret);
 	if (minval > 0)
 	    *flagp = (WORST | HASWIDTH);
-	++num_complex_braces;
+	++cs->cs_ncomplex;
     }
-    if (re_ismult(peekchr()))
+    if (re_ismult(peekchr(cs)))
 	EMSG_RETURN((char_u *)"Nested *, \\=, \\+, or \\{");
 
     return ret;
@@ -713,7 +1013,8 @@ regpiece(flagp)
  * faster to run.
  */
     static char_u *
-regatom(flagp)
+regatom(cs, flagp)
+    REGCOMP	*cs;
     int		   *flagp;
 {
     char_u	    *ret;
@@ -723,67 +1024,67 @@ regatom(flagp)
     *flagp = WORST;		/* Tentatively. */
     cpo_lit = (!reg_syn && vim_strchr(p_cpo, CPO_LITERAL) != NULL);
 
-    switch (getchr())
+    switch (getchr(cs))
     {
       case Magic('^'):
-	ret = regnode(BOL);
+	ret = regnode(cs, BOL);
 	break;
       case Magic('$'):
-	ret = regnode(EOL);
-	had_eol = TRUE;
+	ret = regnode(cs, EOL);
+	cs->cs_had_eol = TRUE;
 	break;
       case Magic('<'):
-	ret = regnode(BOW);
+	ret = regnode(cs, BOW);
 	break;
       case Magic('>'):
-	ret = regnode(EOW);
+	ret = regnode(cs, EOW);
 	break;
       case Magic('.'):
-	ret = regnode(ANY);
+	ret = regnode(cs, ANY);
 	*flagp |= HASWIDTH | SIMPLE;
 	break;
       case Magic('i'):
-	ret = regnode(IDENT);
+	ret = regnode(cs, IDENT);
 	*flagp |= HASWIDTH | SIMPLE;
 	break;
       case Magic('k'):
-	ret = regnode(WORD);
+	ret = regnode(cs, WORD);
 	*flagp |= HASWIDTH | SIMPLE;
 	break;
       case Magic('I'):
-	ret = regnode(SIDENT);
+	ret = regnode(cs, SIDENT);
 	*flagp |= HASWIDTH | SIMPLE;
 	break;
       case Magic('K'):
-	ret = regnode(SWORD);
+	ret = regnode(cs, SWORD);
 	*flagp |= HASWIDTH | SIMPLE;
 	break;
       case Magic('f'):
-	ret = regnode(FNAME);
+	ret = regnode(cs, FNAME);
 	*flagp |= HASWIDTH | SIMPLE;
 	break;
       case Magic('F'):
-	ret = regnode(SFNAME);
+	ret = regnode(cs, SFNAME);
 	*flagp |= HASWIDTH | SIMPLE;
 	break;
       case Magic('p'):
-	ret = regnode(PRINT);
+	ret = regnode(cs, PRINT);
 	*flagp |= HASWIDTH | SIMPLE;
 	break;
       case Magic('P'):
-	ret = regnode(SPRINT);
+	ret = regnode(cs, SPRINT);
 	*flagp |= HASWIDTH | SIMPLE;
 	break;
       case Magic('s'):
-	ret = regnode(WHITE);
+	ret = regnode(cs, WHITE);
 	*flagp |= HASWIDTH | SIMPLE;
 	break;
       case Magic('S'):
-	ret = regnode(NWHITE);
+	ret = regnode(cs, NWHITE);
 	*flagp |= HASWIDTH | SIMPLE;
 	break;
       case Magic('('):
-	ret = reg(1, &flags);
+	ret = reg(cs, 1, &flags);
 	if (ret == NULL)
 	    return NULL;
 	*flagp |= flags & (HASWIDTH | SPSTART);
@@ -803,7 +1104,7 @@ regatom(flagp)
 	EMSG_RETURN((char_u *)"\\{ follows nothing")
 	/* NOTREACHED */
       case Magic('*'):
-	if (reg_magic)
+	if (cs->cs_magic)
 	    EMSG_RETURN((char_u *)"* follows nothing")
 	else
 	    EMSG_RETURN((char_u *)"\\* follows nothing")
@@ -813,13 +1114,13 @@ regatom(flagp)
 	    {
 		char_u	    *p;
 
-		ret = regnode(EXACTLY);
+		ret = regnode(cs, EXACTLY);
 		p = reg_prev_sub;
 		while (*p)
 		{
-		    regc(*p++);
+		    regc(cs, *p++);
 		}
-		regc('\0');
+		regc(cs, '\0');
 		if (p - reg_prev_sub)
 		{
 		    *flagp |= HASWIDTH;
@@ -842,8 +1143,8 @@ regatom(flagp)
 	    {
 	    int		    refnum;
 
-	    ungetchr();
-	    refnum = getchr() - Magic('0');
+	    ungetchr(cs);
+	    refnum = getchr(cs) - Magic('0');
 	    /*
 	     * Check if the back reference is legal. We use the parentheses
 	     * pointers to mark encountered close parentheses, but this
@@ -853,9 +1154,15 @@ regatom(flagp)
 	     * is repeated (+*=): what instance of the repetition should
 	     * we match? TODO.
 	     */
-	    if (refnum < regnpar &&
-		(regendp == NULL || regendp[refnum] != NULL))
-		ret = regnode(BACKREF + refnum);
+	    if (p_re == 2)
+		EMSG_RETURN((char_u *)
+			   "\\1 - \\9 not possible when 'regexpengine' is 2");
+	    if (refnum < cs->cs_npar &&
+		(cs->cs_endp == NULL || cs->cs_endp[refnum] != NULL))
+	    {
+		ret = regnode(cs, BACKREF + refnum);
+		cs->cs_had_backref = TRUE;
+	    }
 	    else
 		EMSG_RETURN((char_u *)"Illegal back reference");
 	}
@@ -868,40 +1175,40 @@ regatom(flagp)
 	     * If there is no matching ']', we assume the '[' is a normal
 	     * character. This makes ":help [" work.
 	     */
-	    p = skip_range(regparse);
+	    p = skip_range(cs->cs_parse);
 	    if (*p == ']')	/* there is a matching ']' */
 	    {
 		/*
 		 * In a character class, different parsing rules apply.
 		 * Not even \ is special anymore, nothing is.
 		 */
-		if (*regparse == '^') {	    /* Complement of range. */
-		    ret = regnode(ANYBUT);
-		    regparse++;
+		if (*cs->cs_parse == '^') {	    /* Complement of range. */
+		    ret = regnode(cs, ANYBUT);
+		    cs->cs_parse++;
 		}
 		else
-		    ret = regnode(ANYOF);
-		if (*regparse == ']' || *regparse == '-')
-		    regc(*regparse++);
-		while (*regparse != '\0' && *regparse != ']')
+		    ret = regnode(cs, ANYOF);
+		if (*cs->cs_parse == ']' || *cs->cs_parse == '-')
+		    regc(cs, *cs->cs_parse++);
+		while (*cs->cs_parse != '\0' && *cs->cs_parse != ']')
 		{
-		    if (*regparse == '-')
+		    if (*cs->cs_parse == '-')
 		    {
-			regparse++;
-			if (*regparse == ']' || *regparse == '\0')
-			    regc('-');
+			cs->cs_parse++;
+			if (*cs->cs_parse == ']' || *cs->cs_parse == '\0')
+			    regc(cs, '-');
 			else
 			{
 			    int		cclass;
 			    int		cclassend;
 
-			    cclass = UCHARAT(regparse - 2) + 1;
-			    cclassend = UCHARAT(regparse);
+			    cclass = UCHARAT(cs->cs_parse - 2) + 1;
+			    cclassend = UCHARAT(cs->cs_parse);
 			    if (cclass > cclassend + 1)
 				EMSG_RETURN(e_invrange);
 			    for (; cclass <= cclassend; cclass++)
-				regc(cclass);
-			    regparse++;
+				regc(cs, cclass);
+			    cs->cs_parse++;
 			}
 		    }
 		    /*
@@ -909,21 +1216,22 @@ regatom(flagp)
 		     * accepts "\t", "\e", etc., but only when the 'l' flag in
 		     * 'cpoptions' is not included.
 		     */
-		    else if (*regparse == '\\' &&
-			    (vim_strchr(REGEXP_INRANGE, regparse[1]) != NULL ||
-			     (!cpo_lit &&
-			       vim_strchr(REGEXP_ABBR, regparse[1]) != NULL)))
+		    else if (*cs->cs_parse == '\\'
+			    && (vim_strchr(REGEXP_INRANGE, cs->cs_parse[1])
+								       != NULL
+				|| (!cpo_lit && vim_strchr(REGEXP_ABBR,
+						    cs->cs_parse[1]) != NULL)))
 		    {
-			regparse++;
-			regc(backslash_trans(*regparse++));
+			cs->cs_parse++;
+			regc(cs, backslash_trans(*cs->cs_parse++));
 		    }
 		    else
-			regc(*regparse++);
+			regc(cs, *cs->cs_parse++);
 		}
-		regc('\0');
-		if (*regparse != ']')
+		regc(cs, '\0');
+		if (*cs->cs_parse != ']')
 		    EMSG_RETURN(e_toomsbra);
-		skipchr();	    /* let's be friends with the lexer again */
+		skipchr(cs);	    /* let's be friends with the lexer again */
 		*flagp |= HASWIDTH | SIMPLE;
 		break;
 	    }
@@ -935,17 +1243,17 @@ regatom(flagp)
 	    int		    len;
 	    int		    chr;
 
-	    ungetchr();
+	    ungetchr(cs);
 	    len = 0;
-	    ret = regnode(EXACTLY);
+	    ret = regnode(cs, EXACTLY);
 	    /*
 	     * Always take at least one character, for '[' without matching
 	     * ']'.
 	     */
-	    while ((chr = peekchr()) != '\0' && (chr < Magic(0) || len == 0))
+	    while ((chr = peekchr(cs)) != '\0' && (chr < Magic(0) || len == 0))
 	    {
-		regc(chr);
-		skipchr();
+		regc(cs, chr);
+		skipchr(cs);
 		len++;
 	    }
 #ifdef DEBUG
@@ -958,11 +1266,11 @@ regatom(flagp)
 	     */
 	    if (len > 1 && re_ismult(chr))
 	    {
-		unregc();	    /* Back off of *+= operand */
-		ungetchr();	    /* and put it back for next time */
+		unregc(cs);	    /* Back off of *+= operand */
+		ungetchr(cs);	    /* and put it back for next time */
 		--len;
 	    }
-	    regc('\0');
+	    regc(cs, '\0');
 	    *flagp |= HASWIDTH;
 	    if (len == 1)
 		*flagp |= SIMPLE;
@@ -977,23 +1285,24 @@ regatom(flagp)
  * regnode - emit a node
  */
     static char_u *		/* Location. */
-regnode(op)
+regnode(cs, op)
+    REGCOMP	*cs;
     int		op;
 {
     char_u  *ret;
     char_u  *ptr;
 
-    ret = regcode;
+    ret = cs->cs_code;
     if (ret == JUST_CALC_SIZE)
     {
-	regsize += 3;
+	cs->cs_size += 3;
 	return ret;
     }
     ptr = ret;
     *ptr++ = op;
     *ptr++ = '\0';		/* Null "next" pointer. */
     *ptr++ = '\0';
-    regcode = ptr;
+    cs->cs_code = ptr;
 
     return ret;
 }
@@ -1002,25 +1311,27 @@ regnode(op)
  * regc - emit (if appropriate) a byte of code
  */
     static void
-regc(b)
+regc(cs, b)
+    REGCOMP	*cs;
     int		b;
 {
-    if (regcode != JUST_CALC_SIZE)
-	*regcode++ = b;
+    if (cs->cs_code != JUST_CALC_SIZE)
+	*cs->cs_code++ = b;
     else
-	regsize++;
+	cs->cs_size++;
 }
 
 /*
  * unregc - take back (if appropriate) a byte of code
  */
     static void
-unregc()
+unregc(cs)
+    REGCOMP	*cs;
 {
-    if (regcode != JUST_CALC_SIZE)
-	regcode--;
+    if (cs->cs_code != JUST_CALC_SIZE)
+	cs->cs_code--;
     else
-	regsize--;
+	cs->cs_size--;
 }
 
 /*
@@ -1029,7 +1340,8 @@ unregc()
  * Means relocating the operand.
  */
     static void
-reginsert(op, opnd)
+reginsert(cs, op, opnd)
+    REGCOMP	*cs;
     int		op;
     char_u     *opnd;
 {
@@ -1037,14 +1349,14 @@ reginsert(op, opnd)
     char_u  *dst;
     char_u  *place;
 
-    if (regcode == JUST_CALC_SIZE)
+    if (cs->cs_code == JUST_CALC_SIZE)
     {
-	regsize += 3;
+	cs->cs_size += 3;
 	return;
     }
-    src = regcode;
-    regcode += 3;
-    dst = regcode;
+    src = cs->cs_code;
+    cs->cs_code += 3;
+    dst = cs->cs_code;
     while (src > opnd)
 	*--dst = *--src;
 
@@ -1061,7 +1373,8 @@ reginsert(op, opnd)
  * Means relocating the operand.
  */
     static void
-reginsert_limits(op, minval, maxval, opnd)
+reginsert_limits(cs, op, minval, maxval, opnd)
+    REGCOMP	*cs;
     int		op;
     int		minval;
     int		maxval;
@@ -1071,14 +1384,14 @@ reginsert_limits(op, minval, maxval, opnd)
     char_u  *dst;
     char_u  *place;
 
-    if (regcode == JUST_CALC_SIZE)
+    if (cs->cs_code == JUST_CALC_SIZE)
     {
-	regsize += 7;
+	cs->cs_size += 7;
 	return;
     }
-    src = regcode;
-    regcode += 7;
-    dst = regcode;
+    src = cs->cs_code;
+    cs->cs_code += 7;
+    dst = cs->cs_code;
     while (src > opnd)
 	*--dst = *--src;
 
@@ -1143,68 +1456,66 @@ regoptail(p, val)
 }
 
 /*
- * getchr() - get the next character from the pattern. We know about
+ * getchr(cs) - get the next character from the pattern. We know about
  * magic and such, so therefore we need a lexical analyzer.
  */
 
-/* static int	    curchr; */
-static int	prevchr;
-static int	nextchr;    /* used for ungetchr() */
 /*
- * Note: prevchr is sometimes -1 when we are not at the start,
+ * Note: cs_prevchr is sometimes -1 when we are not at the start,
  * eg in /[ ^I]^ the pattern was never found even if it existed, because ^ was
  * taken to be magic -- webb
  */
-static int	at_start;   /* True when we are on the first character */
 
     static void
-initchr(str)
+initchr(cs, str)
+    REGCOMP	*cs;
     char_u *str;
 {
-    regparse = str;
-    curchr = prevchr = nextchr = -1;
-    at_start = TRUE;
+    cs->cs_parse = str;
+    cs->cs_curchr = cs->cs_prevchr = cs->cs_nextchr = -1;
+    cs->cs_at_start = TRUE;
 }
 
     static int
-peekchr()
+peekchr(cs)
+    REGCOMP	*cs;
 {
-    if (curchr < 0)
+    if (cs->cs_curchr < 0)
     {
-	switch (curchr = regparse[0])
+	switch (cs->cs_curchr = cs->cs_parse[0])
 	{
 	case '.':
     /*	case '+':*/
     /*	case '=':*/
 	case '[':
 	case '~':
-	    if (reg_magic)
-		curchr = Magic(curchr);
+	    if (cs->cs_magic)
+		cs->cs_curchr = Magic(cs->cs_curchr);
 	    break;
 	case '*':
 	    /* * is not magic as the very first character, eg "?*ptr" */
-	    if (reg_magic && !at_start)
-		curchr = Magic('*');
+	    if (cs->cs_magic && !cs->cs_at_start)
+		cs->cs_curchr = Magic('*');
 	    break;
 	case '^':
 	    /* ^ is only magic as the very first character */
-	    if (at_start)
-		curchr = Magic('^');
+	    if (cs->cs_at_start)
+		cs->cs_curchr = Magic('^');
 	    break;
 	case '$':
 	    /* $ is only magic as the very last char and in front of '\|' */
-	    if (regparse[1] == NUL
-			       || (regparse[1] == '\\' && regparse[2] == '|'))
-		curchr = Magic('$');
+	    if (cs->cs_parse[1] == NUL || (cs->cs_parse[1] == '\\'
+						    && cs->cs_parse[2] == '|'))
+		cs->cs_curchr = Magic('$');
 	    break;
 	case '\\':
-	    regparse++;
-	    if (regparse[0] == NUL)
+	    cs->cs_parse++;
+	    if (cs->cs_parse[0] == NUL)
 	    {
-		curchr = '\\';	/* trailing '\' */
-		--regparse;	/* there is no extra character to skip */
+		cs->cs_curchr = '\\';	/* trailing '\' */
+		--cs->cs_parse;	/* there is no extra character to skip */
 	    }
-	    else if (vim_strchr(META, regparse[0]))
+	    else if (vim_strchr(META, cs->cs_parse[0]))
 	    {
 		/*
 		 * META contains everything that may be magic sometimes, except
@@ -1212,17 +1523,17 @@ peekchr()
 		 * We now fetch the next character and toggle its magicness.
 		 * Therefore, \ is so meta-magic that it is not in META.
 		 */
-		curchr = -1;
-		at_start = FALSE;	/* be able to say "/\*ptr" */
-		peekchr();
-		curchr ^= Magic(0);
+		cs->cs_curchr = -1;
+		cs->cs_at_start = FALSE;	/* be able to say "/\*ptr" */
+		peekchr(cs);
+		cs->cs_curchr ^= Magic(0);
 	    }
-	    else if (vim_strchr(REGEXP_ABBR, regparse[0]))
+	    else if (vim_strchr(REGEXP_ABBR, cs->cs_parse[0]))
 	    {
 		/*
 		 * Handle abbreviations, like "\t" for TAB -- webb
 		 */
-		curchr = backslash_trans(regparse[0]);
+		cs->cs_curchr = backslash_trans(cs->cs_parse[0]);
 	    }
 	    else
 	    {
@@ -1230,32 +1541,34 @@ peekchr()
 		 * Next character can never be (made) magic?
 		 * Then backslashing it won't do anything.
 		 */
-		curchr = regparse[0];
+		cs->cs_curchr = cs->cs_parse[0];
 	    }
 	    break;
 	}
     }
 
-    return curchr;
+    return cs->cs_curchr;
 }
 
     static void
-skipchr()
+skipchr(cs)
+    REGCOMP	*cs;
 {
-    regparse++;
-    at_start = FALSE;
-    prevchr = curchr;
-    curchr = nextchr;	    /* use previously unget char, or -1 */
-    nextchr = -1;
+    cs->cs_parse++;
+    cs->cs_at_start = FALSE;
+    cs->cs_prevchr = cs->cs_curchr;
+    cs->cs_curchr = cs->cs_nextchr;	/* use previously unget char, or -1 */
+    cs->cs_nextchr = -1;
 }
 
     static int
-getchr()
+getchr(cs)
+    REGCOMP	*cs;
 {
     int chr;
 
-    chr = peekchr();
-    skipchr();
+    chr = peekchr(cs);
+    skipchr(cs);
 
     return chr;
 }
@@ -1264,15 +1577,16 @@ getchr()
  * put character back. Works only once!
  */
     static void
-ungetchr()
+ungetchr(cs)
+    REGCOMP	*cs;
 {
-    nextchr = curchr;
-    curchr = prevchr;
+    cs->cs_nextchr = cs->cs_curchr;
+    cs->cs_curchr = cs->cs_prevchr;
     /*
-     * Backup regparse as well; not because we will use what it points at,
-     * but because skipchr() will bump it again.
+     * Backup cs_parse as well; not because we will use what it points at,
+     * but because skipchr(cs) will bump it again.
      */
-    regparse--;
+    cs->cs_parse--;
 }
 
 /*
@@ -1282,7 +1596,8 @@ ungetchr()
  * missing, a very big number is the default.
  */
     static int
-read_limits(start, end, minval, maxval)
+read_limits(cs, start, end, minval, maxval)
+    REGCOMP	*cs;
     int	    start;
     int	    end;
     int	    *minval;
@@ -1291,18 +1606,18 @@ read_limits(start, end, minval, maxval)
     int	    reverse = FALSE;
     char_u  *first_char;
 
-    if (*regparse == '-')
+    if (*cs->cs_parse == '-')
     {
 	/* Starts with '-', so reverse the range later */
-	regparse++;
+	cs->cs_parse++;
 	reverse = TRUE;
     }
-    first_char = regparse;
-    *minval = getdigits(&regparse);
-    if (*regparse == ',')	    /* There is a comma */
+    first_char = cs->cs_parse;
+    *minval = getdigits(&cs->cs_parse);
+    if (*cs->cs_parse == ',')	    /* There is a comma */
     {
-	if (isdigit(*++regparse))
-	    *maxval = getdigits(&regparse);
+	if (isdigit(*++cs->cs_parse))
+	    *maxval = getdigits(&cs->cs_parse);
 	else
 	    *maxval = MAX_LIMIT;
     }
@@ -1310,9 +1625,9 @@ read_limits(start, end, minval, maxval)
 	*maxval = *minval;	    /* It was \{n} or \{-n} */
     else
 	*maxval = MAX_LIMIT;	    /* It was \{} or \{-} */
-    if (*regparse == '\\')
-	regparse++;	/* Allow either \{...} or \{...\} */
-    if (       (*regparse != end && *regparse != NUL)
+    if (*cs->cs_parse == '\\')
+	cs->cs_parse++;	/* Allow either \{...} or \{...\} */
+    if (       (*cs->cs_parse != end && *cs->cs_parse != NUL)
 	    || (*maxval == 0 && *minval == 0))
     {
 	sprintf((char *)IObuff, "Syntax error in \\%c...%c", start, end);
@@ -1333,7 +1648,7 @@ read_limits(start, end, minval, maxval)
 	*minval = *maxval;
 	*maxval = tmp;
     }
-    skipchr();		/* let's be friends with the lexer again */
+    skipchr(cs);		/* let's be friends with the lexer again */
     return OK;
 }
 
@@ -1342,36 +1657,86 @@ read_limits(start, end, minval, maxval)
  */
 
 /*
- * Global work variables for vim_regexec().
+ * Work arrays of a REGEXEC for regnfa() and regdfa(), allocated when first
+ * used.
  */
-static char_u	 *reginput;		/* String-input pointer. */
-static char_u	 *regbol;		/* Beginning of input, for ^ check. */
-static char_u	**regstartp;		/* Pointer to startp array. */
-static int	  need_clear_subexpr;	/* *regstartp end *regendp still need
-					   to be cleared */
-
-static int	regtry __ARGS((vim_regexp *, char_u *));
-static void	clear_subexpr __ARGS((void));
-static int	regmatch __ARGS((char_u *));
-static int	regrepeat __ARGS((char_u *));
+struct regwork
+{
+    struct growarray	rw_threads[2];	/* current and next thread list */
+    struct growarray	*rw_list;	/* list to add threads to */
+    struct growarray	rw_visit;	/* states added for this position */
+    int			*rw_visit_gen;	/* see regnfa_visited() */
+    int			*rw_visit_head;
+    long		rw_visit_size;	/* number of entries in rw_visit_gen */
+    int			rw_visit_cur;
+    vim_regexp		*rw_prog;	/* program being executed */
+    int			rw_thread_size;	/* used part of a REGTHREAD */
+    int			rw_fail;	/* out of memory */
+    struct growarray	rw_items;	/* items for a new DFA state */
+    int			rw_cleared;	/* times the DFA states were cleared */
+};
+
+static int	regexec_prog __ARGS((REGEXEC *, vim_regexp *, char_u *, int));
+static int	regtry __ARGS((REGEXEC *, vim_regexp *, char_u *));
+static void	clear_subexpr __ARGS((REGEXEC *));
+static int	regmatch __ARGS((REGEXEC *, char_u *));
+static int	regrepeat __ARGS((REGEXEC *, char_u *));
+static int	regnfa __ARGS((REGEXEC *, vim_regexp *, char_u *));
+static int	regdfa __ARGS((REGEXEC *, vim_regexp *, char_u *));
+static void	regdfa_clear __ARGS((struct regdfa *));
 
 #ifdef DEBUG
 int		regnarrate = 0;
 #endif
 
 /*
- * vim_regexec - match a regexp against a string
- * Uses current value of reg_ic.
+ * Initialize context "rex" for vim_regexec(), ignoring case when "ic" is
+ * TRUE.  vim_regexec_free() must be called when done with it.
+ */
+    void
+vim_regexec_init(rex, ic)
+    REGEXEC	*rex;
+    int		ic;
+{
+    vim_memset(rex, 0, sizeof(REGEXEC));
+    rex->rx_ic = ic;
+}
+
+/*
+ * Free the memory used by context "rex".  It can be used again after this.
+ */
+    void
+vim_regexec_free(rex)
+    REGEXEC	*rex;
+{
+    struct regwork	*rw = rex->rx_work;
+
+    if (rw != NULL)
+    {
+	ga_clear(&rw->rw_threads[0]);
+	ga_clear(&rw->rw_threads[1]);
+	ga_clear(&rw->rw_visit);
+	ga_clear(&rw->rw_items);
+	vim_free(rw->rw_visit_gen);
+	vim_free(rw->rw_visit_head);
+	vim_free(rw);
+	rex->rx_work = NULL;
+    }
+}
+
+/*
+ * vim_regexec - match a regexp against a string, using context "rex"
+ * Ignores case when rex->rx_ic is set.  The positions of the match are
+ * stored in rex->rx_startp[] and rex->rx_endp[], nothing global is changed.
  * Return non-zero if there is a match.
  */
     int
-vim_regexec(prog, string, at_bol)
+vim_regexec(rex, prog, string, at_bol)
+    REGEXEC	*rex;
     vim_regexp	*prog;
     char_u	*string;
     int		at_bol;
 {
-    char_u	*s;
-
     /* Be paranoid... */
     if (prog == NULL || string == NULL)
     {
@@ -1386,41 +1751,58 @@ vim_regexec(prog, string, at_bol)
 	rc_did_emsg = TRUE;
 	return 0;
     }
-    /* If there is a "must appear" string, look for it. */
-    if (prog->regmust != NULL)
-    {
-	s = string;
-	while ((s = cstrchr(s, prog->regmust[0])) != NULL)
-	{
-	    if (cstrncmp(s, prog->regmust, prog->regmlen) == 0)
-		break;		/* Found it. */
-	    s++;
-	}
-	if (s == NULL)		/* Not present. */
-	    return 0;
-    }
+    /* If there are "must appear" strings, look for them. */
+    if (prog->regnmust > 0 && !regmust_found(prog, string,
+					  string + STRLEN(string), rex->rx_ic))
+	return 0;
+    return regexec_prog(rex, prog, string, at_bol);
+}
+
+/*
+ * The part of vim_regexec() after the checks.
+ */
+    static int
+regexec_prog(rex, prog, string, at_bol)
+    REGEXEC	*rex;
+    vim_regexp	*prog;
+    char_u	*string;
+    int		at_bol;
+{
+    char_u	*s;
+
     /* Mark beginning of line for ^ . */
     if (at_bol)
-	regbol = string;	/* is possible to match bol */
+	rex->rx_bol = string;	/* is possible to match bol */
     else
-	regbol = NULL;		/* we aren't there, so don't match it */
+	rex->rx_bol = NULL;	/* we aren't there, so don't match it */
+
+    /* Without back references the NFA matcher can be used, see
+     * 'regexpengine'.  Without \( \) the DFA cache can first find out if
+     * there is a match at all. */
+    if (p_re != 1 && !prog->regbackref)
+    {
+	if (prog->regnsub == 1 && prog->regnbrace == 0
+					  && regdfa(rex, prog, string) == 0)
+	    return 0;
+	return regnfa(rex, prog, string);
+    }
 
     /* Simplest case:  anchored match need be tried only once. */
     if (prog->reganch)
     {
 	if (prog->regstart != '\0' && prog->regstart != string[0] &&
-	    (!reg_ic || TO_LOWER(prog->regstart) != TO_LOWER(string[0])))
+	    (!rex->rx_ic || TO_LOWER(prog->regstart) != TO_LOWER(string[0])))
 	    return 0;
-	return regtry(prog, string);
+	return regtry(rex, prog, string);
     }
 
     /* Messy cases:  unanchored match. */
     s = string;
     if (prog->regstart != '\0')
 	/* We know what char it must start with. */
-	while ((s = cstrchr(s, prog->regstart)) != NULL)
+	while ((s = cstrchr(s, prog->regstart, rex->rx_ic)) != NULL)
 	{
-	    if (regtry(prog, s))
+	    if (regtry(rex, prog, s))
 		return 1;
 	    s++;
 	}
@@ -1428,7 +1810,7 @@ vim_regexec(prog, string, at_bol)
 	/* We don't -- general case. */
 	do
 	{
-	    if (regtry(prog, s))
+	    if (regtry(rex, prog, s))
 		return 1;
 	} while (*s++ != '\0');
 
@@ -1436,24 +1818,105 @@ vim_regexec(prog, string, at_bol)
     return 0;
 }
 
+/*
+ * vim_regexec_all - find all matches of "prog" in "line", using context "rex"
+ * After a match the next one is looked for at its end when "skip" is TRUE,
+ * one character after its start otherwise.  The start and end of each match
+ * are appended to "gap", a growarray with REGMATCH items.
+ * Returns the number of matches, -1 when out of memory.
+ */
+    int
+vim_regexec_all(rex, prog, line, gap, skip)
+    REGEXEC		*rex;
+    vim_regexp		*prog;
+    char_u		*line;
+    struct growarray	*gap;
+    int			skip;
+{
+    REGMATCH	*rm;
+    char_u	*p;
+    int		n = 0;
+
+    if (!vim_regexec(rex, prog, line, TRUE))
+	return 0;
+    for (;;)
+    {
+	if (ga_grow(gap, 1) == FAIL)
+	    return -1;
+	rm = ((REGMATCH *)gap->ga_data) + gap->ga_len;
+	rm->rm_startp = rex->rx_startp[0];
+	rm->rm_endp = rex->rx_endp[0];
+	++gap->ga_len;
+	--gap->ga_room;
+	++n;
+
+	if (skip)
+	{
+	    p = rm->rm_endp;
+	    if (p == rm->rm_startp && *p != NUL)
+		++p;
+	}
+	else
+	{
+	    p = rm->rm_startp;
+	    if (*p != NUL)
+		++p;
+	}
+	/* The "must appear" strings were already found. */
+	if (*p == NUL || !regexec_prog(rex, prog, p, FALSE))
+	    break;
+    }
+    return n;
+}
+
+/*
+ * Return TRUE if programs "prog1" and "prog2" are the same, thus they match
+ * the same text.
+ */
+    int
+vim_regsame(prog1, prog2)
+    vim_regexp	*prog1;
+    vim_regexp	*prog2;
+{
+    return (prog1->regsize == prog2->regsize
+	    && vim_memcmp(prog1->program, prog2->program,
+						 (size_t)prog1->regsize) == 0);
+}
+
+/*
+ * vim_regfree - free a program returned by vim_regcomp()
+ */
+    void
+vim_regfree(prog)
+    vim_regexp	*prog;
+{
+    if (prog == NULL)
+	return;
+    if (prog->regdfa != NULL)
+    {
+	regdfa_clear(prog->regdfa);
+	vim_free(prog->regdfa);
+    }
+    vim_free(prog);
+}
+
 /*
  * regtry - try match at specific point
  */
     static int			/* 0 failure, 1 success */
-regtry(prog, string)
+regtry(rex, prog, string)
+    REGEXEC	   *rex;
     vim_regexp	   *prog;
     char_u	   *string;
 {
-    reginput = string;
-    regstartp = prog->startp;
-    regendp = prog->endp;
-    need_clear_subexpr = TRUE;
+    rex->rx_input = string;
+    rex->rx_need_clear = TRUE;
 
-    if (regmatch(prog->program + 1))
+    if (regmatch(rex, prog->program + 1))
     {
-	clear_subexpr();
-	prog->startp[0] = string;
-	prog->endp[0] = reginput;
+	clear_subexpr(rex);
+	rex->rx_startp[0] = string;
+	rex->rx_endp[0] = rex->rx_input;
 	return 1;
     }
     else
@@ -1466,13 +1929,14 @@ regtry(prog, string)
  * used (to increase speed).
  */
     static void
-clear_subexpr()
+clear_subexpr(rex)
+    REGEXEC	*rex;
 {
-    if (need_clear_subexpr)
+    if (rex->rx_need_clear)
     {
-	vim_memset(regstartp, 0, sizeof(char_u *) * NSUBEXP);
-	vim_memset(regendp, 0, sizeof(char_u *) * NSUBEXP);
-	need_clear_subexpr = FALSE;
+	vim_memset(rex->rx_startp, 0, sizeof(rex->rx_startp));
+	vim_memset(rex->rx_endp, 0, sizeof(rex->rx_endp));
+	rex->rx_need_clear = FALSE;
     }
 }
 
@@ -1487,7 +1951,8 @@ clear_subexpr()
  * by recursion.
  */
     static int			/* 0 failure, 1 success */
-regmatch(prog)
+regmatch(rex, prog)
+    REGEXEC	   *rex;
     char_u	   *prog;
 {
     char_u	    *scan;	/* Current node. */
@@ -1516,79 +1981,80 @@ regmatch(prog)
 	switch (OP(scan))
 	{
 	  case BOL:
-	    if (reginput != regbol)
+	    if (rex->rx_input != rex->rx_bol)
 		return 0;
 	    break;
 	  case EOL:
-	    if (*reginput != '\0')
+	    if (*rex->rx_input != '\0')
 		return 0;
 	    break;
-	  case BOW:	/* \<word; reginput points to w */
-	    if (reginput != regbol && vim_iswordc(reginput[-1]))
+	  case BOW:	/* \<word; rx_input points to w */
+	    if (rex->rx_input != rex->rx_bol && vim_iswordc(rex->rx_input[-1]))
 		return 0;
-	    if (!reginput[0] || !vim_iswordc(reginput[0]))
+	    if (!rex->rx_input[0] || !vim_iswordc(rex->rx_input[0]))
 		return 0;
 	    break;
-	  case EOW:	/* word\>; reginput points after d */
-	    if (reginput == regbol || !vim_iswordc(reginput[-1]))
+	  case EOW:	/* word\>; rx_input points after d */
+	    if (rex->rx_input == rex->rx_bol
+					    || !vim_iswordc(rex->rx_input[-1]))
 		return 0;
-	    if (reginput[0] && vim_iswordc(reginput[0]))
+	    if (rex->rx_input[0] && vim_iswordc(rex->rx_input[0]))
 		return 0;
 	    break;
 	  case ANY:
-	    if (*reginput == '\0')
+	    if (*rex->rx_input == '\0')
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case IDENT:
-	    if (!vim_isIDc(*reginput))
+	    if (!vim_isIDc(*rex->rx_input))
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case WORD:
-	    if (!vim_iswordc(*reginput))
+	    if (!vim_iswordc(*rex->rx_input))
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case FNAME:
-	    if (!vim_isfilec(*reginput))
+	    if (!vim_isfilec(*rex->rx_input))
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case PRINT:
-	    if (charsize(*reginput) != 1)
+	    if (charsize(*rex->rx_input) != 1)
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case SIDENT:
-	    if (isdigit(*reginput) || !vim_isIDc(*reginput))
+	    if (isdigit(*rex->rx_input) || !vim_isIDc(*rex->rx_input))
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case SWORD:
-	    if (isdigit(*reginput) || !vim_iswordc(*reginput))
+	    if (isdigit(*rex->rx_input) || !vim_iswordc(*rex->rx_input))
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case SFNAME:
-	    if (isdigit(*reginput) || !vim_isfilec(*reginput))
+	    if (isdigit(*rex->rx_input) || !vim_isfilec(*rex->rx_input))
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case SPRINT:
-	    if (isdigit(*reginput) || charsize(*reginput) != 1)
+	    if (isdigit(*rex->rx_input) || charsize(*rex->rx_input) != 1)
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case WHITE:
-	    if (!vim_iswhite(*reginput))
+	    if (!vim_iswhite(*rex->rx_input))
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case NWHITE:
-	    if (*reginput == NUL || vim_iswhite(*reginput))
+	    if (*rex->rx_input == NUL || vim_iswhite(*rex->rx_input))
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case EXACTLY:
 	    {
@@ -1597,24 +2063,27 @@ regmatch(prog)
 
 		opnd = OPERAND(scan);
 		/* Inline the first character, for speed. */
-		if (*opnd != *reginput
-			&& (!reg_ic || TO_LOWER(*opnd) != TO_LOWER(*reginput)))
+		if (*opnd != *rex->rx_input && (!rex->rx_ic
+			       || TO_LOWER(*opnd) != TO_LOWER(*rex->rx_input)))
 		    return 0;
 		len = STRLEN(opnd);
-		if (len > 1 && cstrncmp(opnd, reginput, len) != 0)
+		if (len > 1
+			&& cstrncmp(opnd, rex->rx_input, len, rex->rx_ic) != 0)
 		    return 0;
-		reginput += len;
+		rex->rx_input += len;
 	    }
 	    break;
 	  case ANYOF:
-	    if (*reginput == '\0' || cstrchr(OPERAND(scan), *reginput) == NULL)
+	    if (*rex->rx_input == '\0' || cstrchr(OPERAND(scan),
+					  *rex->rx_input, rex->rx_ic) == NULL)
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case ANYBUT:
-	    if (*reginput == '\0' || cstrchr(OPERAND(scan), *reginput) != NULL)
+	    if (*rex->rx_input == '\0' || cstrchr(OPERAND(scan),
+					  *rex->rx_input, rex->rx_ic) != NULL)
 		return 0;
-	    reginput++;
+	    rex->rx_input++;
 	    break;
 	  case NOTHING:
 	    break;
@@ -1633,30 +2102,30 @@ regmatch(prog)
 		int	    no;
 		char_u	    *save;
 
-		clear_subexpr();
+		clear_subexpr(rex);
 		no = OP(scan) - MOPEN;
-		save = regstartp[no];
-		regstartp[no] = reginput; /* Tentatively */
+		save = rex->rx_startp[no];
+		rex->rx_startp[no] = rex->rx_input; /* Tentatively */
 #ifdef DEBUG
 		if (regnarrate)
 		    printf("MOPEN  %d pre  @'%s' ('%s' )'%s'\n",
 			no, save,
-			regstartp[no] ? (char *)regstartp[no] : "NULL",
-			regendp[no] ? (char *)regendp[no] : "NULL");
+		      rex->rx_startp[no] ? (char *)rex->rx_startp[no] : "NULL",
+			 rex->rx_endp[no] ? (char *)rex->rx_endp[no] : "NULL");
 #endif
 
-		if (regmatch(next))
+		if (regmatch(rex, next))
 		{
 #ifdef DEBUG
 		    if (regnarrate)
 			printf("MOPEN  %d post @'%s' ('%s' )'%s'\n",
 				no, save,
-				regstartp[no] ? (char *)regstartp[no] : "NULL",
-				regendp[no] ? (char *)regendp[no] : "NULL");
+		      rex->rx_startp[no] ? (char *)rex->rx_startp[no] : "NULL",
+			 rex->rx_endp[no] ? (char *)rex->rx_endp[no] : "NULL");
 #endif
 		    return 1;
 		}
-		regstartp[no] = save;	    /* We were wrong... */
+		rex->rx_startp[no] = save;	    /* We were wrong... */
 		return 0;
 	    }
 	    /* break; Not Reached */
@@ -1673,30 +2142,30 @@ regmatch(prog)
 		int	    no;
 		char_u	    *save;
 
-		clear_subexpr();
+		clear_subexpr(rex);
 		no = OP(scan) - MCLOSE;
-		save = regendp[no];
-		regendp[no] = reginput; /* Tentatively */
+		save = rex->rx_endp[no];
+		rex->rx_endp[no] = rex->rx_input; /* Tentatively */
 #ifdef DEBUG
 		if (regnarrate)
 		    printf("MCLOSE %d pre  @'%s' ('%s' )'%s'\n",
 			no, save,
-			regstartp[no] ? (char *)regstartp[no] : "NULL",
-			regendp[no] ? (char *)regendp[no] : "NULL");
+		      rex->rx_startp[no] ? (char *)rex->rx_startp[no] : "NULL",
+			 rex->rx_endp[no] ? (char *)rex->rx_endp[no] : "NULL");
 #endif
 
-		if (regmatch(next))
+		if (regmatch(rex, next))
 		{
 #ifdef DEBUG
 		    if (regnarrate)
 			printf("MCLOSE %d post @'%s' ('%s' )'%s'\n",
 				no, save,
-				regstartp[no] ? (char *)regstartp[no] : "NULL",
-				regendp[no] ? (char *)regendp[no] : "NULL");
+		      rex->rx_startp[no] ? (char *)rex->rx_startp[no] : "NULL",
+			 rex->rx_endp[no] ? (char *)rex->rx_endp[no] : "NULL");
 #endif
 		    return 1;
 		}
-		regendp[no] = save;	/* We were wrong... */
+		rex->rx_endp[no] = save;	/* We were wrong... */
 		return 0;
 	    }
 	    /* break; Not Reached */
@@ -1713,14 +2182,15 @@ regmatch(prog)
 		int	no;
 		int	len;
 
-		clear_subexpr();
+		clear_subexpr(rex);
 		no = OP(scan) - BACKREF;
-		if (regendp[no] != NULL)
+		if (rex->rx_endp[no] != NULL)
 		{
-		    len = (int)(regendp[no] - regstartp[no]);
-		    if (cstrncmp(regstartp[no], reginput, len) != 0)
+		    len = (int)(rex->rx_endp[no] - rex->rx_startp[no]);
+		    if (cstrncmp(rex->rx_startp[no], rex->rx_input, len,
+							     rex->rx_ic) != 0)
 			return 0;
-		    reginput += len;
+		    rex->rx_input += len;
 		}
 		else
 		{
@@ -1739,10 +2209,10 @@ regmatch(prog)
 		{
 		    do
 		    {
-			save = reginput;
-			if (regmatch(OPERAND(scan)))
+			save = rex->rx_input;
+			if (regmatch(rex, OPERAND(scan)))
 			    return 1;
-			reginput = save;
+			rex->rx_input = save;
 			scan = regnext(scan);
 		    } while (scan != NULL && OP(scan) == BRANCH);
 		    return 0;
@@ -1763,9 +2233,7 @@ regmatch(prog)
 			 OP(next) < BRACE_COMPLEX + 10)
 		{
 		    no = OP(next) - BRACE_COMPLEX;
-		    brace_min[no] = OPERAND_MIN(scan);
-		    brace_max[no] = OPERAND_MAX(scan);
-		    brace_count[no] = 0;
+		    rex->rx_brace_count[no] = 0;
 		}
 		else
 		{
@@ -1789,43 +2257,46 @@ regmatch(prog)
 		char_u	    *save;
 
 		no = OP(scan) - BRACE_COMPLEX;
-		++brace_count[no];
+		++rex->rx_brace_count[no];
+		/* The BRACE_LIMITS node is just before this one. */
+		minval = OPERAND_MIN(scan - 7);
+		maxval = OPERAND_MAX(scan - 7);
 
 		/* If not matched enough times yet, try one more */
-		if (brace_count[no] <= (brace_min[no] <= brace_max[no]
-				    ? brace_min[no] : brace_max[no]))
+		if (rex->rx_brace_count[no] <= (minval <= maxval
+							   ? minval : maxval))
 		{
-		    save = reginput;
-		    if (regmatch(OPERAND(scan)))
+		    save = rex->rx_input;
+		    if (regmatch(rex, OPERAND(scan)))
 			return 1;
-		    reginput = save;
-		    --brace_count[no];	/* failed, decrement match count */
+		    rex->rx_input = save;
+		    --rex->rx_brace_count[no];	/* failed, decrement count */
 		    return 0;
 		}
 
 		/* If matched enough times, may try matching some more */
-		if (brace_min[no] <= brace_max[no])
+		if (minval <= maxval)
 		{
 		    /* Range is the normal way around, use longest match */
-		    if (brace_count[no] <= brace_max[no])
+		    if (rex->rx_brace_count[no] <= maxval)
 		    {
-			save = reginput;
-			if (regmatch(OPERAND(scan)))
+			save = rex->rx_input;
+			if (regmatch(rex, OPERAND(scan)))
 			    return 1;	    /* matched some more times */
-			reginput = save;
-			--brace_count[no];  /* matched just enough times */
+			rex->rx_input = save;
+			--rex->rx_brace_count[no];  /* matched just enough */
 			/* continue with the items after \{} */
 		    }
 		}
 		else
 		{
 		    /* Range is backwards, use shortest match first */
-		    if (brace_count[no] <= brace_min[no])
+		    if (rex->rx_brace_count[no] <= minval)
 		    {
-			save = reginput;
-			if (regmatch(next))
+			save = rex->rx_input;
+			if (regmatch(rex, next))
 			    return 1;
-			reginput = save;
+			rex->rx_input = save;
 			next = OPERAND(scan);
 			/* must try to match one more item */
 		    }
@@ -1849,7 +2320,7 @@ regmatch(prog)
 		if (OP(next) == EXACTLY)
 		{
 		    nextch = *OPERAND(next);
-		    if (reg_ic)
+		    if (rex->rx_ic)
 		    {
 			if (isupper(nextch))
 			    nextch_ic = TO_LOWER(nextch);
@@ -1870,26 +2341,26 @@ regmatch(prog)
 		    maxval = MAX_LIMIT;
 		}
 
-		save = reginput;
-		no = regrepeat(OPERAND(scan));
+		save = rex->rx_input;
+		no = regrepeat(rex, OPERAND(scan));
 		if (minval <= maxval)
 		{
 		    /* Range is the normal way around, use longest match */
 		    if (no > maxval)
 		    {
 			no = maxval;
-			reginput = save + no;
+			rex->rx_input = save + no;
 		    }
 		    while (no >= minval)
 		    {
 			/* If it could work, try it. */
-			if (nextch == '\0' || *reginput == nextch
-						    || *reginput == nextch_ic)
-			    if (regmatch(next))
+			if (nextch == '\0' || *rex->rx_input == nextch
+					       || *rex->rx_input == nextch_ic)
+			    if (regmatch(rex, next))
 				return 1;
 			/* Couldn't or didn't -- back up. */
 			no--;
-			reginput = save + no;
+			rex->rx_input = save + no;
 		    }
 		}
 		else
@@ -1900,17 +2371,17 @@ regmatch(prog)
 		    if (minval > no)
 			minval = no;	/* Actually maximum value */
 		    no = maxval;
-		    reginput = save + no;
+		    rex->rx_input = save + no;
 		    while (no <= minval)
 		    {
 			/* If it could work, try it. */
-			if (nextch == '\0' || *reginput == nextch
-						    || *reginput == nextch_ic)
-			    if (regmatch(next))
+			if (nextch == '\0' || *rex->rx_input == nextch
+					       || *rex->rx_input == nextch_ic)
+			    if (regmatch(rex, next))
 				return 1;
 			/* Couldn't or didn't -- try longer match. */
 			no++;
-			reginput = save + no;
+			rex->rx_input = save + no;
 		    }
 		}
 		return 0;
@@ -1946,14 +2417,15 @@ regmatch(prog)
  * regrepeat - repeatedly match something simple, report how many
  */
     static int
-regrepeat(p)
+regrepeat(rex, p)
+    REGEXEC	   *rex;
     char_u	   *p;
 {
     int	    count = 0;
     char_u  *scan;
     char_u  *opnd;
 
-    scan = reginput;
+    scan = rex->rx_input;
     opnd = OPERAND(p);
     switch (OP(p))
     {
@@ -2005,7 +2477,7 @@ regrepeat(p)
 	{
 	    int	    cu, cl;
 
-	    if (reg_ic)
+	    if (rex->rx_ic)
 	    {
 		cu = TO_UPPER(*opnd);
 		cl = TO_LOWER(*opnd);
@@ -2027,14 +2499,14 @@ regrepeat(p)
 	    break;
 	}
       case ANYOF:
-	while (*scan != '\0' && cstrchr(opnd, *scan) != NULL)
+	while (*scan != '\0' && cstrchr(opnd, *scan, rex->rx_ic) != NULL)
 	{
 	    count++;
 	    scan++;
 	}
 	break;
       case ANYBUT:
-	while (*scan != '\0' && cstrchr(opnd, *scan) == NULL)
+	while (*scan != '\0' && cstrchr(opnd, *scan, rex->rx_ic) == NULL)
 	{
 	    count++;
 	    scan++;
@@ -2048,86 +2520,1161 @@ regrepeat(p)
 	count = 0;		/* Best compromise. */
 	break;
     }
-    reginput = scan;
+    rex->rx_input = scan;
 
     return count;
 }
 
 /*
- * regnext - dig the "next" pointer out of a node
+ * The NFA matcher.
+ *
+ * regmatch() tries one way to match after another and backs up when it
+ * fails.  For a pattern like "\(a\+\)\+b" on a line with many a's and no b
+ * that takes exponential time.  regnfa() instead walks through the text only
+ * once, keeping a list of all the places in the program where a match can
+ * be (the "threads").  Each node is only kept once for every position in the
+ * text, thus the time is linear in the length of the text.  Threads are kept
+ * in the order regmatch() would try them, the first one that gets to END
+ * wins.  This gives the same match and the same \( \) positions as
+ * regmatch().
+ *
+ * A back reference can't be done this way: what it matches depends on the
+ * path taken.  When a pattern contains a back reference regmatch() is always
+ * used.
+ *
+ * Threads only wait at nodes that take a character: EXACTLY (the number of
+ * characters matched so far is in th_count), a single character item, STAR,
+ * PLUS and BRACE_SIMPLE (th_count is the number of items matched) and END.
+ * The other nodes are passed through by regaddthread().  A complex \{} keeps
+ * its count in th_brace[], like rx_brace_count[] for regmatch().  An unlimited
+ * count is not remembered above the minimum, regmatch() stops after
+ * MAX_LIMIT items.
  */
-    static char_u *
-regnext(p)
-    char_u  *p;
+typedef struct
 {
-    int	    offset;
-
-    if (p == JUST_CALC_SIZE)
-	return NULL;
-
-    offset = NEXT(p);
-    if (offset == 0)
-	return NULL;
-
-    if (OP(p) == BACK)
-	return p - offset;
-    else
-	return p + offset;
-}
+    char_u	*th_scan;		/* node the thread waits at */
+    int		th_count;		/* see above */
+    int		th_brace[10];		/* counts for complex \{} */
+    char_u	*th_sub[2 * NSUBEXP];	/* \( and \) positions, [0] and [1] are
+					   for the whole match */
+} REGTHREAD;
 
-#ifdef DEBUG
+/*
+ * The nodes passed at one position in the text are remembered, to avoid
+ * adding the same thread twice.  "rw_visit_gen[]" is indexed by the offset of
+ * the node in the program, it is equal to "rw_visit_cur" when the node was
+ * passed.  For EXACTLY the count is added to the offset of the operand, for
+ * STAR and PLUS (where the count is zero or one) to the offset of the node.
+ * Where the count can be bigger, or complex \{} counts are kept, the
+ * entries in "rw_visit" are used: "rw_visit_head[]" is the index of the first
+ * entry for the node, further entries are linked with "rv_next".
+ */
+typedef struct
+{
+    int		rv_next;		/* next entry for this node or -1 */
+    int		rv_count;		/* th_count */
+    int		rv_brace[10];		/* th_brace[] */
+} REGVISIT;
+
+static int	regnfa_init __ARGS((REGEXEC *, vim_regexp *));
+static void	regnfa_nextpos __ARGS((REGEXEC *));
+static int	regnfa_visited __ARGS((REGEXEC *, char_u *, int, REGTHREAD *));
+static void	regaddthread __ARGS((REGEXEC *, char_u *, int, REGTHREAD *,
+								    char_u *));
+static int	regonechar __ARGS((REGEXEC *, char_u *, int));
+static void	regnfa_limits __ARGS((char_u *, int *, int *));
+static int	regnfa_count __ARGS((char_u *, int));
 
 /*
- * regdump - dump a regexp onto stdout in vaguely comprehensible form
+ * Start collecting threads for the next position in the text.
  */
     static void
-regdump(pattern, r)
-    char_u	*pattern;
-    vim_regexp	*r;
+regnfa_nextpos(rex)
+    REGEXEC	*rex;
 {
-    char_u  *s;
-    int	    op = EXACTLY;	/* Arbitrary non-END op. */
-    char_u  *next;
-
-    printf("\nregcomp(%s):\n", pattern);
+    struct regwork	*rw = rex->rx_work;
 
-    s = r->program + 1;
-    while (op != END) {		/* While that wasn't END last time... */
-	op = OP(s);
-	printf("%2d%s", (int)(s - r->program), regprop(s)); /* Where, what. */
-	next = regnext(s);
-	if (next == NULL)	/* Next ptr. */
-	    printf("(0)");
-	else
-	    printf("(%d)", (int)((s - r->program) + (next - s)));
-	if (op == BRACE_LIMITS)
-	{
-	    /* Two short ints */
-	    printf(" minval %d, maxval %d", OPERAND_MIN(s), OPERAND_MAX(s));
-	    s += 4;
-	}
-	s += 3;
-	if (op == ANYOF || op == ANYBUT || op == EXACTLY)
-	{
-	    /* Literal string, where present. */
-	    while (*s != '\0')
-	    {
-		putchar(*s);
-		s++;
-	    }
-	    s++;
-	}
-	putchar('\n');
+    if (++rw->rw_visit_cur <= 0)	/* wrapped around, clear old ones */
+    {
+	vim_memset(rw->rw_visit_gen, 0, sizeof(int) * rw->rw_visit_size);
+	rw->rw_visit_cur = 1;
     }
-
-    /* Header fields of interest. */
-    if (r->regstart != '\0')
-	printf("start `%c' ", r->regstart);
-    if (r->reganch)
-	printf("anchored ");
-    if (r->regmust != NULL)
-	printf("must have \"%s\"", r->regmust);
-    printf("\n");
+    rw->rw_visit.ga_room += rw->rw_visit.ga_len;
+    rw->rw_visit.ga_len = 0;
+}
+
+/*
+ * Check if node "scan" was already added at this position with the same
+ * counts.  If not, remember that it has been added now.
+ * Returns TRUE when it was visited before or when out of memory.
+ */
+    static int
+regnfa_visited(rex, scan, count, th)
+    REGEXEC	*rex;
+    char_u	*scan;
+    int		count;
+    REGTHREAD	*th;
+{
+    struct regwork	*rw = rex->rx_work;
+    long	off;
+    int		i;
+    REGVISIT	*rv;
+    int		nbrace = rw->rw_prog->regnbrace;
+
+    off = (long)(scan - rw->rw_prog->program);
+    if (nbrace == 0 && OP(scan) != BRACE_SIMPLE)
+    {
+	if (OP(scan) == EXACTLY)
+	    off += 3 + count;
+	else
+	    off += count;
+	if (rw->rw_visit_gen[off] == rw->rw_visit_cur)
+	    return TRUE;
+	rw->rw_visit_gen[off] = rw->rw_visit_cur;
+	return FALSE;
+    }
+
+    if (rw->rw_visit_gen[off] == rw->rw_visit_cur)
+    {
+	for (i = rw->rw_visit_head[off]; i >= 0; i = rv->rv_next)
+	{
+	    rv = ((REGVISIT *)rw->rw_visit.ga_data) + i;
+	    if (rv->rv_count == count && (nbrace == 0
+			|| memcmp(rv->rv_brace, th->th_brace,
+						sizeof(int) * nbrace) == 0))
+		return TRUE;
+	}
+    }
+    else
+    {
+	rw->rw_visit_gen[off] = rw->rw_visit_cur;
+	rw->rw_visit_head[off] = -1;
+    }
+
+    if (rw->rw_visit.ga_room == 0 && ga_grow(&rw->rw_visit, 1) == FAIL)
+    {
+	rw->rw_fail = TRUE;
+	return TRUE;
+    }
+    rv = ((REGVISIT *)rw->rw_visit.ga_data) + rw->rw_visit.ga_len;
+    rv->rv_next = rw->rw_visit_head[off];
+    rv->rv_count = count;
+    if (nbrace > 0)
+	vim_memmove(rv->rv_brace, th->th_brace, sizeof(int) * nbrace);
+    rw->rw_visit_head[off] = rw->rw_visit.ga_len;
+    ++rw->rw_visit.ga_len;
+    --rw->rw_visit.ga_room;
+    return FALSE;
+}
+
+/*
+ * Get the limits for a STAR, PLUS or BRACE_SIMPLE node.  For BRACE_SIMPLE
+ * they are in the BRACE_LIMITS node just before it.
+ */
+    static void
+regnfa_limits(scan, minval, maxval)
+    char_u	*scan;
+    int		*minval;
+    int		*maxval;
+{
+    if (OP(scan) == BRACE_SIMPLE)
+    {
+	*minval = OPERAND_MIN(scan - 7);
+	*maxval = OPERAND_MAX(scan - 7);
+    }
+    else
+    {
+	*minval = (OP(scan) == STAR) ? 0 : 1;
+	*maxval = MAX_LIMIT;
+    }
+}
+
+/*
+ * Return the count for STAR, PLUS or BRACE_SIMPLE node "scan" after one more
+ * item matched.  An unlimited count is not remembered above the minimum.
+ */
+    static int
+regnfa_count(scan, count)
+    char_u	*scan;
+    int		count;
+{
+    int		minval;
+    int		maxval;
+
+    regnfa_limits(scan, &minval, &maxval);
+    ++count;
+    if (minval <= maxval)
+    {
+	if (maxval == MAX_LIMIT && count > minval)
+	    count = minval;
+    }
+    else if (minval == MAX_LIMIT && count > maxval)
+	count = maxval;
+    return count;
+}
+
+/*
+ * Add a thread for node "scan" at text position "pos" to "rw_list".
+ * Nodes that don't take a character are followed right away, in the order
+ * that regmatch() would try them.  "th" holds the positions and counts, it
+ * is changed but restored before returning.
+ */
+    static void
+regaddthread(rex, scan, count, th, pos)
+    REGEXEC	*rex;
+    char_u	*scan;
+    int		count;
+    REGTHREAD	*th;
+    char_u	*pos;
+{
+    struct regwork	*rw = rex->rx_work;
+    char_u	*next;
+    char_u	*save;
+    int		no;
+    int		n;
+    int		save_count;
+    int		minval = -1;
+    int		maxval = -1;
+
+    while (scan != NULL && !rw->rw_fail)
+    {
+	if (regnfa_visited(rex, scan, count, th))
+	    return;
+	next = regnext(scan);
+	switch (OP(scan))
+	{
+	  case BOL:
+	    if (pos != rex->rx_bol)
+		return;
+	    break;
+	  case EOL:
+	    if (*pos != NUL)
+		return;
+	    break;
+	  case BOW:
+	    if (pos != rex->rx_bol && vim_iswordc(pos[-1]))
+		return;
+	    if (!pos[0] || !vim_iswordc(pos[0]))
+		return;
+	    break;
+	  case EOW:
+	    if (pos == rex->rx_bol || !vim_iswordc(pos[-1]))
+		return;
+	    if (pos[0] && vim_iswordc(pos[0]))
+		return;
+	    break;
+	  case NOTHING:
+	  case BACK:
+	    break;
+
+	  case MOPEN + 1:
+	  case MOPEN + 2:
+	  case MOPEN + 3:
+	  case MOPEN + 4:
+	  case MOPEN + 5:
+	  case MOPEN + 6:
+	  case MOPEN + 7:
+	  case MOPEN + 8:
+	  case MOPEN + 9:
+	    no = OP(scan) - MOPEN;
+	    save = th->th_sub[no * 2];
+	    th->th_sub[no * 2] = pos;
+	    regaddthread(rex, next, 0, th, pos);
+	    th->th_sub[no * 2] = save;
+	    return;
+
+	  case MCLOSE + 1:
+	  case MCLOSE + 2:
+	  case MCLOSE + 3:
+	  case MCLOSE + 4:
+	  case MCLOSE + 5:
+	  case MCLOSE + 6:
+	  case MCLOSE + 7:
+	  case MCLOSE + 8:
+	  case MCLOSE + 9:
+	    no = OP(scan) - MCLOSE;
+	    save = th->th_sub[no * 2 + 1];
+	    th->th_sub[no * 2 + 1] = pos;
+	    regaddthread(rex, next, 0, th, pos);
+	    th->th_sub[no * 2 + 1] = save;
+	    return;
+
+	  case BRANCH:
+	    if (OP(next) != BRANCH)	/* No choice. */
+	    {
+		next = OPERAND(scan);
+		break;
+	    }
+	    do
+	    {
+		regaddthread(rex, OPERAND(scan), 0, th, pos);
+		scan = regnext(scan);
+	    } while (scan != NULL && OP(scan) == BRANCH);
+	    return;
+
+	  case BRACE_LIMITS:
+	    if (OP(next) >= BRACE_COMPLEX && OP(next) < BRACE_COMPLEX + 10)
+	    {
+		no = OP(next) - BRACE_COMPLEX;
+		n = th->th_brace[no];
+		th->th_brace[no] = 0;
+		regaddthread(rex, next, 0, th, pos);
+		th->th_brace[no] = n;
+		return;
+	    }
+	    break;	/* BRACE_SIMPLE starts with a zero count */
+
+	  case BRACE_COMPLEX + 0:
+	  case BRACE_COMPLEX + 1:
+	  case BRACE_COMPLEX + 2:
+	  case BRACE_COMPLEX + 3:
+	  case BRACE_COMPLEX + 4:
+	  case BRACE_COMPLEX + 5:
+	  case BRACE_COMPLEX + 6:
+	  case BRACE_COMPLEX + 7:
+	  case BRACE_COMPLEX + 8:
+	  case BRACE_COMPLEX + 9:
+	    no = OP(scan) - BRACE_COMPLEX;
+	    minval = OPERAND_MIN(scan - 7);
+	    maxval = OPERAND_MAX(scan - 7);
+	    n = th->th_brace[no] + 1;
+	    save_count = th->th_brace[no];
+	    if (minval <= maxval)
+	    {
+		/* Range is the normal way around, use longest match */
+		if (maxval == MAX_LIMIT && n > minval + 1)
+		    n = minval + 1;
+		if (n <= maxval)
+		{
+		    th->th_brace[no] = n;
+		    regaddthread(rex, OPERAND(scan), 0, th, pos);
+		}
+		if (n > minval)
+		{
+		    th->th_brace[no] = 0;
+		    regaddthread(rex, next, 0, th, pos);
+		}
+	    }
+	    else
+	    {
+		/* Range is backwards, use shortest match first */
+		if (minval == MAX_LIMIT && n > maxval + 1)
+		    n = maxval + 1;
+		if (n > maxval)
+		{
+		    th->th_brace[no] = 0;
+		    regaddthread(rex, next, 0, th, pos);
+		}
+		if (n <= minval)
+		{
+		    th->th_brace[no] = n;
+		    regaddthread(rex, OPERAND(scan), 0, th, pos);
+		}
+	    }
+	    th->th_brace[no] = save_count;
+	    return;
+
+	  case BRACE_SIMPLE:
+	  case STAR:
+	  case PLUS:
+	    regnfa_limits(scan, &minval, &maxval);
+	    if (minval <= maxval)
+	    {
+		/* Range is the normal way around, use longest match */
+		if (count < maxval)
+		    goto addit;
+		if (count < minval)
+		    return;
+	    }
+	    else
+	    {
+		/* Range is backwards, use shortest match first */
+		if (count >= maxval)
+		    regaddthread(rex, next, 0, th, pos);
+		if (count < minval)
+		    goto addit;
+		return;
+	    }
+	    break;
+
+	  case END:
+	  case ANY:
+	  case IDENT:
+	  case WORD:
+	  case FNAME:
+	  case PRINT:
+	  case SIDENT:
+	  case SWORD:
+	  case SFNAME:
+	  case SPRINT:
+	  case WHITE:
+	  case NWHITE:
+	  case EXACTLY:
+	  case ANYOF:
+	  case ANYBUT:
+addit:
+	    if (rw->rw_list->ga_room == 0 && ga_grow(rw->rw_list, 1) == FAIL)
+	    {
+		rw->rw_fail = TRUE;
+		return;
+	    }
+	    th->th_scan = scan;
+	    th->th_count = count;
+	    vim_memmove(((REGTHREAD *)rw->rw_list->ga_data)
+			       + rw->rw_list->ga_len, th, rw->rw_thread_size);
+	    ++rw->rw_list->ga_len;
+	    --rw->rw_list->ga_room;
+
+	    /* A greedy STAR, PLUS or BRACE_SIMPLE may also stop here, with
+	     * lower priority. */
+	    if (OP(scan) == STAR || OP(scan) == PLUS || OP(scan) == BRACE_SIMPLE)
+	    {
+		if (count >= minval)
+		    break;
+	    }
+	    return;
+
+	  default:
+	    emsg(e_re_corr);
+	    rw->rw_fail = TRUE;
+	    return;
+	}
+	scan = next;
+	count = 0;
+    }
+}
+
+/*
+ * Return TRUE if single character node "p" matches character "c".
+ * For EXACTLY only the first character is checked, the way regrepeat() does.
+ */
+    static int
+regonechar(rex, p, c)
+    REGEXEC	*rex;
+    char_u	*p;
+    int		c;
+{
+    if (c == NUL)
+	return FALSE;
+    switch (OP(p))
+    {
+      case ANY:	    return TRUE;
+      case IDENT:   return vim_isIDc(c);
+      case WORD:    return vim_iswordc(c);
+      case FNAME:   return vim_isfilec(c);
+      case PRINT:   return charsize(c) == 1;
+      case SIDENT:  return !isdigit(c) && vim_isIDc(c);
+      case SWORD:   return !isdigit(c) && vim_iswordc(c);
+      case SFNAME:  return !isdigit(c) && vim_isfilec(c);
+      case SPRINT:  return !isdigit(c) && charsize(c) == 1;
+      case WHITE:   return vim_iswhite(c);
+      case NWHITE:  return !vim_iswhite(c);
+      case EXACTLY: return *OPERAND(p) == c || (rex->rx_ic
+			    && (TO_UPPER(*OPERAND(p)) == c
+					     || TO_LOWER(*OPERAND(p)) == c));
+      case ANYOF:   return cstrchr(OPERAND(p), c, rex->rx_ic) != NULL;
+      case ANYBUT:  return cstrchr(OPERAND(p), c, rex->rx_ic) == NULL;
+    }
+    return FALSE;
+}
+
+/*
+ * Prepare the work arrays of "rex" for executing "prog" with regaddthread().
+ * Returns FAIL when out of memory.
+ */
+    static int
+regnfa_init(rex, prog)
+    REGEXEC	*rex;
+    vim_regexp	*prog;
+{
+    struct regwork	*rw = rex->rx_work;
+    REGTHREAD	th;
+    int		i;
+
+    if (rw == NULL)
+    {
+	rw = (struct regwork *)alloc_clear((unsigned)sizeof(struct regwork));
+	if (rw == NULL)
+	    return FAIL;
+	ga_init(&rw->rw_visit);
+	rw->rw_visit.ga_itemsize = sizeof(REGVISIT);
+	rw->rw_visit.ga_growsize = 100;
+	for (i = 0; i < 2; ++i)
+	{
+	    ga_init(&rw->rw_threads[i]);
+	    rw->rw_threads[i].ga_itemsize = sizeof(REGTHREAD);
+	    rw->rw_threads[i].ga_growsize = 100;
+	}
+	ga_init(&rw->rw_items);
+	rw->rw_items.ga_itemsize = sizeof(int);
+	rw->rw_items.ga_growsize = 100;
+	rex->rx_work = rw;
+    }
+
+    /* Make sure there is room to mark every node of the program. */
+    if (prog->regsize > rw->rw_visit_size)
+    {
+	vim_free(rw->rw_visit_gen);
+	vim_free(rw->rw_visit_head);
+	rw->rw_visit_gen = (int *)lalloc_clear(
+			       (long_u)(sizeof(int) * prog->regsize), TRUE);
+	rw->rw_visit_head = (int *)lalloc(
+			       (long_u)(sizeof(int) * prog->regsize), TRUE);
+	if (rw->rw_visit_gen == NULL || rw->rw_visit_head == NULL)
+	{
+	    vim_free(rw->rw_visit_gen);
+	    vim_free(rw->rw_visit_head);
+	    rw->rw_visit_gen = rw->rw_visit_head = NULL;
+	    rw->rw_visit_size = 0;
+	    return FAIL;
+	}
+	rw->rw_visit_size = prog->regsize;
+	rw->rw_visit_cur = 0;
+    }
+    rw->rw_prog = prog;
+    /* Only the part of a REGTHREAD for the \( \) in the pattern is copied. */
+    rw->rw_thread_size = (int)((char *)&th.th_sub[2 * prog->regnsub]
+							      - (char *)&th);
+    rw->rw_fail = FALSE;
+    return OK;
+}
+
+/*
+ * regnfa - find the first match of "prog" in "string" with the NFA matcher.
+ * Used instead of the loop over regtry() in vim_regexec().
+ * Return 1 for a match, 0 otherwise.
+ */
+    static int
+regnfa(rex, prog, string)
+    REGEXEC	*rex;
+    vim_regexp	*prog;
+    char_u	*string;
+{
+    struct regwork	*rw;
+    REGTHREAD		th;
+    REGTHREAD		*t;
+    struct growarray	*clist;
+    struct growarray	*nlist;
+    struct growarray	*tmp;
+    char_u		*pos;
+    char_u		*opnd;
+    int			c;
+    int			i;
+    int			n;
+    int			matched = FALSE;
+
+    if (regnfa_init(rex, prog) == FAIL)
+	return 0;
+    rw = rex->rx_work;
+    clist = &rw->rw_threads[0];
+    nlist = &rw->rw_threads[1];
+    clist->ga_room += clist->ga_len;
+    clist->ga_len = 0;
+
+    pos = string;
+    regnfa_nextpos(rex);
+    for (;;)
+    {
+	/*
+	 * Start a thread at "pos", with the lowest priority, unless a match was
+	 * already found.
+	 */
+	if (!matched && (pos == string || !prog->reganch)
+		&& (prog->regstart == NUL || prog->regstart == *pos
+		    || (rex->rx_ic
+			     && TO_LOWER(prog->regstart) == TO_LOWER(*pos))))
+	{
+	    vim_memset(&th, 0, rw->rw_thread_size);
+	    th.th_sub[0] = pos;
+	    rw->rw_list = clist;
+	    regaddthread(rex, prog->program + 1, 0, &th, pos);
+	}
+	if (rw->rw_fail)
+	    break;
+
+	if (clist->ga_len == 0)
+	{
+	    /* No thread left, skip ahead to where a match may start. */
+	    if (matched || prog->reganch || *pos == NUL)
+		break;
+	    if (prog->regstart != NUL)
+	    {
+		pos = cstrchr(pos + 1, prog->regstart, rex->rx_ic);
+		if (pos == NULL)
+		    break;
+	    }
+	    else
+		++pos;
+	    regnfa_nextpos(rex);
+	    continue;
+	}
+
+	/*
+	 * Move each thread over the character at "pos", in order of priority.
+	 */
+	c = *pos;
+	nlist->ga_room += nlist->ga_len;
+	nlist->ga_len = 0;
+	rw->rw_list = nlist;
+	regnfa_nextpos(rex);
+	for (i = 0; i < clist->ga_len && !rw->rw_fail; ++i)
+	{
+	    t = ((REGTHREAD *)clist->ga_data) + i;
+	    switch (OP(t->th_scan))
+	    {
+	      case END:
+		/* A match, threads after this one have a lower priority. */
+		matched = TRUE;
+		for (n = 0; n < prog->regnsub; ++n)
+		{
+		    rex->rx_startp[n] = t->th_sub[n * 2];
+		    rex->rx_endp[n] = t->th_sub[n * 2 + 1];
+		}
+		rex->rx_endp[0] = pos;
+		i = clist->ga_len;
+		break;
+
+	      case EXACTLY:
+		opnd = OPERAND(t->th_scan) + t->th_count;
+		if (c == NUL || (*opnd != c
+			  && (!rex->rx_ic || TO_LOWER(*opnd) != TO_LOWER(c))))
+		    break;
+		vim_memmove(&th, t, rw->rw_thread_size);
+		if (opnd[1] == NUL)
+		    regaddthread(rex, regnext(t->th_scan), 0, &th, pos + 1);
+		else
+		    regaddthread(rex, t->th_scan, t->th_count + 1, &th,
+								      pos + 1);
+		break;
+
+	      case BRACE_SIMPLE:
+	      case STAR:
+	      case PLUS:
+		if (!regonechar(rex, OPERAND(t->th_scan), c))
+		    break;
+		vim_memmove(&th, t, rw->rw_thread_size);
+		regaddthread(rex, t->th_scan,
+			 regnfa_count(t->th_scan, t->th_count), &th, pos + 1);
+		break;
+
+	      default:
+		if (!regonechar(rex, t->th_scan, c))
+		    break;
+		vim_memmove(&th, t, rw->rw_thread_size);
+		regaddthread(rex, regnext(t->th_scan), 0, &th, pos + 1);
+		break;
+	    }
+	}
+	if (c == NUL || rw->rw_fail)
+	    break;
+
+	tmp = clist;
+	clist = nlist;
+	nlist = tmp;
+	++pos;
+    }
+
+    if (rw->rw_fail || !matched)
+	return 0;
+    /* Clear the subexpressions that are not used. */
+    for (i = prog->regnsub; i < NSUBEXP; ++i)
+	rex->rx_startp[i] = rex->rx_endp[i] = NULL;
+    return 1;
+}
+
+/*
+ * The DFA cache.
+ *
+ * Most lines that a pattern is tried on don't match, think of ":g", 'hlsearch'
+ * and syntax items.  For a pattern without \( \) that is found out faster by
+ * turning the sets of threads that regnfa() would have into the states of a
+ * DFA, while matching.  A state has the next state for every character, it
+ * is filled in when the character is first seen in that state.  After that a
+ * character takes one table lookup, the program isn't looked at.  The states
+ * are kept with the program, thus they are used again for the next line.
+ *
+ * The DFA only tells whether there is a match.  When there is one, regnfa()
+ * is used to find out where it is.
+ *
+ * A state holds the nodes and counts where threads wait, before following
+ * nodes that don't take a character, because for EOL, BOW and EOW that
+ * depends on the next character.  It also remembers whether it is at the
+ * start of the line and whether the character before it is a word character.
+ *
+ * There are at most REGDFA_MAXSTATES states.  When more are needed all
+ * states are thrown away.  When that happens twice for one line regnfa() is
+ * used instead.  When it happens for REGDFA_MAXFAIL lines the DFA isn't
+ * worth it and is no longer used for the program.
+ */
+#define REGDFA_MAXSTATES 100
+#define REGDFA_MAXFAIL	3
+
+/* Values in ds_trans[] below REGDFA_FIRST, others are a state number plus
+ * REGDFA_FIRST. */
+#define REGDFA_UNKNOWN	0	/* not computed yet */
+#define REGDFA_MATCH	1	/* there is a match */
+#define REGDFA_DEAD	2	/* there is no match */
+#define REGDFA_FIRST	3
+
+/* Values for ds_flags */
+#define DS_BOL		1	/* at start of line */
+#define DS_WORD		2	/* after a word character */
+
+typedef struct
+{
+    short	ds_trans[256];	/* next state for each character */
+    int		*ds_items;	/* node offset and count for each thread */
+    int		ds_nitems;	/* number of threads */
+    int		ds_flags;	/* DS_BOL and DS_WORD */
+    int		ds_prevc;	/* character before, for BOW and EOW */
+    unsigned	ds_hash;	/* hash of ds_items[] and ds_flags */
+} REGDSTATE;
+
+struct regdfa
+{
+    struct growarray rd_states;	/* REGDSTATE items */
+    int		rd_start[3];	/* start state at start of line, after a
+				   non-word and after a word character */
+    int		rd_bow;		/* program contains BOW or EOW */
+    int		rd_ic;		/* rx_ic used for the states */
+    BUF		*rd_buf;	/* curbuf used for the states */
+    int		rd_tick;	/* chartab_tick used for the states */
+    int		rd_fail;	/* number of lines that needed too many
+				   states */
+};
+
+static int	regdfa_additem __ARGS((REGEXEC *, int, int));
+static int	regdfa_state __ARGS((REGEXEC *, struct regdfa *, int, int));
+static int	regdfa_step __ARGS((REGEXEC *, vim_regexp *, struct regdfa *,
+								 int, int));
+static int	regdfa_scan __ARGS((REGEXEC *, vim_regexp *, struct regdfa *,
+								    char_u *));
+
+/*
+ * Throw away all the states of "dfa".
+ */
+    static void
+regdfa_clear(dfa)
+    struct regdfa	*dfa;
+{
+    int		i;
+
+    for (i = 0; i < dfa->rd_states.ga_len; ++i)
+	vim_free(((REGDSTATE *)dfa->rd_states.ga_data)[i].ds_items);
+    ga_clear(&dfa->rd_states);
+    for (i = 0; i < 3; ++i)
+	dfa->rd_start[i] = REGDFA_UNKNOWN;
+}
+
+/*
+ * Add node offset "off" with count "count" to "rw_items".
+ */
+    static int
+regdfa_additem(rex, off, count)
+    REGEXEC	*rex;
+    int		off;
+    int		count;
+{
+    struct regwork	*rw = rex->rx_work;
+    int		*p;
+
+    if (ga_grow(&rw->rw_items, 2) == FAIL)
+	return FAIL;
+    p = ((int *)rw->rw_items.ga_data) + rw->rw_items.ga_len;
+    p[0] = off;
+    p[1] = count;
+    rw->rw_items.ga_len += 2;
+    rw->rw_items.ga_room -= 2;
+    return OK;
+}
+
+/*
+ * Find the state for the items in "rw_items" and "flags", add it when
+ * there is none yet.  "prevc" is the character before the state.
+ * Returns the value for ds_trans[], -1 when out of memory.
+ */
+    static int
+regdfa_state(rex, dfa, flags, prevc)
+    REGEXEC		*rex;
+    struct regdfa	*dfa;
+    int			flags;
+    int			prevc;
+{
+    struct regwork	*rw = rex->rx_work;
+    int		*items = (int *)rw->rw_items.ga_data;
+    int		n = rw->rw_items.ga_len / 2;
+    int		i;
+    int		j;
+    int		off;
+    int		count;
+    unsigned	hash;
+    REGDSTATE	*ds;
+
+    if (n == 0)
+	return REGDFA_DEAD;
+
+    /* Sort the items and remove duplicates, the order of threads doesn't
+     * matter for finding out if there is a match. */
+    for (i = 1; i < n; ++i)
+    {
+	off = items[i * 2];
+	count = items[i * 2 + 1];
+	for (j = i; j > 0 && (items[j * 2 - 2] > off
+		       || (items[j * 2 - 2] == off && items[j * 2 - 1] > count));
+									 --j)
+	{
+	    items[j * 2] = items[j * 2 - 2];
+	    items[j * 2 + 1] = items[j * 2 - 1];
+	}
+	items[j * 2] = off;
+	items[j * 2 + 1] = count;
+    }
+    for (i = j = 1; i < n; ++i)
+	if (items[i * 2] != items[j * 2 - 2]
+				       || items[i * 2 + 1] != items[j * 2 - 1])
+	{
+	    items[j * 2] = items[i * 2];
+	    items[j * 2 + 1] = items[i * 2 + 1];
+	    ++j;
+	}
+    n = j;
+
+    hash = flags;
+    for (i = 0; i < n * 2; ++i)
+	hash = hash * 31 + items[i];
+
+    for (i = 0; i < dfa->rd_states.ga_len; ++i)
+    {
+	ds = ((REGDSTATE *)dfa->rd_states.ga_data) + i;
+	if (ds->ds_hash == hash && ds->ds_flags == flags
+		&& ds->ds_nitems == n
+		&& memcmp(ds->ds_items, items, sizeof(int) * 2 * n) == 0)
+	    return i + REGDFA_FIRST;
+    }
+
+    if (dfa->rd_states.ga_len >= REGDFA_MAXSTATES)
+    {
+	regdfa_clear(dfa);
+	++rw->rw_cleared;
+    }
+    if (ga_grow(&dfa->rd_states, 1) == FAIL)
+	return -1;
+    ds = ((REGDSTATE *)dfa->rd_states.ga_data) + dfa->rd_states.ga_len;
+    ds->ds_items = (int *)lalloc((long_u)(sizeof(int) * 2 * n), TRUE);
+    if (ds->ds_items == NULL)
+	return -1;
+    vim_memmove(ds->ds_items, items, sizeof(int) * 2 * n);
+    vim_memset(ds->ds_trans, 0, sizeof(ds->ds_trans));
+    ds->ds_nitems = n;
+    ds->ds_flags = flags;
+    ds->ds_prevc = prevc;
+    ds->ds_hash = hash;
+    ++dfa->rd_states.ga_len;
+    --dfa->rd_states.ga_room;
+    return dfa->rd_states.ga_len - 1 + REGDFA_FIRST;
+}
+
+/*
+ * Compute where state number "si" goes with character "c", NUL for the end
+ * of the line.  Stores and returns the value for ds_trans[c], -1 when out of
+ * memory.
+ */
+    static int
+regdfa_step(rex, prog, dfa, si, c)
+    REGEXEC		*rex;
+    vim_regexp		*prog;
+    struct regdfa	*dfa;
+    int			si;
+    int			c;
+{
+    struct regwork	*rw = rex->rx_work;
+    REGDSTATE	*ds;
+    REGTHREAD	th;
+    REGTHREAD	*t;
+    char_u	line[3];
+    char_u	*save_regbol;
+    char_u	*scan;
+    char_u	*opnd;
+    int		i;
+    int		n;
+    int		ret = REGDFA_DEAD;
+    int		cleared = rw->rw_cleared;
+
+    /*
+     * Follow the nodes that don't take a character.  That is done on a short
+     * line with the character before, "c" and a NUL, which is all that BOL,
+     * EOL, BOW and EOW look at.
+     */
+    ds = ((REGDSTATE *)dfa->rd_states.ga_data) + si;
+    line[0] = ds->ds_prevc;
+    line[1] = c;
+    line[2] = NUL;
+    save_regbol = rex->rx_bol;
+    rex->rx_bol = (ds->ds_flags & DS_BOL) ? line + 1 : NULL;
+    rw->rw_list = &rw->rw_threads[0];
+    rw->rw_list->ga_room += rw->rw_list->ga_len;
+    rw->rw_list->ga_len = 0;
+    regnfa_nextpos(rex);
+    vim_memset(&th, 0, rw->rw_thread_size);
+    for (i = 0; i < ds->ds_nitems; ++i)
+	regaddthread(rex, prog->program + ds->ds_items[i * 2],
+				      ds->ds_items[i * 2 + 1], &th, line + 1);
+    rex->rx_bol = save_regbol;
+    if (rw->rw_fail)
+	return -1;
+
+    /*
+     * Move the threads over "c", like regnfa() does.
+     */
+    rw->rw_items.ga_room += rw->rw_items.ga_len;
+    rw->rw_items.ga_len = 0;
+    for (i = 0; i < rw->rw_list->ga_len; ++i)
+    {
+	t = ((REGTHREAD *)rw->rw_list->ga_data) + i;
+	scan = t->th_scan;
+	n = 0;
+	switch (OP(scan))
+	{
+	  case END:
+	    ret = REGDFA_MATCH;
+	    break;
+
+	  case EXACTLY:
+	    opnd = OPERAND(scan) + t->th_count;
+	    if (c == NUL || (*opnd != c
+			  && (!rex->rx_ic || TO_LOWER(*opnd) != TO_LOWER(c))))
+		continue;
+	    if (opnd[1] == NUL)
+		scan = regnext(scan);
+	    else
+		n = t->th_count + 1;
+	    break;
+
+	  case BRACE_SIMPLE:
+	  case STAR:
+	  case PLUS:
+	    if (!regonechar(rex, OPERAND(scan), c))
+		continue;
+	    n = regnfa_count(scan, t->th_count);
+	    break;
+
+	  default:
+	    if (!regonechar(rex, scan, c))
+		continue;
+	    scan = regnext(scan);
+	    break;
+	}
+	if (ret == REGDFA_MATCH)
+	    break;
+	if (regdfa_additem(rex, (int)(scan - prog->program), n) == FAIL)
+	    return -1;
+    }
+
+    if (ret != REGDFA_MATCH && c != NUL)
+    {
+	/* A match may also start at the next character. */
+	if (!prog->reganch && regdfa_additem(rex, 1, 0) == FAIL)
+	    return -1;
+	ret = regdfa_state(rex, dfa,
+		      (dfa->rd_bow && vim_iswordc(c)) ? DS_WORD : 0, c);
+	if (ret < 0)
+	    return -1;
+    }
+
+    /* When the states were cleared state "si" is gone. */
+    if (cleared == rw->rw_cleared)
+	((REGDSTATE *)dfa->rd_states.ga_data)[si].ds_trans[c] = ret;
+    return ret;
+}
+
+/*
+ * regdfa - find out if "prog" matches "string" with the DFA cache.
+ * Can only be used when "prog" has no \( \), no back references and no
+ * complex \{}.
+ * Returns 1 for a match, 0 for no match and -1 when regnfa() has to be used.
+ */
+    static int
+regdfa(rex, prog, string)
+    REGEXEC	*rex;
+    vim_regexp	*prog;
+    char_u	*string;
+{
+    struct regwork	*rw;
+    struct regdfa	*dfa = prog->regdfa;
+    char_u		*s;
+    int			op = EXACTLY;
+    int			t;
+
+    if (dfa == NULL)
+    {
+	dfa = (struct regdfa *)alloc_clear((unsigned)sizeof(struct regdfa));
+	if (dfa == NULL)
+	    return -1;
+	ga_init(&dfa->rd_states);
+	dfa->rd_states.ga_itemsize = sizeof(REGDSTATE);
+	dfa->rd_states.ga_growsize = 10;
+	regdfa_clear(dfa);
+
+	/* Check for BOW and EOW, see regdump() for walking the nodes. */
+	for (s = prog->program + 1; op != END; s += 3)
+	{
+	    op = OP(s);
+	    if (op == BOW || op == EOW)
+		dfa->rd_bow = TRUE;
+	    else if (op == BRACE_LIMITS)
+		s += 4;
+	    else if (op == ANYOF || op == ANYBUT || op == EXACTLY)
+		s += STRLEN(OPERAND(s)) + 1;
+	}
+	prog->regdfa = dfa;
+    }
+    else if (dfa->rd_fail >= REGDFA_MAXFAIL)
+	return -1;
+    /* The states depend on 'ignorecase' and the character classes. */
+    else if (dfa->rd_ic != rex->rx_ic || dfa->rd_buf != curbuf
+					      || dfa->rd_tick != chartab_tick)
+	regdfa_clear(dfa);
+    dfa->rd_ic = rex->rx_ic;
+    dfa->rd_buf = curbuf;
+    dfa->rd_tick = chartab_tick;
+
+    if (regnfa_init(rex, prog) == FAIL)
+	return -1;
+    rw = rex->rx_work;
+    rw->rw_cleared = 0;
+    t = regdfa_scan(rex, prog, dfa, string);
+    if (rw->rw_cleared > 0)
+	++dfa->rd_fail;
+    return t;
+}
+
+/*
+ * Run the DFA of "prog" over "string", for regdfa().
+ */
+    static int
+regdfa_scan(rex, prog, dfa, string)
+    REGEXEC		*rex;
+    vim_regexp		*prog;
+    struct regdfa	*dfa;
+    char_u		*string;
+{
+    struct regwork	*rw = rex->rx_work;
+    char_u	*p;
+    int		i;
+    int		t;
+
+    /* Find the start state. */
+    if (rex->rx_bol != NULL)
+	i = 0;
+    else if (dfa->rd_bow && vim_iswordc(string[-1]))
+	i = 2;
+    else
+	i = 1;
+    t = dfa->rd_start[i];
+    if (t == REGDFA_UNKNOWN)
+    {
+	rw->rw_items.ga_room += rw->rw_items.ga_len;
+	rw->rw_items.ga_len = 0;
+	if (regdfa_additem(rex, 1, 0) == FAIL)
+	    return -1;
+	t = regdfa_state(rex, dfa, i == 0 ? DS_BOL : i == 2 ? DS_WORD : 0,
+				     (i == 0 || !dfa->rd_bow) ? NUL : string[-1]);
+	if (t < 0)
+	    return -1;
+	dfa->rd_start[i] = t;
+    }
+
+    for (p = string; ; ++p)
+    {
+	i = t - REGDFA_FIRST;
+	t = ((REGDSTATE *)dfa->rd_states.ga_data)[i].ds_trans[*p];
+	if (t == REGDFA_UNKNOWN)
+	{
+	    t = regdfa_step(rex, prog, dfa, i, *p);
+	    if (t < 0 || rw->rw_cleared > 1)
+		return -1;
+	}
+	if (t < REGDFA_FIRST)
+	    return t == REGDFA_MATCH;
+    }
+}
+
+/*
+ * regnext - dig the "next" pointer out of a node
+ */
+    static char_u *
+regnext(p)
+    char_u  *p;
+{
+    int	    offset;
+
+    if (p == JUST_CALC_SIZE)
+	return NULL;
+
+    offset = NEXT(p);
+    if (offset == 0)
+	return NULL;
+
+    if (OP(p) == BACK)
+	return p - offset;
+    else
+	return p + offset;
+}
+
+#ifdef DEBUG
+
+/*
+ * regdump - dump a regexp onto stdout in vaguely comprehensible form
+ */
+    static void
+regdump(pattern, r)
+    char_u	*pattern;
+    vim_regexp	*r;
+{
+    char_u  *s;
+    int	    op = EXACTLY;	/* Arbitrary non-END op. */
+    char_u  *next;
+    int	    n;
+
+    printf("\nregcomp(%s):\n", pattern);
+
+    s = r->program + 1;
+    while (op != END) {		/* While that wasn't END last time... */
+	op = OP(s);
+	printf("%2d%s", (int)(s - r->program), regprop(s)); /* Where, what. */
+	next = regnext(s);
+	if (next == NULL)	/* Next ptr. */
+	    printf("(0)");
+	else
+	    printf("(%d)", (int)((s - r->program) + (next - s)));
+	if (op == BRACE_LIMITS)
+	{
+	    /* Two short ints */
+	    printf(" minval %d, maxval %d", OPERAND_MIN(s), OPERAND_MAX(s));
+	    s += 4;
+	}
+	s += 3;
+	if (op == ANYOF || op == ANYBUT || op == EXACTLY)
+	{
+	    /* Literal string, where present. */
+	    while (*s != '\0')
+	    {
+		putchar(*s);
+		s++;
+	    }
+	    s++;
+	}
+	putchar('\n');
+    }
+
+    /* Header fields of interest. */
+    if (r->regstart != '\0')
+	printf("start `%c' ", r->regstart);
+    if (r->reganch)
+	printf("anchored ");
+    for (n = 0; n < r->regnmust; ++n)
+	printf("must have \"%s\" ", r->regmust[n]);
+    printf("\n");
 }
 
 /*
@@ -2283,31 +3830,284 @@ regprop(op)
 #endif
 
 /*
- * Compare two strings, ignore case if reg_ic set.
+ * Compare two strings, ignore case if "ic" set.
  * Return 0 if strings match, non-zero otherwise.
  */
     static int
-cstrncmp(s1, s2, n)
+cstrncmp(s1, s2, n, ic)
     char_u	*s1, *s2;
     int		n;
+    int		ic;
 {
-    if (!reg_ic)
+    if (!ic)
 	return STRNCMP(s1, s2, n);
     return STRNICMP(s1, s2, n);
 }
 
+/*
+ * Check if the strings that "prog" must include appear in the text from "s"
+ * to "end".  The text may contain several lines, separated with NULs.
+ * Ignores case like context "rex" does.
+ * Returns FALSE when there can't be a match in the text.
+ */
+    int
+vim_regmust_found(rex, prog, s, end)
+    REGEXEC	*rex;
+    vim_regexp	*prog;
+    char_u	*s;
+    char_u	*end;
+{
+    return regmust_found(prog, s, end, rex->rx_ic);
+}
+
+/*
+ * Like vim_regmust_found(), ignore case if "ic" set.
+ */
+    static int
+regmust_found(prog, s, end, ic)
+    vim_regexp	*prog;
+    char_u	*s;
+    char_u	*end;
+    int		ic;
+{
+    int		i;
+    int		found;
+
+    for (i = 0; i < prog->regnmust; ++i)
+    {
+	found = (cstrstr(s, end, prog->regmust[i], prog->regmlen[i], ic)
+								     != NULL);
+	if (found == prog->regmustany)
+	    return found;
+    }
+    return !prog->regmustany;
+}
+
+/*
+ * Find the characters that a match of "prog" can start with.  "set[c]" is
+ * made non-zero for each character "c" that can be the first one, ignoring
+ * case if "ic" set.  "set" must have room for 256 entries.
+ * Returns FAIL when the match may be empty or start with any character, and
+ * when it's too complicated to find out.
+ */
+    int
+vim_regfirst(prog, set, ic)
+    vim_regexp	*prog;
+    char_u	*set;
+    int		ic;
+{
+    REGEXEC	rex;
+
+    vim_memset(set, 0, 256);
+    if (prog->regbackref)
+	return FAIL;
+    rex.rx_ic = ic;
+    if (regfirst(&rex, prog->program + 1, set, 0))
+	return FAIL;
+    return OK;
+}
+
+/*
+ * Add the characters that can be matched first from node "scan" on to
+ * "set[]".  Nodes that don't take a character are skipped, for a BRANCH each
+ * alternative is followed.  "depth" avoids looping on an empty "\(\)*".
+ * Returns TRUE when no character may be needed, or when unknown.
+ */
+    static int
+regfirst(rex, scan, set, depth)
+    REGEXEC	*rex;
+    char_u	*scan;
+    char_u	*set;
+    int		depth;
+{
+    char_u	*next;
+    int		minval;
+    int		maxval;
+    int		c;
+
+    if (depth > 10)
+	return TRUE;
+    while (scan != NULL)
+    {
+	next = regnext(scan);
+	switch (OP(scan))
+	{
+	  case BOL:
+	  case EOL:
+	  case BOW:
+	  case EOW:
+	  case NOTHING:
+	  case BACK:
+	  case BRACE_LIMITS:
+	    break;
+
+	  case MOPEN + 1:
+	  case MOPEN + 2:
+	  case MOPEN + 3:
+	  case MOPEN + 4:
+	  case MOPEN + 5:
+	  case MOPEN + 6:
+	  case MOPEN + 7:
+	  case MOPEN + 8:
+	  case MOPEN + 9:
+	  case MCLOSE + 1:
+	  case MCLOSE + 2:
+	  case MCLOSE + 3:
+	  case MCLOSE + 4:
+	  case MCLOSE + 5:
+	  case MCLOSE + 6:
+	  case MCLOSE + 7:
+	  case MCLOSE + 8:
+	  case MCLOSE + 9:
+	    break;
+
+	  case BRANCH:
+	    if (OP(next) != BRANCH)	/* No choice. */
+	    {
+		next = OPERAND(scan);
+		break;
+	    }
+	    do
+	    {
+		if (regfirst(rex, OPERAND(scan), set, depth + 1))
+		    return TRUE;
+		scan = regnext(scan);
+	    } while (scan != NULL && OP(scan) == BRANCH);
+	    return FALSE;
+
+	  case BRACE_SIMPLE:
+	  case STAR:
+	  case PLUS:
+	    for (c = 1; c < 256; ++c)
+		if (regonechar(rex, OPERAND(scan), c))
+		    set[c] = TRUE;
+	    if (OP(scan) == BRACE_SIMPLE)
+	    {
+		minval = OPERAND_MIN(scan - 7);
+		maxval = OPERAND_MAX(scan - 7);
+		if (minval > 0 && maxval > 0)
+		    return FALSE;
+	    }
+	    else if (OP(scan) == PLUS)
+		return FALSE;
+	    break;
+
+	  case ANY:
+	  case IDENT:
+	  case WORD:
+	  case FNAME:
+	  case PRINT:
+	  case SIDENT:
+	  case SWORD:
+	  case SFNAME:
+	  case SPRINT:
+	  case WHITE:
+	  case NWHITE:
+	  case EXACTLY:
+	  case ANYOF:
+	  case ANYBUT:
+	    for (c = 1; c < 256; ++c)
+		if (regonechar(rex, scan, c))
+		    set[c] = TRUE;
+	    return FALSE;
+
+	  default:	/* END, BACKREF, complex \{} */
+	    return TRUE;
+	}
+	scan = next;
+    }
+    return TRUE;
+}
+
+/*
+ * Find "str" with length "len" in "s", which ends at "end".  Ignore case if
+ * "ic" set.  The first character of "str" is looked for with cstrskip(), for
+ * the rest cstrncmp() is used.
+ */
+    static char_u *
+cstrstr(s, end, str, len, ic)
+    char_u	*s;
+    char_u	*end;
+    char_u	*str;
+    int		len;
+    int		ic;
+{
+    int		c = *str;
+    int		cc = c;
+
+    if (ic)
+    {
+	if (isupper(c))
+	    cc = TO_LOWER(c);
+	else if (islower(c))
+	    cc = TO_UPPER(c);
+    }
+    end -= len - 1;		/* last place where "str" can start, plus one */
+    for (;;)
+    {
+	s = cstrskip(s, end, c, cc);
+	if (s >= end)
+	    return NULL;
+	if (len == 1 || cstrncmp(s + 1, str + 1, len - 1, ic) == 0)
+	    return s;
+	++s;
+    }
+}
+
+/*
+ * Return a pointer to the first "c" or "cc" at or after "s" and before "end",
+ * or "end" when there is none.  Like skip_text() in fileio.c a long is checked
+ * at once, after XOR-ing it with the characters looked for.
+ */
+    static char_u *
+cstrskip(s, end, c, cc)
+    char_u	*s;
+    char_u	*end;
+    int		c;
+    int		cc;
+{
+    long_u	ones = (long_u)-1 / 0xff;	/* 0x0101...01 */
+    long_u	highs = ones << 7;		/* 0x8080...80 */
+    long_u	cs = ones * c;
+    long_u	ccs = ones * cc;
+    long_u	x, y;
+
+    /* the first few characters, until "s" is aligned */
+    while (s < end && ((long_u)s & (sizeof(long_u) - 1)) != 0)
+    {
+	if (*s == c || *s == cc)
+	    return s;
+	++s;
+    }
+
+    while (end - s >= (long)sizeof(long_u))
+    {
+	x = *(long_u *)s ^ cs;
+	y = *(long_u *)s ^ ccs;
+	if ((((x - ones) & ~x) | ((y - ones) & ~y)) & highs)
+	    break;
+	s += sizeof(long_u);
+    }
+
+    while (s < end && *s != c && *s != cc)
+	++s;
+    return s;
+}
+
 /*
  * cstrchr: This function is used a lot for simple searches, keep it fast!
+ * Ignore case if "ic" set.
  */
     static char_u *
-cstrchr(s, c)
+cstrchr(s, c, ic)
     char_u	*s;
     int		c;
+    int		ic;
 {
     char_u	*p;
     int		cc;
 
-    if (!reg_ic)
+    if (!ic)
 	return vim_strchr(s, c);
 
     /* tolower() and toupper() can be slow, comparing twice should be a lot
@@ -2460,6 +4260,8 @@ regtilde(source, magic)
 
 /*
  * vim_regsub() - perform substitutions after a regexp match
+ * The matched text and subexpressions are taken from context "rex", as set by
+ * the last successful vim_regexec() with it.
  *
  * If copy is TRUE really copy into dest.
  * If copy is FALSE nothing is copied, this is just to find out the length of
@@ -2468,8 +4270,8 @@ regtilde(source, magic)
  * Returns the size of the replacement, including terminating NUL.
  */
     int
-vim_regsub(prog, source, dest, copy, magic)
-    vim_regexp	   *prog;
+vim_regsub(rex, source, dest, copy, magic)
+    REGEXEC	   *rex;
     char_u	   *source;
     char_u	   *dest;
     int		    copy;
@@ -2482,16 +4284,11 @@ vim_regsub(prog, source, dest, copy, magic)
     int		no;
     fptr	func = (fptr)NULL;
 
-    if (prog == NULL || source == NULL || dest == NULL)
+    if (rex == NULL || source == NULL || dest == NULL)
     {
 	emsg(e_null);
 	return 0;
     }
-    if (UCHARAT(prog->program) != MAGIC)
-    {
-	emsg(e_re_corr);
-	return 0;
-    }
     src = source;
     dst = dest;
 
@@ -2559,9 +4356,9 @@ vim_regsub(prog, source, dest, copy, magic)
 	    }
 	    dst++;
 	}
-	else if (prog->startp[no] != NULL && prog->endp[no] != NULL)
+	else if (rex->rx_startp[no] != NULL && rex->rx_endp[no] != NULL)
 	{
-	    for (s = prog->startp[no]; s < prog->endp[no]; ++s)
+	    for (s = rex->rx_startp[no]; s < rex->rx_endp[no]; ++s)
 	    {
 		if (copy && *s == '\0') /* we hit NUL. */
 		{
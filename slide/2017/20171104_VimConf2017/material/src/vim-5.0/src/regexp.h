@@ -16,17 +16,53 @@
 #define _REGEXP_H
 
 #define NSUBEXP  10
+#define NMUST	 4	/* max number of "must appear" strings */
 typedef struct
 {
-    char_u	   *startp[NSUBEXP];
-    char_u	   *endp[NSUBEXP];
     char_u	    regstart;	/* Internal use only. */
     char_u	    reganch;	/* Internal use only. */
-    char_u	   *regmust;	/* Internal use only. */
-    int		    regmlen;	/* Internal use only. */
+    char_u	   *regmust[NMUST]; /* Internal use only. */
+    int		    regmlen[NMUST]; /* Internal use only. */
+    char_u	    regnmust;	/* Internal use only. */
+    char_u	    regmustany;	/* Internal use only. */
+    char_u	    regbackref;	/* Internal use only. */
+    char_u	    regnsub;	/* Internal use only. */
+    char_u	    regnbrace;	/* Internal use only. */
+    char_u	    regeol;	/* Internal use only. */
+    long	    regsize;	/* Internal use only. */
+    struct regdfa  *regdfa;	/* Internal use only. */
     char_u	    program[1]; /* Unwarranted chumminess with compiler. */
 } vim_regexp;
 
+/*
+ * The state of executing a program, see vim_regexec().  Each context can be
+ * used independently of the others, while a match with one of them is in
+ * progress another one can be used.  After a match rx_startp[] and rx_endp[]
+ * hold the positions of the match and its \( \) subexpressions, they are
+ * used by vim_regsub().  A program itself is not changed by matching, except
+ * for the DFA states it caches.
+ */
+typedef struct
+{
+    int		    rx_ic;	/* ignore case */
+    char_u	   *rx_startp[NSUBEXP];	/* start of match and subexpressions */
+    char_u	   *rx_endp[NSUBEXP];	/* end of match and subexpressions */
+    char_u	   *rx_input;	/* Internal use only. */
+    char_u	   *rx_bol;	/* Internal use only. */
+    int		    rx_need_clear; /* Internal use only. */
+    int		    rx_brace_count[10]; /* Internal use only. */
+    struct regwork *rx_work;	/* Internal use only. */
+} REGEXEC;
+
+/*
+ * One match found by vim_regexec_all().
+ */
+typedef struct
+{
+    char_u	   *rm_startp;
+    char_u	   *rm_endp;
+} REGMATCH;
+
 /*
  * The first byte of the regexp internal "program" is actually this magic
  * number; the start node begins in the second byte.
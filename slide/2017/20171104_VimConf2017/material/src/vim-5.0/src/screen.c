@@ -28,11 +28,25 @@ static int	screen_cur_row, screen_cur_col;	/* last known cursor position */
  * When highlighting matches for the last use search pattern:
  * - search_hl_prog points to the regexp program for it
  * - search_hl_attr contains the attributes to be used
- * - search_hl_ic is the value for "reg_ic" for this search
+ * - search_hl_rex is the context for matching it, rx_ic is the value of
+ *   "reg_ic" for this search.  Its work arrays are kept for the next redraw.
+ *
+ * The program is kept for the next redraw in search_hl_keep, together with
+ * the matches found with it in b_hls_lines[] of each buffer.  When the pattern
+ * or 'ignorecase' changes search_hl_tick is incremented, which makes the
+ * matches of all buffers invalid.
  */
 vim_regexp	*search_hl_prog = NULL;
 int		search_hl_attr;
-int		search_hl_ic;
+REGEXEC		search_hl_rex;
+static vim_regexp *search_hl_keep = NULL;
+static long	search_hl_tick = 1;
+
+/*
+ * The entry in b_hls_lines[] for line "lnum" is at index "lnum % HLS_LINES".
+ * This must be more than the number of lines on the screen.
+ */
+#define HLS_LINES	256
 #endif
 
 /*
@@ -71,6 +85,8 @@ static void screen_line __ARGS((int row, int endcol, int clear_rest));
 #ifdef EXTRA_SEARCH
 static void start_search_hl __ARGS((void));
 static void end_search_hl __ARGS((void));
+static int search_hl_line __ARGS((BUF *buf, linenr_t lnum, char_u *line, colnr_t **colsp));
+static void search_hl_free_line __ARGS((BUF *buf, struct hls_line *hl));
 #endif
 static void screen_start_highlight __ARGS((int attr));
 static void comp_botline __ARGS((void));
@@ -958,9 +974,12 @@ win_line(wp, lnum, startrow, endrow)
     int		    char_attr;		/* attributes for next character */
     int		    saved_attr = 0;	/* char_attr saved for showbreak */
 #ifdef EXTRA_SEARCH
-    char_u	    *matchp;
+    char_u	    *matchp;		/* start of the line */
     char_u	    *search_hl_start = NULL;
     char_u	    *search_hl_end = NULL;
+    colnr_t	    *search_hl_cols = NULL; /* columns of matches in line */
+    int		    search_hl_count = 0; /* number of matches in this line */
+    int		    search_hl_idx = 0;	/* index of current match */
 #endif
 
     if (startrow > endrow)		/* past the end already! */
@@ -1103,33 +1122,22 @@ win_line(wp, lnum, startrow, endrow)
      */
     if (search_hl_prog != NULL)
     {
-	reg_ic = search_hl_ic;
-	for (;;)
+	search_hl_count = search_hl_line(wp->w_buffer, lnum, matchp,
+							     &search_hl_cols);
+	if (search_hl_cols == NULL)
+	    search_hl_count = 0;
+	/* skip matches before leftcol */
+	while (search_hl_idx < search_hl_count
+		 && matchp + search_hl_cols[search_hl_idx * 2 + 1] <= ptr)
+	    ++search_hl_idx;
+	if (search_hl_idx < search_hl_count)
 	{
-	    if (vim_regexec(search_hl_prog, matchp, TRUE))
-	    {
-		search_hl_start = search_hl_prog->startp[0];
-		search_hl_end = search_hl_prog->endp[0];
-		if (search_hl_end <= ptr)    /* match before leftcol */
-		{
-		    if (matchp == search_hl_end) /* empty match */
-			++matchp;
-		    else
-			matchp = search_hl_end;
-		    continue;
-		}
-		if (search_hl_start < ptr)  /* match at leftcol */
-		    search_attr = search_hl_attr;
-	    }
-	    else
-	    {
-		search_hl_start = NULL;
-		search_hl_end = NULL;
-	    }
-	    break;
-	}
-	if (search_hl_start != NULL)
+	    search_hl_start = matchp + search_hl_cols[search_hl_idx * 2];
+	    search_hl_end = matchp + search_hl_cols[search_hl_idx * 2 + 1];
+	    if (search_hl_start < ptr)	/* match at leftcol */
+		search_attr = search_hl_attr;
 	    area_highlighting = TRUE;
+	}
     }
 #endif
 
@@ -1188,7 +1196,7 @@ win_line(wp, lnum, startrow, endrow)
 	     * Check for start/end of search pattern match.
 	     * After end, check for start/end of next match.
 	     * When another match, have to check for start again.
-	     * Watch out for matching an empty string!
+	     * There are no empty matches in search_hl_cols[].
 	     */
 	    if (!n_extra && !n_spaces)
 	    {
@@ -1199,14 +1207,13 @@ win_line(wp, lnum, startrow, endrow)
 		    if (ptr == search_hl_end)
 		    {
 			search_attr = 0;
-			reg_ic = search_hl_ic;
-			if (vim_regexec(search_hl_prog, ptr, FALSE))
+			if (++search_hl_idx < search_hl_count)
 			{
-			    search_hl_start = search_hl_prog->startp[0];
-			    search_hl_end = search_hl_prog->endp[0];
-			    if (search_hl_start != search_hl_end)
-				continue;
-			    ++search_hl_end; /* try again after empty match */
+			    search_hl_start = matchp
+				       + search_hl_cols[search_hl_idx * 2];
+			    search_hl_end = matchp
+				       + search_hl_cols[search_hl_idx * 2 + 1];
+			    continue;
 			}
 		    }
 		    break;
@@ -1792,11 +1799,37 @@ screen_puts(text, row, col, attr)
     static void
 start_search_hl()
 {
+    int		save_reg_ic;
+    vim_regexp	*prog;
+    int		ic;
+
     if (p_hls)
     {
-	search_hl_prog = last_pat_prog();
+	/* last_pat_prog() sets reg_ic for the pattern, keep it in the context
+	 * and don't change it for the caller */
+	save_reg_ic = reg_ic;
+	prog = last_pat_prog();
+	ic = reg_ic;
+	reg_ic = save_reg_ic;
+
+	/* When the pattern didn't change the matches found before are still
+	 * valid, keep the program with them. */
+	if (prog != NULL && search_hl_keep != NULL
+		&& ic == search_hl_rex.rx_ic
+		&& vim_regsame(prog, search_hl_keep))
+	{
+	    vim_regfree(prog);
+	    prog = search_hl_keep;
+	}
+	else
+	{
+	    vim_regfree(search_hl_keep);
+	    search_hl_keep = prog;
+	    ++search_hl_tick;
+	}
+	search_hl_prog = prog;
 	search_hl_attr = highlight_attr[HLF_L];
-	search_hl_ic = reg_ic;
+	search_hl_rex.rx_ic = ic;
     }
 }
 
@@ -1806,11 +1839,209 @@ start_search_hl()
     static void
 end_search_hl()
 {
-    if (search_hl_prog != NULL)
+    /* the program is kept in search_hl_keep */
+    search_hl_prog = NULL;
+}
+
+/*
+ * Get the matches of search_hl_prog in line "lnum" of buffer "buf", which
+ * has the text "line".  "*colsp" is set to the start and end column of each
+ * match, empty matches are left out.  Only when the line was not displayed
+ * before or was changed the pattern is matched with the text.  The text is
+ * compared with a copy, because not every change goes through
+ * search_hl_changed(): Some only change the text in the line buffer.
+ * Returns the number of matches.
+ */
+    static int
+search_hl_line(buf, lnum, line, colsp)
+    BUF		*buf;
+    linenr_t	lnum;
+    char_u	*line;
+    colnr_t	**colsp;
+{
+    struct hls_line	*hl;
+    struct growarray	ga;
+    REGMATCH		*rm;
+    int			n;
+    int			i;
+
+    *colsp = NULL;
+    if (buf->b_hls_tick != search_hl_tick)
+    {
+	search_hl_clear(buf);
+	buf->b_hls_tick = search_hl_tick;
+    }
+    if (buf->b_hls_lines == NULL)
+    {
+	buf->b_hls_lines = (struct hls_line *)alloc_clear(
+			      (unsigned)(HLS_LINES * sizeof(struct hls_line)));
+	if (buf->b_hls_lines == NULL)
+	    return 0;
+    }
+
+    hl = &buf->b_hls_lines[lnum % HLS_LINES];
+    if (hl->hl_lnum != lnum || STRCMP(hl->hl_text, line) != 0)
+    {
+	search_hl_free_line(buf, hl);
+
+	ga_init(&ga);
+	ga.ga_itemsize = sizeof(REGMATCH);
+	ga.ga_growsize = 10;
+	n = vim_regexec_all(&search_hl_rex, search_hl_prog, line, &ga,
+									TRUE);
+	if (n > 0)
+	{
+	    hl->hl_cols = (colnr_t *)alloc(
+					  (unsigned)(n * 2 * sizeof(colnr_t)));
+	    if (hl->hl_cols == NULL)
+		n = -1;
+	}
+	if (n >= 0 && (hl->hl_text = vim_strsave(line)) == NULL)
+	    n = -1;
+	if (n < 0)			/* out of memory */
+	{
+	    vim_free(hl->hl_cols);
+	    hl->hl_cols = NULL;
+	    ga_clear(&ga);
+	    return 0;
+	}
+	rm = (REGMATCH *)ga.ga_data;
+	for (i = 0; i < n; ++i)
+	    if (rm[i].rm_startp != rm[i].rm_endp)
+	    {
+		hl->hl_cols[hl->hl_count * 2] =
+					     (colnr_t)(rm[i].rm_startp - line);
+		hl->hl_cols[hl->hl_count * 2 + 1] =
+					       (colnr_t)(rm[i].rm_endp - line);
+		++hl->hl_count;
+	    }
+	ga_clear(&ga);
+	hl->hl_lnum = lnum;
+	++buf->b_hls_count;
+    }
+    *colsp = hl->hl_cols;
+    return hl->hl_count;
+}
+
+/*
+ * Make entry "hl" in b_hls_lines[] of buffer "buf" unused.
+ */
+    static void
+search_hl_free_line(buf, hl)
+    BUF			*buf;
+    struct hls_line	*hl;
+{
+    if (hl->hl_lnum != 0)
+    {
+	vim_free(hl->hl_cols);
+	vim_free(hl->hl_text);
+	hl->hl_cols = NULL;
+	hl->hl_text = NULL;
+	hl->hl_count = 0;
+	hl->hl_lnum = 0;
+	--buf->b_hls_count;
+    }
+}
+
+/*
+ * Called when lines in buffer "buf" change, to keep the matches found for
+ * 'hlsearch' valid:
+ * "amount" zero:     line "lnum" was changed;
+ * "amount" positive: "amount" lines were inserted above line "lnum";
+ * "amount" negative: "-amount" lines were deleted, starting at line "lnum".
+ * Only the changed lines are matched again, for other lines the entries are
+ * moved to their new line number.
+ */
+    void
+search_hl_changed(buf, lnum, amount)
+    BUF		*buf;
+    linenr_t	lnum;
+    long	amount;
+{
+    struct hls_line	*old_lines;
+    struct hls_line	*hl;
+    struct hls_line	*new_hl;
+    linenr_t		new_lnum;
+    int			i;
+
+    if (buf->b_hls_count == 0)
+	return;
+
+    if (amount == 0)
+    {
+	hl = &buf->b_hls_lines[lnum % HLS_LINES];
+	if (hl->hl_lnum == lnum)
+	    search_hl_free_line(buf, hl);
+	return;
+    }
+
+    /* Check if there is something to move. */
+    for (i = 0; i < HLS_LINES; ++i)
+	if (buf->b_hls_lines[i].hl_lnum >= lnum)
+	    break;
+    if (i == HLS_LINES)
+	return;
+
+    /* Move the entries to a new array, entries for deleted lines are
+     * dropped.  When two entries end up at the same index one is dropped. */
+    old_lines = buf->b_hls_lines;
+    buf->b_hls_lines = (struct hls_line *)alloc_clear(
+			      (unsigned)(HLS_LINES * sizeof(struct hls_line)));
+    if (buf->b_hls_lines == NULL)
     {
-	vim_free(search_hl_prog);
-	search_hl_prog = NULL;
+	buf->b_hls_lines = old_lines;
+	search_hl_clear(buf);
+	return;
+    }
+    for (i = 0; i < HLS_LINES; ++i)
+    {
+	hl = &old_lines[i];
+	if (hl->hl_lnum == 0)
+	    continue;
+	new_lnum = hl->hl_lnum;
+	if (new_lnum >= lnum)
+	{
+	    if (amount < 0 && new_lnum < lnum - amount)
+		new_lnum = 0;
+	    else
+		new_lnum += amount;
+	}
+	new_hl = &buf->b_hls_lines[new_lnum % HLS_LINES];
+	if (new_lnum == 0 || new_hl->hl_lnum != 0)
+	{
+	    vim_free(hl->hl_cols);
+	    vim_free(hl->hl_text);
+	    --buf->b_hls_count;
+	}
+	else
+	{
+	    *new_hl = *hl;
+	    new_hl->hl_lnum = new_lnum;
+	}
+    }
+    vim_free(old_lines);
+}
+
+/*
+ * Remove all matches found for 'hlsearch' in buffer "buf".
+ */
+    void
+search_hl_clear(buf)
+    BUF		*buf;
+{
+    int		i;
+
+    if (buf->b_hls_lines != NULL)
+    {
+	for (i = 0; i < HLS_LINES; ++i)
+	{
+	    vim_free(buf->b_hls_lines[i].hl_cols);
+	    vim_free(buf->b_hls_lines[i].hl_text);
+	}
+	vim_free(buf->b_hls_lines);
+	buf->b_hls_lines = NULL;
     }
+    buf->b_hls_count = 0;
 }
 #endif
 
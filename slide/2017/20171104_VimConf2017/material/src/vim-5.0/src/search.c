@@ -207,7 +207,7 @@ search_regcomp(pat, pat_save, pat_use, options)
 	}
     }
 
-    set_reg_ic(pat);		/* tell the vim_regexec routine how to search */
+    set_reg_ic(pat);		/* caller uses reg_ic for vim_regexec_init() */
     return vim_regcomp(pat, magic);
 }
 
@@ -310,6 +310,7 @@ searchit(buf, pos, dir, str, count, options, pat_use)
     int			found;
     linenr_t		lnum;		/* no init to shut up Apollo cc */
     vim_regexp		*prog;
+    REGEXEC		rex;
     char_u		*ptr;
     char_u		*match = NULL, *matchend = NULL;    /* init for GCC */
     int			loop;
@@ -318,6 +319,11 @@ searchit(buf, pos, dir, str, count, options, pat_use)
     int			extra_col;
     int			match_ok;
     char_u		*p;
+    linenr_t		stop;
+    struct growarray	ga;		/* matches in a line, backward */
+    REGMATCH		*rm;
+    int			nmatch;
+    int			i;
 
     if ((prog = search_regcomp(str, RE_SEARCH, pat_use,
 			     (options & (SEARCH_HIS + SEARCH_KEEP)))) == NULL)
@@ -332,6 +338,10 @@ searchit(buf, pos, dir, str, count, options, pat_use)
     else
 	extra_col = 1;
 
+    ga_init(&ga);
+    ga.ga_itemsize = sizeof(REGMATCH);
+    ga.ga_growsize = 10;
+    vim_regexec_init(&rex, reg_ic);
 
 /*
  * find the string
@@ -362,17 +372,42 @@ searchit(buf, pos, dir, str, count, options, pat_use)
 
 	for (loop = 0; loop <= 1; ++loop)   /* loop twice if 'wrapscan' set */
 	{
+	    /* Line where the search stops: the end of the buffer or, in the
+	     * second loop, where it started. */
+	    stop = (dir == FORWARD) ? buf->b_ml.ml_line_count : 1;
+	    if (loop && start_pos.lnum > 0
+				 && start_pos.lnum <= buf->b_ml.ml_line_count)
+		stop = start_pos.lnum;
+
 	    for ( ; lnum > 0 && lnum <= buf->b_ml.ml_line_count;
 					   lnum += dir, at_first_line = FALSE)
 	    {
 		/*
-		 * Look for a match somewhere in the line.
+		 * Skip over lines without a match quickly, going through the
+		 * data blocks of the buffer.  The line found is checked again
+		 * below, also when it doesn't match (it's the last line).
+		 */
+		if (!at_first_line)
+		    lnum = ml_find_match(buf, lnum, stop, dir, &rex, prog);
+
+		/*
+		 * Look for a match somewhere in the line.  When searching
+		 * backward find all matches in the line at once.
 		 */
 		ptr = ml_get_buf(buf, lnum, FALSE);
-		if (vim_regexec(prog, ptr, TRUE))
+		if (dir == BACKWARD)
+		{
+		    ga.ga_room += ga.ga_len;
+		    ga.ga_len = 0;
+		    nmatch = vim_regexec_all(&rex, prog, ptr, &ga,
+					  vim_strchr(p_cpo, CPO_SEARCH) != NULL);
+		}
+		else
+		    nmatch = vim_regexec(&rex, prog, ptr, TRUE);
+		if (nmatch > 0)
 		{
-		    match = prog->startp[0];
-		    matchend = prog->endp[0];
+		    match = rex.rx_startp[0];
+		    matchend = rex.rx_endp[0];
 
 		    /*
 		     * Forward search in the first line: match should be after
@@ -410,10 +445,10 @@ searchit(buf, pos, dir, str, count, options, pat_use)
 				if (*p != NUL)
 				    ++p;
 			    }
-			    if (*p != NUL && vim_regexec(prog, p, FALSE))
+			    if (*p != NUL && vim_regexec(&rex, prog, p, FALSE))
 			    {
-				match = prog->startp[0];
-				matchend = prog->endp[0];
+				match = rex.rx_startp[0];
+				matchend = rex.rx_endp[0];
 			    }
 			    else
 			    {
@@ -434,38 +469,20 @@ searchit(buf, pos, dir, str, count, options, pat_use)
 			 * relative to the end of the match.
 			 */
 			match_ok = FALSE;
-			for (;;)
+			rm = (REGMATCH *)ga.ga_data;
+			for (i = 0; i < nmatch; ++i)
 			{
 			    if (!at_first_line || ((options & SEARCH_END) ?
-					((prog->endp[0] - ptr) - 1 + extra_col
+				    ((rm[i].rm_endp - ptr) - 1 + extra_col
 						      <= (int)start_pos.col) :
-					  ((prog->startp[0] - ptr) + extra_col
+				      ((rm[i].rm_startp - ptr) + extra_col
 						      <= (int)start_pos.col)))
 			    {
 				match_ok = TRUE;
-				match = prog->startp[0];
-				matchend = prog->endp[0];
-			    }
-			    else
-				break;
-			    /*
-			     * If vi-compatible searching, continue at the end
-			     * of the match, otherwise continue one position
-			     * forward.
-			     */
-			    if (vim_strchr(p_cpo, CPO_SEARCH) != NULL)
-			    {
-				p = matchend;
-				if (p == match && *p != NUL)
-				    ++p;
+				match = rm[i].rm_startp;
+				matchend = rm[i].rm_endp;
 			    }
 			    else
-			    {
-				p = match;
-				if (*p != NUL)
-				    ++p;
-			    }
-			    if (*p == NUL || !vim_regexec(prog, p, (int)FALSE))
 				break;
 			}
 
@@ -526,7 +543,9 @@ searchit(buf, pos, dir, str, count, options, pat_use)
     }
     while (--count > 0 && found);   /* stop after count matches or no match */
 
-    vim_free(prog);
+    ga_clear(&ga);
+    vim_regexec_free(&rex);
+    vim_regfree(prog);
 
     if (!found)		    /* did not find it */
     {
@@ -2848,7 +2867,6 @@ find_pattern_in_path(ptr, dir, len, whole, skip_comments,
     long	match_count = 1;
 
     char_u	*pat;
-    int		pat_reg_ic = FALSE;
     char_u	*new_fname;
     char_u	*curr_fname = curbuf->b_fname;
     char_u	*prev_fname = NULL;
@@ -2865,6 +2883,9 @@ find_pattern_in_path(ptr, dir, len, whole, skip_comments,
     vim_regexp	*prog = NULL;
     vim_regexp	*include_prog = NULL;
     vim_regexp	*define_prog = NULL;
+    REGEXEC	rex;
+    REGEXEC	include_rex;
+    REGEXEC	define_rex;
     int		matched = FALSE;
     int		did_show = FALSE;
     int		found = FALSE;
@@ -2875,6 +2896,10 @@ find_pattern_in_path(ptr, dir, len, whole, skip_comments,
     file_line = alloc(LSIZE);
     if (file_line == NULL)
 	return;
+    vim_regexec_init(&rex, FALSE);
+    /* don't ignore case in include and define patterns */
+    vim_regexec_init(&include_rex, FALSE);
+    vim_regexec_init(&define_rex, FALSE);
 
     if (type != CHECK_PATH && type != FIND_DEFINE
 #ifdef INSERT_EXPAND
@@ -2889,7 +2914,7 @@ find_pattern_in_path(ptr, dir, len, whole, skip_comments,
 	    goto fpip_end;
 	sprintf((char *)pat, whole ? "\\<%.*s\\>" : "%.*s", len, ptr);
 	set_reg_ic(pat);    /* set reg_ic according to p_ic, p_scs and pat */
-	pat_reg_ic = reg_ic;
+	rex.rx_ic = reg_ic;
 	prog = vim_regcomp(pat, (int)p_magic);
 	vim_free(pat);
 	if (prog == NULL)
@@ -2930,10 +2955,10 @@ find_pattern_in_path(ptr, dir, len, whole, skip_comments,
 
     for (;;)
     {
-	reg_ic = FALSE;	/* don't ignore case in include pattern */
-	if (include_prog != NULL && vim_regexec(include_prog, line, TRUE))
+	if (include_prog != NULL
+		       && vim_regexec(&include_rex, include_prog, line, TRUE))
 	{
-	    new_fname = get_file_name_in_path(include_prog->endp[0] + 1,
+	    new_fname = get_file_name_in_path(include_rex.rx_endp[0] + 1,
 							    0, FNAME_EXP, 1L);
 	    already_searched = FALSE;
 	    if (new_fname != NULL)
@@ -2999,7 +3024,8 @@ find_pattern_in_path(ptr, dir, len, whole, skip_comments,
 		     * Isolate the file name.
 		     * Include the surrounding "" or <> if present.
 		     */
-		    for (p = include_prog->endp[0] + 1; !vim_isfilec(*p); p++)
+		    for (p = include_rex.rx_endp[0] + 1; !vim_isfilec(*p);
+									  p++)
 			;
 		    for (i = 0; vim_isfilec(p[i]); i++)
 			;
@@ -3080,15 +3106,15 @@ find_pattern_in_path(ptr, dir, len, whole, skip_comments,
 	    p = line;
 search_line:
 	    define_matched = FALSE;
-	    reg_ic = FALSE;	/* don't ignore case in define patterns */
-	    if (define_prog != NULL && vim_regexec(define_prog, line, TRUE))
+	    if (define_prog != NULL
+			 && vim_regexec(&define_rex, define_prog, line, TRUE))
 	    {
 		/*
 		 * Pattern must be first identifier after 'define', so skip
 		 * to that position before checking for match of pattern.  Also
 		 * don't let it match beyond the end of this identifier.
 		 */
-		p = define_prog->endp[0] + 1;
+		p = define_rex.rx_endp[0] + 1;
 		while (*p && !vim_isIDc(*p))
 		    p++;
 		define_matched = TRUE;
@@ -3100,7 +3126,6 @@ search_line:
 	     */
 	    if (define_prog == NULL || define_matched)
 	    {
-		reg_ic = pat_reg_ic;
 		if (define_matched
 #ifdef INSERT_EXPAND
 			|| (continue_status & CONT_SOL)
@@ -3117,10 +3142,10 @@ search_line:
 						    && vim_isIDc(startp[len]))
 			matched = FALSE;
 		}
-		else if (prog && vim_regexec(prog, p, p == line))
+		else if (prog && vim_regexec(&rex, prog, p, p == line))
 		{
 		    matched = TRUE;
-		    startp = prog->startp[0];
+		    startp = rex.rx_startp[0];
 		    /*
 		     * Check if the line is not a comment line (unless we are
 		     * looking for a define).  A line starting with "# define"
@@ -3378,9 +3403,12 @@ fpip_end:
 #ifdef INSERT_EXPAND
     if (!(continue_status & CONT_SOL))
 #endif
-	vim_free(prog);
-    vim_free(include_prog);
-    vim_free(define_prog);
+	vim_regfree(prog);
+    vim_regfree(include_prog);
+    vim_regfree(define_prog);
+    vim_regexec_free(&rex);
+    vim_regexec_free(&include_rex);
+    vim_regexec_free(&define_rex);
 }
 
     static void
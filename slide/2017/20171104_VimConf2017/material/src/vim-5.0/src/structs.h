@@ -177,12 +177,17 @@ typedef long		    blocknr_t;
  * for each (previously) used block in the memfile there is one block header.
  *
  * The block may be linked in the used list OR in the free list.
- * The used blocks are also kept in hash lists.
+ * The used blocks are also kept in a hash table.
  *
  * The used list is a doubly linked list, most recently used block first.
  *	The blocks in the used list have a block of memory allocated.
  *	mf_used_count is the number of pages in the used list.
- * The hash lists are used to quickly find a block in the used list.
+ * The hash table is used to quickly find a block in the used list.
+ * With 'swapmap' a block in the used list may use the swap file mapping
+ *	instead of allocated memory, see BH_MAPPED.  These are counted in
+ *	mf_map_count instead of mf_used_count.
+ * A block with BH_LAZY was filled by the caller from another file and was
+ *	not changed: it can be dropped without writing it, see mf_get_lazy().
  * The free list is a single linked list, not sorted.
  *	The blocks in the free list have no block of memory allocated and
  *	the contents of the block in the file (if any) is irrelevant.
@@ -192,39 +197,60 @@ struct block_hdr
 {
     BHDR	*bh_next;	    /* next block_hdr in free or used list */
     BHDR	*bh_prev;	    /* previous block_hdr in used list */
-    BHDR	*bh_hash_next;	    /* next block_hdr in hash list */
-    BHDR	*bh_hash_prev;	    /* previous block_hdr in hash list */
     blocknr_t	bh_bnum;		/* block number */
     char_u	*bh_data;	    /* pointer to memory (for used block) */
     int		bh_page_count;	    /* number of pages in this block */
 
 #define BH_DIRTY    1
 #define BH_LOCKED   2
-    char	bh_flags;	    /* BH_DIRTY or BH_LOCKED */
+#define BH_MAPPED   4	    /* bh_data points into the swap file mapping */
+#define BH_LAZY	    8	    /* can be read again, not written when released */
+    char	bh_flags;	    /* BH_DIRTY, BH_LOCKED, BH_MAPPED or BH_LAZY */
 };
 
 /*
  * when a block with a negative number is flushed to the file, it gets
  * a positive number. Because the reference to the block is still the negative
  * number, we remember the translation to the new positive number in the
- * double linked trans lists. The structure is the same as the hash lists.
+ * trans hash table.
  */
 typedef struct nr_trans NR_TRANS;
 
 struct nr_trans
 {
-    NR_TRANS	*nt_next;	    /* next nr_trans in hash list */
-    NR_TRANS	*nt_prev;	    /* previous nr_trans in hash list */
     blocknr_t	nt_old_bnum;		/* old, negative, number */
     blocknr_t	nt_new_bnum;		/* new, positive, number */
 };
 
 /*
- * Simplistic hashing scheme to quickly locate the blocks in the used list.
- * 64 blocks are found directly (64 * 4K = 256K, most files are smaller).
+ * Hash table to quickly locate the blocks in the used list, and the
+ * translations of negative block numbers.
+ * Open addressing with linear probing: an item with a NULL mhi_ptr is empty.
+ * The table starts with the MHT_INIT_SIZE items in mht_small_items (64 * 4K =
+ * 256K, most files are smaller) and is doubled when it gets half full.
  */
-#define MEMHASHSIZE	64
-#define MEMHASH(nr)	((nr) & (MEMHASHSIZE - 1))
+typedef struct mf_hashitem MF_HASHITEM;
+
+struct mf_hashitem
+{
+    blocknr_t	mhi_key;	    /* block number */
+    void	*mhi_ptr;	    /* BHDR or NR_TRANS, NULL when empty */
+};
+
+#define MHT_INIT_SIZE	64
+
+typedef struct mf_hashtab MF_HASHTAB;
+
+struct mf_hashtab
+{
+    long_u	mht_mask;	    /* number of items - 1, size is power of 2 */
+    long_u	mht_count;	    /* number of items in use */
+    MF_HASHITEM	*mht_items;	    /* points to mht_small_items or allocated */
+    MF_HASHITEM	mht_small_items[MHT_INIT_SIZE];
+    long	mht_hits;	    /* number of lookups that found an item */
+    long	mht_misses;	    /* number of lookups that failed */
+    long	mht_probes;	    /* number of items looked at by lookups */
+};
 
 struct memfile
 {
@@ -236,14 +262,27 @@ struct memfile
     BHDR	*mf_used_last;	    /* lru block_hdr in used list */
     unsigned	mf_used_count;	    /* number of pages in used list */
     unsigned	mf_used_count_max;  /* maximum number of pages in memory */
-    BHDR	*mf_hash[MEMHASHSIZE];	/* array of hash lists */
-    NR_TRANS	*mf_trans[MEMHASHSIZE];	/* array of trans lists */
+    MF_HASHTAB	mf_hash;	    /* hash table for blocks in used list */
+    MF_HASHTAB	mf_trans;	    /* hash table for translations */
     blocknr_t	mf_blocknr_max;	    /* highest positive block number + 1*/
     blocknr_t	mf_blocknr_min;	    /* lowest negative block number - 1 */
     blocknr_t	mf_neg_count;	    /* number of negative blocks numbers */
     blocknr_t	mf_infile_count;    /* number of pages in the file */
     unsigned	mf_page_size;	    /* number of bytes in a page */
     int		mf_dirty;	    /* Set to TRUE if there are dirty blocks */
+#ifdef MMAP_SWAP
+    char_u	*mf_map_base;	    /* start of the mapping, NULL if none */
+    long_u	mf_map_max;	    /* size of the reserved address range */
+    long_u	mf_map_len;	    /* number of bytes mapped from the file */
+    unsigned	mf_map_count;	    /* number of mapped pages in used list */
+#endif
+#ifdef USE_AIO_FSYNC
+    void	*mf_aiocb;	    /* aio_fsync() control block, NULL if none */
+    int		mf_aio_busy;	    /* TRUE when aio_fsync() was started */
+#endif
+#ifdef LAZY_READ
+    unsigned	mf_lazy_count;	    /* number of BH_LAZY blocks in used list */
+#endif
 };
 
 /*
@@ -264,6 +303,39 @@ struct info_pointer
     int		ip_index;	/* index for block with current lnum */
 };
 
+typedef struct ml_index_entry	MLIDX;	    /* line index entry */
+
+/*
+ * The line index has one entry for each data block, in line number order.
+ * It is used to find the data block for a line without going through the
+ * pointer blocks.  The line counts are also kept in a binary indexed tree
+ * (ie_tree), so that finding the first line of a block and updating the
+ * index for an inserted or deleted line don't need to go over all entries.
+ */
+struct ml_index_entry
+{
+    linenr_t	ie_line_count;	/* number of lines in the data block */
+    linenr_t	ie_tree;	/* line count of a range of entries */
+    blocknr_t	ie_bnum;	/* block number of the data block */
+    int		ie_page_count;	/* number of pages in block ie_bnum */
+};
+
+#ifdef LAZY_READ
+typedef struct ml_lazy_entry	MLLAZY;	    /* lazy data block entry */
+
+/*
+ * When a big file is edited read-only, its data blocks are not copied into
+ * the swap file.  Each data block that was not changed is read from the file
+ * again when it is needed, using an entry of the ml_lazy table.
+ */
+struct ml_lazy_entry
+{
+    blocknr_t	lz_bnum;	/* (negative) number of the data block */
+    long	lz_offset;	/* file offset of the first line in the block */
+    linenr_t	lz_line_count;	/* number of lines in the block */
+};
+#endif
+
 typedef struct memline MEMLINE;
 
 /*
@@ -292,6 +364,15 @@ struct memline
     linenr_t	ml_locked_low;	/* first line in ml_locked */
     linenr_t	ml_locked_high;	/* last line in ml_locked */
     int		ml_locked_lineadd;  /* number of lines inserted in ml_locked */
+
+    struct growarray ml_idx;	/* line index (array of MLIDX), empty when
+				   not built yet */
+#ifdef LAZY_READ
+    int		ml_lazy_fd;	/* file to read lazy blocks from or -1 */
+    int		ml_lazy_ff;	/* fileformat used for reading the file */
+    struct growarray ml_lazy;	/* lazy data blocks (array of MLLAZY), in
+				   order of decreasing block number */
+#endif
 };
 
 #ifdef SYNTAX_HL
@@ -307,6 +388,29 @@ struct keyentry
     char_u	    keyword[1];	/* actually longer */
 };
 
+/*
+ * For looking up keywords the hash lists are copied into a keyindex.  It is
+ * one allocated block: the struct keyindex, the entries, the start of each
+ * bucket in the entries and the text of the keywords.  The entries of bucket
+ * "n" are ki_entries[ki_start[n]] to ki_entries[ki_start[n + 1] - 1].
+ */
+struct keyidx_entry
+{
+    char_u	    *kie_keyword;   /* keyword, not NUL terminated */
+    int		    kie_len;	    /* length of kie_keyword */
+    short	    kie_syn_id;	    /* syntax ID */
+    short	    kie_flags;	    /* see syntax.c */
+    short	    *kie_next_list; /* ID list for next match (if non-zero) */
+};
+
+struct keyindex
+{
+    int			ki_mask;    /* number of buckets minus one */
+    int			ki_maxlen;  /* length of the longest keyword */
+    int			*ki_start;  /* ki_mask + 2 bucket starts */
+    struct keyidx_entry	*ki_entries;
+};
+
 /*
  * syn_state contains syntax state at the start of a line.
  */
@@ -319,6 +423,19 @@ struct syn_state
 };
 #endif /* SYNTAX_HL */
 
+#ifdef EXTRA_SEARCH
+/*
+ * The matches of the last search pattern in one line, kept for 'hlsearch'.
+ */
+struct hls_line
+{
+    linenr_t		hl_lnum;	/* line number, 0 when not used */
+    int			hl_count;	/* number of matches */
+    colnr_t		*hl_cols;	/* start and end column of matches */
+    char_u		*hl_text;	/* copy of the text of the line */
+};
+#endif
+
 /*
  * Structure shared between syntax.c, screen.c and gui_x11.c.
  */
@@ -523,9 +640,23 @@ struct buffer
 				     * this buffer */
 #endif
 
+#ifdef EXTRA_SEARCH
+/*
+ * b_hls_lines[] contains the matches of the last search pattern for lines
+ * that were displayed with 'hlsearch', see search_hl_line().
+ * b_hls_count is the number of used entries in b_hls_lines[].
+ * b_hls_tick  is the value of search_hl_tick when the entries were made.
+ */
+    struct hls_line	*b_hls_lines;
+    int			b_hls_count;
+    long		b_hls_tick;
+#endif
+
 #ifdef SYNTAX_HL
     struct keyentry	**b_keywtab;	      /* syntax keywords hash table */
     struct keyentry	**b_keywtab_ic;	      /* idem, ignore case */
+    struct keyindex	*b_keyidx;	      /* index for b_keywtab */
+    struct keyindex	*b_keyidx_ic;	      /* index for b_keywtab_ic */
     int			b_syn_ic;	      /* ignore case for :syn cmds */
     struct growarray	b_syn_patterns;	      /* table for syntax patterns */
     int			b_syn_sync_flags;     /* flags about how to sync */
@@ -550,6 +681,13 @@ struct buffer
     int			b_syn_states_len;
     linenr_t		b_syn_states_lnum;
     linenr_t		b_syn_change_lnum;
+/*
+ * b_syn_chk[] contains checkpoints for the whole buffer: entry "n" is a
+ * struct syn_state with the state at the start of line n * SYN_CHK_LINES.
+ * It avoids syncing again when going back to a line that was parsed before.
+ * Entries for lines after b_syn_change_lnum are invalidated.
+ */
+    struct growarray	b_syn_chk;
 #endif /* SYNTAX_HL */
 
 };
@@ -12,6 +12,17 @@
 
 #include "vim.h"
 
+/*
+ * For ":syntax time" the time used for matching a pattern is measured in
+ * microseconds, with gettimeofday() when possible, clock() otherwise.
+ */
+#if defined(HAVE_GETTIMEOFDAY) && defined(HAVE_SYS_TIME_H)
+# define SYN_TIME_T	struct timeval
+#else
+# include <time.h>
+# define SYN_TIME_T	clock_t
+#endif
+
 /*
  * Structure that stores information about a highlight group.
  * The ID of a highlight group is also called group ID.  It is the index in
@@ -102,6 +113,17 @@ static GuiFont font_name2handle __ARGS((char_u *name));
 static char *(spo_name_tab[SPO_COUNT]) =
 	    {"ms=", "me=", "hs=", "he=", "rs=", "re=", "lc="};
 
+/*
+ * What was measured for one pattern with ":syntax time on".
+ */
+struct syn_time
+{
+    long	st_count;	/* number of times the pattern was tried */
+    long	st_match;	/* number of times it matched */
+    long	st_total;	/* total time used, in microseconds */
+    long	st_slowest;	/* time used by the slowest try */
+};
+
 /*
  * The patterns that are being searched for are stored in a syn_pattern.
  * A match item consists of one pattern.
@@ -123,6 +145,8 @@ struct syn_pattern
     char_u		*sp_pattern;	    /* regexp to match, pattern */
     vim_regexp		*sp_prog;	    /* regexp to match, program */
     int			 sp_ic;		    /* ignore-case flag for sp_prog */
+    char_u		*sp_first;	    /* chars a match can start with or
+					       NULL, see syn_first_chars() */
     short		 sp_off_flags;	    /* see below */
     int			 sp_offsets[SPO_COUNT];	/* offsets */
     short		*sp_cont_list;	    /* cont. group IDs, if non-zero */
@@ -130,6 +154,7 @@ struct syn_pattern
     int			 sp_sync_idx;	    /* sync item index (syncing only) */
     int			 sp_line_id;	    /* ID of last line where tried */
     int			 sp_startcol;	    /* next match in sp_line_id line */
+    struct syn_time	 sp_time;	    /* for ":syntax time" */
 };
 
 /* The sp_off_flags are computed like this:
@@ -157,6 +182,12 @@ struct syn_pattern
 
 #define SYN_ITEMS(buf)	((struct syn_pattern *)((buf)->b_syn_patterns.ga_data))
 
+/*
+ * A pattern that can start with more than SYN_FIRST_MAX different characters
+ * is always tried, checking for the characters would not save much.
+ */
+#define SYN_FIRST_MAX	100
+
 #define NONE_IDX	-2	/* value of sp_sync_idx for "NONE" */
 
 /*
@@ -167,6 +198,12 @@ struct syn_pattern
 
 #define SYN_STATE_P(ssp)    ((int *)((ssp)->ga_data))
 
+/*
+ * A checkpoint in b_syn_chk[] is stored for every SYN_CHK_LINES'th line.
+ */
+#define SYN_CHK_LINES	50
+#define SYN_CHK(buf)	((struct syn_state *)((buf)->b_syn_chk.ga_data))
+
 /*
  * Settings for keyword hash table.  It uses a simplistic hash function: add
  * all characters together, modulo KHASH_SIZE.
@@ -175,6 +212,12 @@ struct syn_pattern
 #define KHASH_MASK	(KHASH_SIZE - 1)
 #define MAXKEYWLEN	80	    /* maximum length of a keyword */
 
+/*
+ * Hash function for the keyindex, "h" is the value for the characters before
+ * "c".  Adding characters together gives too many collisions.
+ */
+#define KEYIDX_HASH(h, c)   ((h) * 33 + (c))
+
 /*
  * The attributes of the syntax item that has been recognized.
  */
@@ -248,15 +291,28 @@ static struct growarray current_state	/* current stack of state_items */
 static short	*current_next_list = NULL; /* when non-zero, nextgroup list */
 static int	current_next_flags = 0; /* flags for current_next_list */
 static int	current_line_id = 0;	/* unique number for current line */
+static REGEXEC	syn_rex;		/* context for matching patterns */
+static int	first_cols_line_id = -1; /* line for which first_cols[] is
+					    valid */
+static int	first_cols[256];	/* last column of each char in line */
+static int	syn_time_on = FALSE;	/* ":syntax time on" was used */
 
 #define CUR_STATE(idx)	((struct state_item *)(current_state.ga_data))[idx]
 
 static void syn_sync __ARGS((WIN *wp, linenr_t lnum));
+static void syn_time_start __ARGS((SYN_TIME_T *tp));
+static long syn_time_since __ARGS((SYN_TIME_T *tp));
+static int syn_regexec __ARGS((REGMATCH *rmp, vim_regexp *prog, char_u *string, int at_bol, int ic, struct syn_time *st));
 static int syn_match_linecont __ARGS((linenr_t lnum));
+static char_u *syn_first_chars __ARGS((vim_regexp *prog, int ic));
+static int syn_first_found __ARGS((char_u *first, char_u *line, int col));
 static void syn_start_line __ARGS((void));
 static void syn_free_all_states __ARGS((BUF *buf));
 static void syn_clear_states __ARGS((int start, int end));
+static void syn_clear_chk __ARGS((BUF *buf, linenr_t lnum));
 static void store_current_state __ARGS((void));
+static void save_current_state __ARGS((struct syn_state *sp));
+static void store_chk_state __ARGS((void));
 static void invalidate_state __ARGS((struct growarray *sp));
 static void invalidate_current_state __ARGS((void));
 static void validate_state __ARGS((struct growarray *sp));
@@ -276,8 +332,8 @@ static int in_id_list __ARGS((short *cont_list, int id, int contained));
 static int push_current __ARGS((int idx));
 static void pop_current __ARGS((void));
 static char_u *find_endp __ARGS((int idx, char_u *sstart, int at_bol, char_u **hl_endp, int *flagsp, char_u **end_endp, int *end_idx));
-static char_u *syn_add_end_off __ARGS((struct syn_pattern *spp, int idx, int extra));
-static char_u *syn_add_start_off __ARGS((struct syn_pattern *spp, int idx, int extra));
+static char_u *syn_add_end_off __ARGS((REGMATCH *rmp, struct syn_pattern *spp, int idx, int extra));
+static char_u *syn_add_start_off __ARGS((REGMATCH *rmp, struct syn_pattern *spp, int idx, int extra));
 static int check_keyword_id __ARGS((char_u *line, int startcol, int *endcol, int *flags, short **next_list, struct state_item *cur_si));
 static void syn_cmd_case __ARGS((EXARG *eap, int syncing));
 static void syntax_sync_clear __ARGS((void));
@@ -289,12 +345,22 @@ static void syn_cmd_on __ARGS((EXARG *eap, int syncing));
 static void syn_cmd_off __ARGS((EXARG *eap, int syncing));
 static void syn_cmd_list __ARGS((EXARG *eap, int syncing));
 static void syn_lines_msg __ARGS((void));
+static void syn_cmd_time __ARGS((EXARG *eap, int syncing));
+static void syn_time_report __ARGS((void));
+static int
+#ifdef __BORLANDC__
+_RTLENTRYF
+#endif
+syn_time_compare __ARGS((const void *s1, const void *s2));
+static void syn_time_msg __ARGS((long t));
 static void syn_list_one __ARGS((int id, int syncing, int link_only));
 static void put_id_list __ARGS((char_u *name, short *list, int attr));
 static void put_pattern __ARGS((char *s, int c, struct syn_pattern *spp, int attr));
 static int syn_list_keywords __ARGS((int id, struct keyentry **ktabp, int did_header, int attr));
 static void syn_clear_keyword __ARGS((int id, struct keyentry **ktabp));
 static void free_keywtab __ARGS((struct keyentry **ktabp));
+static struct keyindex *build_keyindex __ARGS((struct keyentry **ktabp));
+static void syn_free_keyidx __ARGS((BUF *buf));
 static void add_keyword __ARGS((char_u *name, int id, int flags, short *next_list));
 static char_u *get_group_name __ARGS((char_u *arg, char_u **name_end));
 static char_u *get_syn_options __ARGS((char_u *arg, int *flagsp, int *sync_idx,
@@ -371,6 +437,7 @@ syntax_start(wp, lnum)
 					       syn_buf->b_syn_states_lnum + 1;
 	    syn_clear_states(idx, syn_buf->b_syn_states_len);
 	}
+	syn_clear_chk(syn_buf, syn_buf->b_syn_change_lnum);
 	if (syn_buf->b_syn_change_lnum < current_lnum)
 	    invalidate_current_state();
 	syn_buf->b_syn_change_lnum = MAXLNUM;
@@ -470,6 +537,29 @@ syntax_start(wp, lnum)
 		}
 	    }
 	}
+
+	/*
+	 * Use a checkpoint when it is closer to "lnum" than the saved state
+	 * found above.
+	 */
+	if (diff < SYN_CHK_LINES)
+	    diff = SYN_CHK_LINES;
+	idx = lnum / SYN_CHK_LINES;
+	if (idx >= syn_buf->b_syn_chk.ga_len)
+	    idx = syn_buf->b_syn_chk.ga_len - 1;
+	for ( ; idx > 0 && (linenr_t)idx * SYN_CHK_LINES + diff >= lnum; --idx)
+	{
+	    if (VALID_STATE(&SYN_CHK(syn_buf)[idx].sst_ga))
+	    {
+		if (INVALID_STATE(&current_state)
+			     || current_lnum < (linenr_t)idx * SYN_CHK_LINES)
+		{
+		    current_lnum = (linenr_t)idx * SYN_CHK_LINES;
+		    copy_state_to_current(&SYN_CHK(syn_buf)[idx]);
+		}
+		break;
+	    }
+	}
     }
 
     /*
@@ -715,6 +805,139 @@ syn_sync(wp, start_lnum)
     validate_current_state();
 }
 
+/*
+ * Remember the current time in "tp".
+ */
+    static void
+syn_time_start(tp)
+    SYN_TIME_T	*tp;
+{
+#if defined(HAVE_GETTIMEOFDAY) && defined(HAVE_SYS_TIME_H)
+    gettimeofday(tp, NULL);
+#else
+    *tp = clock();
+#endif
+}
+
+/*
+ * Return the number of microseconds since syn_time_start() set "tp".
+ */
+    static long
+syn_time_since(tp)
+    SYN_TIME_T	*tp;
+{
+#if defined(HAVE_GETTIMEOFDAY) && defined(HAVE_SYS_TIME_H)
+    struct timeval  now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - tp->tv_sec) * 1000000L
+					       + (now.tv_usec - tp->tv_usec);
+#else
+    return (long)((clock() - *tp) * (1000000L / CLOCKS_PER_SEC));
+#endif
+}
+
+/*
+ * Match "prog" against "string", ignoring case when "ic" is TRUE.
+ * When there is a match and "rmp" is not NULL, its start and end are stored
+ * in "rmp".  Matching other patterns doesn't change them.
+ * When "st" is not NULL and ":syntax time on" was used, the time is added to
+ * it.
+ */
+    static int
+syn_regexec(rmp, prog, string, at_bol, ic, st)
+    REGMATCH	    *rmp;
+    vim_regexp	    *prog;
+    char_u	    *string;
+    int		    at_bol;
+    int		    ic;
+    struct syn_time *st;
+{
+    int		r;
+    long	t;
+    SYN_TIME_T	start;
+
+    syn_rex.rx_ic = ic;
+    if (!syn_time_on || st == NULL)
+	r = vim_regexec(&syn_rex, prog, string, at_bol);
+    else
+    {
+	syn_time_start(&start);
+	r = vim_regexec(&syn_rex, prog, string, at_bol);
+	t = syn_time_since(&start);
+	++st->st_count;
+	if (r)
+	    ++st->st_match;
+	st->st_total += t;
+	if (t > st->st_slowest)
+	    st->st_slowest = t;
+    }
+    if (r && rmp != NULL)
+    {
+	rmp->rm_startp = syn_rex.rx_startp[0];
+	rmp->rm_endp = syn_rex.rx_endp[0];
+    }
+    return r;
+}
+
+/*
+ * Return an allocated string with the characters that a match of "prog" can
+ * start with.  Returns NULL when it can start with about any character, or
+ * when out of memory.
+ */
+    static char_u *
+syn_first_chars(prog, ic)
+    vim_regexp	*prog;
+    int		ic;
+{
+    char_u	set[256];
+    char_u	*first;
+    int		c;
+    int		len = 0;
+
+    if (vim_regfirst(prog, set, ic) == FAIL)
+	return NULL;
+    for (c = 1; c < 256; ++c)
+	if (set[c])
+	    ++len;
+    if (len > SYN_FIRST_MAX || (first = alloc(len + 1)) == NULL)
+	return NULL;
+    len = 0;
+    for (c = 1; c < 256; ++c)
+	if (set[c])
+	    first[len++] = c;
+    first[len] = NUL;
+    return first;
+}
+
+/*
+ * Return TRUE if one of the characters in "first" appears in "line" at or
+ * after column "col".  The line is scanned only once, the last column of
+ * every character is remembered in first_cols[] for all the patterns that
+ * are tried in the same line.
+ */
+    static int
+syn_first_found(first, line, col)
+    char_u	*first;
+    char_u	*line;
+    int		col;
+{
+    int		i;
+
+    if (first_cols_line_id != current_line_id)
+    {
+	for (i = 0; i < 256; ++i)
+	    first_cols[i] = -1;
+	for (i = 0; line[i] != NUL; ++i)
+	    first_cols[line[i]] = i;
+	first_cols_line_id = current_line_id;
+    }
+    for ( ; *first != NUL; ++first)
+	if (first_cols[*first] >= col)
+	    return TRUE;
+    return FALSE;
+}
+
 /*
  * Return TRUE if the line-continuation pattern matches in line "lnum".
  */
@@ -723,11 +946,9 @@ syn_match_linecont(lnum)
     linenr_t	    lnum;
 {
     if (syn_buf->b_syn_linecont_prog != NULL)
-    {
-	reg_ic = syn_buf->b_syn_linecont_ic;
-	return vim_regexec(syn_buf->b_syn_linecont_prog,
-				      ml_get_buf(syn_buf, lnum, FALSE), TRUE);
-    }
+	return syn_regexec(NULL, syn_buf->b_syn_linecont_prog,
+				       ml_get_buf(syn_buf, lnum, FALSE), TRUE,
+					 syn_buf->b_syn_linecont_ic, NULL);
     return FALSE;
 }
 
@@ -786,6 +1007,8 @@ syn_free_all_states(buf)
 	buf->b_syn_states = NULL;
 	buf->b_syn_states_len = 0;
     }
+    syn_clear_chk(buf, (linenr_t)0);
+    ga_clear(&(buf->b_syn_chk));
 }
 
 /*
@@ -802,35 +1025,91 @@ syn_clear_states(start, end)
 }
 
 /*
- * Try saving the current state in b_syn_states[].
+ * Clear the entries in b_syn_chk[] of buffer "buf" for lines after "lnum".
+ */
+    static void
+syn_clear_chk(buf, lnum)
+    BUF		*buf;
+    linenr_t	lnum;
+{
+    struct growarray	*gap = &(buf->b_syn_chk);
+    long		idx;
+
+    idx = lnum / SYN_CHK_LINES + 1;
+    while (gap->ga_len > idx)
+    {
+	--gap->ga_len;
+	++gap->ga_room;
+	invalidate_state(&(SYN_CHK(buf)[gap->ga_len].sst_ga));
+    }
+}
+
+/*
+ * Try saving the current state in b_syn_states[], and in b_syn_chk[] when
+ * current_lnum is a checkpoint.
  * The current state must be at the start of the current_lnum line!
  */
     static void
 store_current_state()
 {
     long		idx;
-    int			i;
-    struct growarray	*to;
 
     idx = current_lnum - syn_buf->b_syn_states_lnum;
     if (idx >= 0 && idx < syn_buf->b_syn_states_len)
+	save_current_state(&(syn_buf->b_syn_states[idx]));
+    if (current_lnum % SYN_CHK_LINES == 0)
+	store_chk_state();
+    current_state_stored = TRUE;
+}
+
+/*
+ * Save the current state in "sp".
+ */
+    static void
+save_current_state(sp)
+    struct syn_state	*sp;
+{
+    int			i;
+    struct growarray	*to = &(sp->sst_ga);
+
+    if (to->ga_data != NULL)
+	ga_clear(to);
+    else if (INVALID_STATE(to))
+	validate_state(to);
+    if (current_state.ga_len && ga_grow(to, current_state.ga_len) != FAIL)
     {
-	to = &(syn_buf->b_syn_states[idx].sst_ga);
-	if (to->ga_data != NULL)
-	    ga_clear(to);
-	else if (INVALID_STATE(to))
-	    validate_state(to);
-	if (current_state.ga_len && ga_grow(to, current_state.ga_len) != FAIL)
-	{
-	    for (i = 0; i < current_state.ga_len; ++i)
-		SYN_STATE_P(to)[i] = CUR_STATE(i).si_idx;
-	    to->ga_len = current_state.ga_len;
-	    to->ga_room -= to->ga_len;
-	}
-	syn_buf->b_syn_states[idx].sst_next_list = current_next_list;
-	syn_buf->b_syn_states[idx].sst_next_flags = current_next_flags;
+	for (i = 0; i < current_state.ga_len; ++i)
+	    SYN_STATE_P(to)[i] = CUR_STATE(i).si_idx;
+	to->ga_len = current_state.ga_len;
+	to->ga_room -= to->ga_len;
     }
-    current_state_stored = TRUE;
+    sp->sst_next_list = current_next_list;
+    sp->sst_next_flags = current_next_flags;
+}
+
+/*
+ * Save the current state in b_syn_chk[].  The array grows when needed, the
+ * new entries are invalid.
+ */
+    static void
+store_chk_state()
+{
+    struct growarray	*gap = &(syn_buf->b_syn_chk);
+    long		idx;
+    int			n;
+
+    idx = current_lnum / SYN_CHK_LINES;
+    if (idx >= gap->ga_len)
+    {
+	n = (int)(idx + 1 - gap->ga_len);
+	gap->ga_itemsize = sizeof(struct syn_state);
+	gap->ga_growsize = 100;
+	if (ga_grow(gap, n) == FAIL)
+	    return;
+	gap->ga_len += n;
+	gap->ga_room -= n;
+    }
+    save_current_state(&SYN_CHK(syn_buf)[idx]);
 }
 
 /*
@@ -912,6 +1191,44 @@ move_state(from, to)
     syn_buf->b_syn_states[from].sst_ga.ga_itemsize = 0;	/* invalid entry */
 }
 
+/*
+ * Parse the lines below the windows while waiting for the user to type
+ * something, to fill b_syn_chk[] ahead of time.  Scrolling or jumping down
+ * then only needs to parse from the nearest checkpoint.
+ * Stops when a character is available, like mf_sync() with MFS_STOP.
+ */
+    void
+syntax_idle()
+{
+    WIN		*wp;
+    BUF		*buf;
+    linenr_t	lnum;
+    long	idx;
+
+    for (wp = firstwin; wp != NULL; wp = wp->w_next)
+    {
+	buf = wp->w_buffer;
+	if (!syntax_present(buf))
+	    continue;
+	lnum = wp->w_botline;
+	if (lnum < 1)
+	    lnum = 1;
+	while (lnum <= buf->b_ml.ml_line_count)
+	{
+	    if (ui_char_avail())
+		return;
+	    syntax_start(wp, lnum);
+
+	    /* Continue at the next checkpoint that isn't valid yet. */
+	    idx = lnum / SYN_CHK_LINES + 1;
+	    while (idx < buf->b_syn_chk.ga_len
+			       && VALID_STATE(&SYN_CHK(buf)[idx].sst_ga))
+		++idx;
+	    lnum = (linenr_t)idx * SYN_CHK_LINES;
+	}
+    }
+}
+
 /*
  * Return TRUE if the syntax at start of lnum changed since last time.
  * This will only be called just after get_syntax_attr for the previous line,
@@ -1069,6 +1386,7 @@ syn_current_attr(syncing, line)
     char_u	*line;
 {
     int			syn_id;
+    REGMATCH		rm;	    /* match of the start pattern */
     char_u		*endp;
     char_u		*hl_endp = NULL;
     char_u		*eoep;	    /* end-of-end pattern */
@@ -1237,9 +1555,14 @@ syn_current_attr(syncing, line)
 			    if (lc_col < 0)
 				lc_col = 0;
 
-			    reg_ic = spp->sp_ic;
-			    if (!vim_regexec(spp->sp_prog, line + lc_col,
-					     lc_col == 0))
+			    /* Only try the pattern when a character that it
+			     * can start with is in the rest of the line. */
+			    if ((spp->sp_first != NULL
+				    && !syn_first_found(spp->sp_first, line,
+								     lc_col))
+				|| !syn_regexec(&rm, spp->sp_prog,
+					line + lc_col, lc_col == 0,
+					spp->sp_ic, &spp->sp_time))
 			    {
 				spp->sp_startcol = MAXCOL;
 				continue;
@@ -1248,7 +1571,7 @@ syn_current_attr(syncing, line)
 			    /*
 			     * Compute the first column of the match.
 			     */
-			    startcol = syn_add_start_off(spp,
+			    startcol = syn_add_start_off(&rm, spp,
 						       SPO_MS_OFF, -1) - line;
 			    if (startcol < 0)
 				startcol = 0;
@@ -1271,16 +1594,16 @@ syn_current_attr(syncing, line)
 				continue;
 			    }
 
-			    endp = spp->sp_prog->endp[0];
+			    endp = rm.rm_endp;
 
 			    /* Compute the highlight start. */
-			    hl_startcol = syn_add_start_off(spp,
+			    hl_startcol = syn_add_start_off(&rm, spp,
 						       SPO_HS_OFF, -1) - line;
 
 			    /* Compute the region start. */
 			    /* Default is to use the end of the match. */
 			    if (spp->sp_off_flags & (1 << SPO_RS_OFF))
-				eos_col = (spp->sp_prog->startp[0] - line)
+				eos_col = (rm.rm_startp - line)
 					    + spp->sp_offsets[SPO_RS_OFF] - 1;
 			    else
 				eos_col = (endp - line) - 1
@@ -1305,16 +1628,17 @@ syn_current_attr(syncing, line)
 			     */
 			    else if (spp->sp_type == SPTYPE_MATCH)
 			    {
-				hl_endp = syn_add_end_off(spp, SPO_HE_OFF, 0);
-				endp = syn_add_end_off(spp, SPO_ME_OFF, 0);
+				hl_endp = syn_add_end_off(&rm, spp,
+								SPO_HE_OFF, 0);
+				endp = syn_add_end_off(&rm, spp,
+								SPO_ME_OFF, 0);
 				if (endp + syncing <= line + startcol)
 				{
 				    /*
 				     * If an empty string is matched, may need
 				     * to try matching again at next column.
 				     */
-				    if (spp->sp_prog->startp[0] ==
-							spp->sp_prog->endp[0])
+				    if (rm.rm_startp == rm.rm_endp)
 					try_next_column = TRUE;
 				    continue;
 				}
@@ -1755,7 +2079,8 @@ find_endp(idx, sstart, at_bol, hl_endp, flagsp, end_endp, end_idx)
     char_u		*p;		    /* end of match */
     int			start_idx;
     int			best_idx;
-    char_u		*best_ptr;
+    REGMATCH		best_rm;	    /* match of END pattern best_idx */
+    REGMATCH		rm;
 
     /*
      * Check for being called with a START pattern.
@@ -1796,20 +2121,20 @@ find_endp(idx, sstart, at_bol, hl_endp, flagsp, end_endp, end_idx)
     for (;;)
     {
 	best_idx = -1;
-	best_ptr = NULL;
 	for (idx = start_idx; idx < syn_buf->b_syn_patterns.ga_len; ++idx)
 	{
 	    spp = &(SYN_ITEMS(syn_buf)[idx]);
 	    if (spp->sp_type != SPTYPE_END)	/* past last END pattern */
 		break;
 
-	    reg_ic = spp->sp_ic;
-	    if (vim_regexec(spp->sp_prog, endp, (at_bol && endp == sstart)))
+	    if (syn_regexec(&rm, spp->sp_prog, endp,
+				(at_bol && endp == sstart),
+						spp->sp_ic, &spp->sp_time))
 	    {
-		if (best_idx == -1 || spp->sp_prog->startp[0] < best_ptr)
+		if (best_idx == -1 || rm.rm_startp < best_rm.rm_startp)
 		{
 		    best_idx = idx;
-		    best_ptr = spp->sp_prog->startp[0];
+		    best_rm = rm;
 		}
 	    }
 	}
@@ -1826,22 +2151,22 @@ find_endp(idx, sstart, at_bol, hl_endp, flagsp, end_endp, end_idx)
 	 * continue searching after the skip pattern.
 	 */
 	if (	   spp_skip != NULL
-		&& (reg_ic = spp_skip->sp_ic,
-			vim_regexec(spp_skip->sp_prog, endp,
-						  (at_bol && endp == sstart)))
-		&& spp_skip->sp_prog->startp[0] <= best_ptr)
+		&& syn_regexec(&rm, spp_skip->sp_prog, endp,
+				   (at_bol && endp == sstart), spp_skip->sp_ic,
+							  &spp_skip->sp_time)
+		&& rm.rm_startp <= best_rm.rm_startp)
 	{
 	    /* Add offset to skip pattern match */
-	    p = syn_add_end_off(spp_skip, SPO_ME_OFF, 1);
+	    p = syn_add_end_off(&rm, spp_skip, SPO_ME_OFF, 1);
 
 	    /* take care of an empty match or negative offset */
 	    if (p <= endp)
 		++endp;
-	    else if (p <= spp_skip->sp_prog->endp[0])
+	    else if (p <= rm.rm_endp)
 		endp = p;
 	    else
 		/* Be careful not to jump over the NUL at the end-of-line */
-		for (endp = spp_skip->sp_prog->endp[0];
+		for (endp = rm.rm_endp;
 					     *endp != NUL && endp < p; ++endp)
 		    ;
 
@@ -1857,11 +2182,11 @@ find_endp(idx, sstart, at_bol, hl_endp, flagsp, end_endp, end_idx)
 	 * Correct for match and highlight offset of end pattern.
 	 */
 	spp = &(SYN_ITEMS(syn_buf)[best_idx]);
-	p = syn_add_end_off(spp, SPO_ME_OFF, 1);
+	p = syn_add_end_off(&best_rm, spp, SPO_ME_OFF, 1);
 	if (p < sstart)
 	    p = sstart;
 
-	endp = syn_add_end_off(spp, SPO_HE_OFF, 1);
+	endp = syn_add_end_off(&best_rm, spp, SPO_HE_OFF, 1);
 	if (endp < sstart)
 	    endp = sstart;
 	if (endp > p)
@@ -1875,9 +2200,9 @@ find_endp(idx, sstart, at_bol, hl_endp, flagsp, end_endp, end_idx)
 	{
 	    *end_idx = best_idx;
 	    if (spp->sp_off_flags & (1 << (SPO_RE_OFF + SPO_COUNT)))
-		endp = spp->sp_prog->endp[0] + spp->sp_offsets[SPO_RE_OFF];
+		endp = best_rm.rm_endp + spp->sp_offsets[SPO_RE_OFF];
 	    else
-		endp = spp->sp_prog->startp[0] + spp->sp_offsets[SPO_RE_OFF];
+		endp = best_rm.rm_startp + spp->sp_offsets[SPO_RE_OFF];
 	    if (endp < sstart)
 		endp = sstart;
 	    if (endp > p)
@@ -1896,31 +2221,34 @@ find_endp(idx, sstart, at_bol, hl_endp, flagsp, end_endp, end_idx)
 }
 
 /*
- * Add offset to matched text for end of match or highlight.
+ * Add offset to text "rmp" matched with "spp" for end of match or highlight.
  */
     static char_u *
-syn_add_end_off(spp, idx, extra)
+syn_add_end_off(rmp, spp, idx, extra)
+    REGMATCH		*rmp;
     struct syn_pattern	*spp;
     int			idx;
     int			extra;	    /* extra chars for offset to start */
 {
     if (spp->sp_off_flags & (1 << idx))
-	return spp->sp_prog->startp[0] + spp->sp_offsets[idx] + extra;
-    return spp->sp_prog->endp[0] + spp->sp_offsets[idx];
+	return rmp->rm_startp + spp->sp_offsets[idx] + extra;
+    return rmp->rm_endp + spp->sp_offsets[idx];
 }
 
 /*
- * Add offset to matched text for start of match or highlight.
+ * Add offset to text "rmp" matched with "spp" for start of match or
+ * highlight.
  */
     static char_u *
-syn_add_start_off(spp, idx, extra)
+syn_add_start_off(rmp, spp, idx, extra)
+    REGMATCH		*rmp;
     struct syn_pattern	*spp;
     int			idx;
     int			extra;	    /* extra chars for offset to end */
 {
     if (spp->sp_off_flags & (1 << (idx + SPO_COUNT)))
-	return spp->sp_prog->endp[0] + spp->sp_offsets[idx] + extra;
-    return spp->sp_prog->startp[0] + spp->sp_offsets[idx];
+	return rmp->rm_endp + spp->sp_offsets[idx] + extra;
+    return rmp->rm_startp + spp->sp_offsets[idx];
 }
 
 /*
@@ -1937,53 +2265,59 @@ check_keyword_id(line, startcol, endcol, flags, next_list, cur_si)
     short		**next_list; /* next_list of matching keyword */
     struct state_item	*cur_si;    /* item at the top of the stack */
 {
-    struct keyentry *ktab;
-    char_u	    *p;
-    int		    round;
-    int		    hash;
-    int		    len;
-    char_u	    keyword[MAXKEYWLEN + 1]; /* assume max. keyword len is 80 */
+    struct keyindex	*ki;
+    struct keyidx_entry	*kie;
+    struct keyidx_entry	*kie_end;
+    char_u		*p;
+    int			round;
+    unsigned		hash;
+    unsigned		hash_ic;
+    int			len;
+    int			i;
 
-    /* Find first character after the keyword */
+    /*
+     * Find first character after the keyword.  Compute the hash values for
+     * matching case and ignoring case on the way, the keyword is not copied.
+     */
     p = line + startcol;
+    hash = KEYIDX_HASH(0, p[0]);
+    hash_ic = KEYIDX_HASH(0, TO_LOWER(p[0]));
     for (len = 1; vim_iswordc_buf(p[len], syn_buf); ++len)
-	;
+    {
+	hash = KEYIDX_HASH(hash, p[len]);
+	hash_ic = KEYIDX_HASH(hash_ic, TO_LOWER(p[len]));
+    }
     if (len > MAXKEYWLEN)
 	return 0;
 
-    /*
-     * Must make a copy of the keyword, so we can add a NUL and make it
-     * uppercase.
-     */
-    STRNCPY(keyword, p, len);
-    keyword[len] = NUL;
-
     /*
      * Try twice:
      * 1. matching case
      * 2. ignoring case
+     * The keyindex is built when it's used for the first time after
+     * keywords were added or cleared.
      */
     for (round = 1; round <= 2; ++round)
     {
-	if ((round == 1 ? syn_buf->b_keywtab : syn_buf->b_keywtab_ic) == NULL)
-	    continue;
-	p = keyword;
-	hash = 0;
 	if (round == 1)	/* match case */
 	{
-	    while (*p)
-		hash += *p++;
-	    ktab = syn_buf->b_keywtab[hash & KHASH_MASK];
+	    if (syn_buf->b_keywtab == NULL)
+		continue;
+	    if (syn_buf->b_keyidx == NULL)
+		syn_buf->b_keyidx = build_keyindex(syn_buf->b_keywtab);
+	    ki = syn_buf->b_keyidx;
 	}
 	else /* round == 2, ignore case */
 	{
-	    while (*p)
-	    {
-		hash += (*p = TO_LOWER(*p));
-		++p;
-	    }
-	    ktab = syn_buf->b_keywtab_ic[hash & KHASH_MASK];
+	    if (syn_buf->b_keywtab_ic == NULL)
+		continue;
+	    if (syn_buf->b_keyidx_ic == NULL)
+		syn_buf->b_keyidx_ic = build_keyindex(syn_buf->b_keywtab_ic);
+	    ki = syn_buf->b_keyidx_ic;
+	    hash = hash_ic;
 	}
+	if (ki == NULL || len > ki->ki_maxlen)	/* out of memory or too long */
+	    continue;
 
 	/*
 	 * Find keywords that match.
@@ -1991,22 +2325,40 @@ check_keyword_id(line, startcol, endcol, flags, next_list, cur_si)
 	 *  Accept a not-contained keyword at toplevel.
 	 *  Accept a keyword at other levels only if it is in the contains list.
 	 */
-	for ( ; ktab != NULL; ktab = ktab->next)
-	    if (   STRCMP(keyword, ktab->keyword) == 0
-		&& (   (current_next_list != 0
-			&& in_id_list(current_next_list, ktab->syn_id, 0))
-		    || (current_next_list == 0
-			&& ((cur_si == NULL && !(ktab->flags & HL_CONTAINED))
-			    || (cur_si != NULL
-				&& in_id_list(cur_si->si_cont_list,
-					ktab->syn_id,
-					ktab->flags & HL_CONTAINED))))))
+	kie = ki->ki_entries + ki->ki_start[hash & ki->ki_mask];
+	kie_end = ki->ki_entries + ki->ki_start[(hash & ki->ki_mask) + 1];
+	for ( ; kie < kie_end; ++kie)
+	{
+	    if (kie->kie_len != len)
+		continue;
+	    if (round == 1)
+	    {
+		if (STRNCMP(p, kie->kie_keyword, len) != 0)
+		    continue;
+	    }
+	    else
+	    {
+		for (i = 0; i < len; ++i)
+		    if (TO_LOWER(p[i]) != kie->kie_keyword[i])
+			break;
+		if (i < len)
+		    continue;
+	    }
+	    if (   (current_next_list != 0
+			&& in_id_list(current_next_list, kie->kie_syn_id, 0))
+		|| (current_next_list == 0
+		    && ((cur_si == NULL && !(kie->kie_flags & HL_CONTAINED))
+			|| (cur_si != NULL
+			    && in_id_list(cur_si->si_cont_list,
+				    kie->kie_syn_id,
+				    kie->kie_flags & HL_CONTAINED)))))
 	    {
 		*endcol = startcol + len - 1;
-		*flags = ktab->flags;
-		*next_list = ktab->next_list;
-		return ktab->syn_id;
+		*flags = kie->kie_flags;
+		*next_list = kie->kie_next_list;
+		return kie->kie_syn_id;
 	    }
+	}
     }
     return 0;
 }
@@ -2052,6 +2404,7 @@ syntax_clear(buf)
     buf->b_keywtab = NULL;
     free_keywtab(buf->b_keywtab_ic);
     buf->b_keywtab_ic = NULL;
+    syn_free_keyidx(buf);
 
     /* free the syntax patterns */
     for (i = buf->b_syn_patterns.ga_len; --i >= 0; )
@@ -2062,7 +2415,7 @@ syntax_clear(buf)
     buf->b_syn_sync_minlines = 0;
     buf->b_syn_sync_maxlines = 0;
 
-    vim_free(buf->b_syn_linecont_prog);
+    vim_regfree(buf->b_syn_linecont_prog);
     buf->b_syn_linecont_prog = NULL;
     vim_free(buf->b_syn_linecont_pat);
     buf->b_syn_linecont_pat = NULL;
@@ -2088,7 +2441,7 @@ syntax_sync_clear()
     curbuf->b_syn_sync_minlines = 0;
     curbuf->b_syn_sync_maxlines = 0;
 
-    vim_free(curbuf->b_syn_linecont_prog);
+    vim_regfree(curbuf->b_syn_linecont_prog);
     curbuf->b_syn_linecont_prog = NULL;
     vim_free(curbuf->b_syn_linecont_pat);
     curbuf->b_syn_linecont_pat = NULL;
@@ -2122,7 +2475,8 @@ syn_clear_pattern(buf, i)
     int	    i;
 {
     vim_free(SYN_ITEMS(buf)[i].sp_pattern);
-    vim_free(SYN_ITEMS(buf)[i].sp_prog);
+    vim_regfree(SYN_ITEMS(buf)[i].sp_prog);
+    vim_free(SYN_ITEMS(buf)[i].sp_first);
     /* Only free sp_cont_list and sp_next_list of first start pattern */
     if (i == 0 || SYN_ITEMS(buf)[i - 1].sp_type != SPTYPE_START)
     {
@@ -2176,6 +2530,7 @@ syn_cmd_clear(eap, syncing)
 	    arg = skipwhite(arg_end);
 	}
     }
+    syn_clear_chk(curbuf, (linenr_t)0);	/* checkpoints are invalid */
     redraw_curbuf_later(NOT_VALID);
 }
 
@@ -2195,6 +2550,7 @@ syn_clear_one(id, syncing)
     {
 	(void)syn_clear_keyword(id, curbuf->b_keywtab);
 	(void)syn_clear_keyword(id, curbuf->b_keywtab_ic);
+	syn_free_keyidx(curbuf);
     }
 
     /* clear the patterns for "id" */
@@ -2330,6 +2686,147 @@ syn_lines_msg()
     MSG_PUTS(" lines before top line");
 }
 
+/*
+ * Handle ":syntax time {on,off,clear,report}" command.
+ */
+/* ARGSUSED */
+    static void
+syn_cmd_time(eap, syncing)
+    EXARG	*eap;
+    int		syncing;	/* not used */
+{
+    char_u	*arg = eap->arg;
+    char_u	*next;
+    int		idx;
+
+    eap->nextcmd = find_nextcmd(arg);
+    if (eap->skip)
+	return;
+
+    for (next = arg; isalpha(*next); ++next)
+	;
+    if (STRNICMP(arg, "on", 2) == 0 && next - arg == 2)
+	syn_time_on = TRUE;
+    else if (STRNICMP(arg, "off", 3) == 0 && next - arg == 3)
+	syn_time_on = FALSE;
+    else if (STRNICMP(arg, "clear", 5) == 0 && next - arg == 5)
+    {
+	for (idx = 0; idx < curbuf->b_syn_patterns.ga_len; ++idx)
+	    vim_memset(&SYN_ITEMS(curbuf)[idx].sp_time, 0,
+						     sizeof(struct syn_time));
+    }
+    else if (STRNICMP(arg, "report", 6) == 0 && next - arg == 6)
+	syn_time_report();
+    else
+	EMSG2("Illegal argument: %s", arg);
+}
+
+/*
+ * List the patterns of the current buffer that were tried while ":syntax
+ * time on" was active, the ones that took the most time first.
+ */
+    static void
+syn_time_report()
+{
+    struct syn_pattern	**list;
+    struct syn_pattern	*spp;
+    int			len = 0;
+    int			idx;
+    int			n;
+    char		*s;
+
+    list = (struct syn_pattern **)alloc((unsigned)(sizeof(*list)
+				    * (curbuf->b_syn_patterns.ga_len + 1)));
+    if (list == NULL)
+	return;
+    for (idx = 0; idx < curbuf->b_syn_patterns.ga_len; ++idx)
+	if (SYN_ITEMS(curbuf)[idx].sp_time.st_count > 0)
+	    list[len++] = &SYN_ITEMS(curbuf)[idx];
+#ifdef HAVE_QSORT
+    qsort((void *)list, (size_t)len, sizeof(*list), syn_time_compare);
+#else
+    /* no qsort(): insertion sort, there are not many patterns */
+    for (idx = 1; idx < len; ++idx)
+    {
+	spp = list[idx];
+	for (n = idx; n > 0; --n)
+	{
+	    if (syn_time_compare((void *)&list[n - 1], (void *)&spp) <= 0)
+		break;
+	    list[n] = list[n - 1];
+	}
+	list[n] = spp;
+    }
+#endif
+
+    MSG_PUTS_TITLE("\nTOTAL      COUNT     MATCH    SLOWEST    "
+				   "NAME               PATTERN");
+    for (idx = 0; idx < len && !got_int; ++idx)
+    {
+	spp = list[idx];
+	msg_putchar('\n');
+	syn_time_msg(spp->sp_time.st_total);
+	msg_advance(11);
+	msg_outnum(spp->sp_time.st_count);
+	msg_advance(21);
+	msg_outnum(spp->sp_time.st_match);
+	msg_advance(30);
+	syn_time_msg(spp->sp_time.st_slowest);
+	msg_advance(41);
+	msg_outtrans(HL_TABLE()[spp->sp_syn_id - 1].sg_name);
+	msg_advance(60);
+	switch (spp->sp_type)
+	{
+	    case SPTYPE_START:	s = "start="; break;
+	    case SPTYPE_SKIP:	s = "skip="; break;
+	    case SPTYPE_END:	s = "end="; break;
+	    default:		s = ""; break;
+	}
+	msg_puts((char_u *)s);
+	/* don't let a long pattern wrap around */
+	n = Columns - msg_col - 1;
+	if (n > 0)
+	    msg_outtrans_len(spp->sp_pattern,
+				     ((int)STRLEN(spp->sp_pattern) < n)
+					? (int)STRLEN(spp->sp_pattern) : n);
+	ui_breakcheck();
+    }
+    vim_free(list);
+}
+
+/*
+ * Compare function for sorting in syn_time_report(): the pattern that used
+ * the most time goes first.
+ */
+    static int
+#ifdef __BORLANDC__
+_RTLENTRYF
+#endif
+syn_time_compare(s1, s2)
+    const void	*s1;
+    const void	*s2;
+{
+    long	t1 = (*(struct syn_pattern **)s1)->sp_time.st_total;
+    long	t2 = (*(struct syn_pattern **)s2)->sp_time.st_total;
+
+    if (t1 == t2)
+	return 0;
+    return t1 > t2 ? -1 : 1;
+}
+
+/*
+ * Output time "t", in microseconds, as seconds.
+ */
+    static void
+syn_time_msg(t)
+    long	t;
+{
+    char	buf[30];
+
+    sprintf(buf, "%ld.%06ld", t / 1000000L, t % 1000000L);
+    msg_puts((char_u *)buf);
+}
+
 static int  last_matchgroup;
 
 /*
@@ -2697,6 +3194,110 @@ free_keywtab(ktabp)
     }
 }
 
+/*
+ * Build a keyindex for the keywords in hash table "ktabp".
+ * Keywords that are the same are kept in the order of the hash list, the
+ * last defined one is found first.
+ * Returns NULL when out of memory.
+ */
+    static struct keyindex *
+build_keyindex(ktabp)
+    struct keyentry **ktabp;
+{
+    struct keyindex	*ki;
+    struct keyidx_entry	*kie;
+    struct keyentry	*ktab;
+    char_u		*text;
+    char_u		*p;
+    unsigned		hash;
+    int			count = 0;
+    int			textlen = 0;
+    int			maxlen = 0;
+    int			size;
+    int			len;
+    int			i;
+
+    for (i = 0; i < KHASH_SIZE; ++i)
+	for (ktab = ktabp[i]; ktab != NULL; ktab = ktab->next)
+	{
+	    len = STRLEN(ktab->keyword);
+	    if (len > maxlen)
+		maxlen = len;
+	    textlen += len;
+	    ++count;
+	}
+
+    /* Use at least twice as many buckets as keywords. */
+    for (size = 16; size < count * 2; size <<= 1)
+	;
+    ki = (struct keyindex *)alloc((unsigned)(sizeof(struct keyindex)
+		+ count * sizeof(struct keyidx_entry)
+		+ (size + 1) * sizeof(int) + textlen));
+    if (ki == NULL)
+	return NULL;
+    ki->ki_mask = size - 1;
+    ki->ki_maxlen = maxlen;
+    ki->ki_entries = (struct keyidx_entry *)(ki + 1);
+    ki->ki_start = (int *)(ki->ki_entries + count);
+    text = (char_u *)(ki->ki_start + size + 1);
+
+    /*
+     * Count the keywords in each bucket, in ki_start[bucket + 1].  Then turn
+     * the counts into the start of each bucket.
+     */
+    for (i = 0; i <= size; ++i)
+	ki->ki_start[i] = 0;
+    for (i = 0; i < KHASH_SIZE; ++i)
+	for (ktab = ktabp[i]; ktab != NULL; ktab = ktab->next)
+	{
+	    hash = 0;
+	    for (p = ktab->keyword; *p; ++p)
+		hash = KEYIDX_HASH(hash, *p);
+	    ++ki->ki_start[(hash & ki->ki_mask) + 1];
+	}
+    for (i = 1; i <= size; ++i)
+	ki->ki_start[i] += ki->ki_start[i - 1];
+
+    /*
+     * Fill the entries, using ki_start[bucket] for the next free entry.
+     * Afterwards it is the start of the next bucket, shift it back.
+     */
+    for (i = 0; i < KHASH_SIZE; ++i)
+	for (ktab = ktabp[i]; ktab != NULL; ktab = ktab->next)
+	{
+	    hash = 0;
+	    for (p = ktab->keyword; *p; ++p)
+		hash = KEYIDX_HASH(hash, *p);
+	    kie = ki->ki_entries + ki->ki_start[hash & ki->ki_mask]++;
+	    len = p - ktab->keyword;
+	    vim_memmove(text, ktab->keyword, (size_t)len);
+	    kie->kie_keyword = text;
+	    kie->kie_len = len;
+	    kie->kie_syn_id = ktab->syn_id;
+	    kie->kie_flags = ktab->flags;
+	    kie->kie_next_list = ktab->next_list;
+	    text += len;
+	}
+    for (i = size - 1; i > 0; --i)
+	ki->ki_start[i] = ki->ki_start[i - 1];
+    ki->ki_start[0] = 0;
+
+    return ki;
+}
+
+/*
+ * Free the keyindexes of buffer "buf", after keywords were added or cleared.
+ */
+    static void
+syn_free_keyidx(buf)
+    BUF	    *buf;
+{
+    vim_free(buf->b_keyidx);
+    buf->b_keyidx = NULL;
+    vim_free(buf->b_keyidx_ic);
+    buf->b_keyidx_ic = NULL;
+}
+
 /*
  * Add a keyword to the list of keywords.
  */
@@ -2745,6 +3346,7 @@ add_keyword(name, id, flags, next_list)
 
     ktab->next = (*ktabpp)[hash];
     (*ktabpp)[hash] = ktab;
+    syn_free_keyidx(curbuf);
 }
 
 /*
@@ -2978,6 +3580,7 @@ syn_cmd_keyword(eap, syncing)
 	EMSG2(e_invarg2, arg);
 
     vim_free(next_list);
+    syn_clear_chk(curbuf, (linenr_t)0);	/* checkpoints are invalid */
     redraw_curbuf_later(NOT_VALID);
 }
 
@@ -3013,7 +3616,7 @@ syn_cmd_match(eap, syncing)
     init_syn_patterns();
     vim_memset(&item, 0, sizeof(item));
     rest = get_syn_pattern(rest, &item);
-    if (vim_regcomp_had_eol())
+    if (item.sp_prog != NULL && vim_regcomp_had_eol(item.sp_prog))
 	flags |= HL_HAS_EOL;
 
     /* Get options after the pattern */
@@ -3051,6 +3654,7 @@ syn_cmd_match(eap, syncing)
 	    if (flags & (HL_SYNC_HERE|HL_SYNC_THERE))
 		curbuf->b_syn_sync_flags |= SF_MATCH;
 
+	    syn_clear_chk(curbuf, (linenr_t)0);	/* checkpoints are invalid */
 	    redraw_curbuf_later(NOT_VALID);
 	    return;	/* don't free the progs and patterns now */
 	}
@@ -3059,8 +3663,9 @@ syn_cmd_match(eap, syncing)
     /*
      * Something failed, free the allocated memory.
      */
-    vim_free(item.sp_prog);
+    vim_regfree(item.sp_prog);
     vim_free(item.sp_pattern);
+    vim_free(item.sp_first);
     vim_free(cont_list);
     vim_free(next_list);
 
@@ -3212,7 +3817,8 @@ syn_cmd_region(eap, syncing)
 	     * Get the syntax pattern and the following offset(s).
 	     */
 	    rest = get_syn_pattern(rest, ppp->pp_synp);
-	    if (item == ITEM_END && vim_regcomp_had_eol())
+	    if (item == ITEM_END && ppp->pp_synp->sp_prog != NULL
+			       && vim_regcomp_had_eol(ppp->pp_synp->sp_prog))
 		ppp->pp_synp->sp_flags |= HL_HAS_EOL;
 	    ppp->pp_matchgroup_id = matchgroup_id;
 	    ++pat_count;
@@ -3273,6 +3879,7 @@ syn_cmd_region(eap, syncing)
 		}
 	    }
 
+	    syn_clear_chk(curbuf, (linenr_t)0);	/* checkpoints are invalid */
 	    redraw_curbuf_later(NOT_VALID);
 	    success = TRUE;	    /* don't free the progs and patterns now */
 	}
@@ -3286,8 +3893,9 @@ syn_cmd_region(eap, syncing)
 	{
 	    if (!success)
 	    {
-		vim_free(ppp->pp_synp->sp_prog);
+		vim_regfree(ppp->pp_synp->sp_prog);
 		vim_free(ppp->pp_synp->sp_pattern);
+		vim_free(ppp->pp_synp->sp_first);
 	    }
 	    vim_free(ppp->pp_synp);
 	    ppp_next = ppp->pp_next;
@@ -3345,6 +3953,7 @@ get_syn_pattern(arg, ci)
     if ((ci->sp_prog = vim_regcomp(ci->sp_pattern, TRUE)) == NULL)
 	return NULL;
     ci->sp_ic = curbuf->b_syn_ic;
+    ci->sp_first = syn_first_chars(ci->sp_prog, ci->sp_ic);
 
     /*
      * Check for a match, highlight or region offset.
@@ -3524,6 +4133,7 @@ syn_cmd_sync(eap, syncing)
     else if (!finished)
     {
 	eap->nextcmd = check_nextcmd(arg_start);
+	syn_clear_chk(curbuf, (linenr_t)0);	/* checkpoints are invalid */
 	redraw_curbuf_later(NOT_VALID);
     }
 }
@@ -3549,6 +4159,7 @@ get_id_list(arg, keylen, list)
     short	*retval = NULL;
     char_u	*name;
     vim_regexp	*prog;
+    REGEXEC	rex;
     int		id;
     int		i;
     int		failed = FALSE;
@@ -3633,11 +4244,12 @@ get_id_list(arg, keylen, list)
 			break;
 		    }
 
-		    reg_ic = TRUE;
+		    vim_regexec_init(&rex, TRUE);
 		    id = 0;
 		    for (i = highlight_ga.ga_len; --i >= 0; )
 		    {
-			if (vim_regexec(prog, HL_TABLE()[i].sg_name, TRUE))
+			if (vim_regexec(&rex, prog, HL_TABLE()[i].sg_name,
+									TRUE))
 			{
 			    if (round == 2)
 				retval[count] = i + 1;
@@ -3645,7 +4257,8 @@ get_id_list(arg, keylen, list)
 			    id = -1;	    /* remember that we found one */
 			}
 		    }
-		    vim_free(prog);
+		    vim_regexec_free(&rex);
+		    vim_regfree(prog);
 		}
 	    }
 	    vim_free(name);
@@ -3771,6 +4384,7 @@ static struct subcommand subcommands[] =
     {"off",		syn_cmd_off},
     {"region",		syn_cmd_region},
     {"sync",		syn_cmd_sync},
+    {"time",		syn_cmd_time},
     {"",		syn_cmd_list},
     {NULL, NULL}
 };
@@ -636,6 +636,7 @@ find_tags(pat, num_matches, matchesp, flags, mincount)
     char_u	*s;
     int		i;
     vim_regexp	*prog = NULL;		/* regexp program or NULL */
+    REGEXEC	rex;			/* context for matching "prog" */
 #ifdef BINARY_TAGS
     struct tag_search_info
     {
@@ -704,6 +705,7 @@ find_tags(pat, num_matches, matchesp, flags, mincount)
  */
     if (haswild)
 	prog = vim_regcomp(pat, p_magic);
+    vim_regexec_init(&rex, FALSE);
     lbuf = alloc(LSIZE);
     tag_fname = alloc(LSIZE + 1);
 #ifdef EMACS_TAGS
@@ -1174,13 +1176,13 @@ find_tags(pat, num_matches, matchesp, flags, mincount)
 
 		cc = *tagp.tagname_end;
 		*tagp.tagname_end = NUL;
-		match = vim_regexec(prog, tagp.tagname, TRUE);
-		matchoff = (int)(prog->startp[0] - tagp.tagname);
+		rex.rx_ic = reg_ic;
+		match = vim_regexec(&rex, prog, tagp.tagname, TRUE);
+		matchoff = (int)(rex.rx_startp[0] - tagp.tagname);
 		if (match && reg_ic)
 		{
-		    reg_ic = FALSE;
-		    match_no_ic = vim_regexec(prog, tagp.tagname, TRUE);
-		    reg_ic = TRUE;
+		    rex.rx_ic = FALSE;
+		    match_no_ic = vim_regexec(&rex, prog, tagp.tagname, TRUE);
 		}
 		*tagp.tagname_end = cc;
 	    }
@@ -1372,7 +1374,8 @@ find_tags(pat, num_matches, matchesp, flags, mincount)
 
 findtag_end:
     vim_free(lbuf);
-    vim_free(prog);
+    vim_regexec_free(&rex);
+    vim_regfree(prog);
     vim_free(tag_fname);
 #ifdef EMACS_TAGS
     vim_free(ebuf);
@@ -112,6 +112,21 @@ u_savesub(lnum)
     return (u_savecommon(lnum - 1, lnum + 1, lnum + 1));
 }
 
+/*
+ * save the lines "first" to "last" (used by :s command)
+ * The lines are replaced, so the new bottom line is last + 1.
+ */
+    int
+u_savesublines(first, last)
+    linenr_t	first;
+    linenr_t	last;
+{
+    if (undo_off)
+	return OK;
+
+    return (u_savecommon(first - 1, last + 1, last + 1));
+}
+
 /*
  * a new line is inserted before line "lnum" (used by :s command)
  * The line is inserted, so the new bottom line is lnum + 1.
@@ -803,9 +818,16 @@ u_undoline()
  */
 
     /*
-     * this blocksize is used when allocating new lines
+     * This blocksize is used when allocating new lines.  When a block is full
+     * all other blocks are searched for a free chunk, thus the number of
+     * blocks must not become too large when many lines are saved.  Systems
+     * with 16 bit int must use small blocks.
      */
-#define MEMBLOCKSIZE 2044
+#if defined(UNIX) || defined(DJGPP) || defined(WIN32) || defined(__EMX__)
+# define MEMBLOCKSIZE 65532
+#else
+# define MEMBLOCKSIZE 2044
+#endif
 
 /*
  * The size field contains the size of the chunk, including the size field
@@ -158,6 +158,11 @@ do_version(arg)
 #else
 	version_msg("-langmap ");
 #endif
+#ifdef LAZY_READ
+	version_msg("+lazyread ");
+#else
+	version_msg("-lazyread ");
+#endif
 #ifdef LISPINDENT
 	version_msg("+lispindent ");
 #else
@@ -222,6 +227,11 @@ do_version(arg)
 #else
 	version_msg("-sniff ");
 #endif
+#ifdef MMAP_SWAP
+	version_msg("+swapmap ");
+#else
+	version_msg("-swapmap ");
+#endif
 #ifdef SYNTAX_HL
 	version_msg("+syntax ");
 #else
@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+# Benchmark for matching patterns.
+#
+# Runs ":g/pattern/" with a number of patterns over a large file and reports
+# for each Vim given on the command line the user time in seconds for each
+# pattern, with the time for loading the file subtracted.  The patterns are
+# tried with 'noignorecase' and 'ignorecase'.
+#
+# Usage: regexpbench.sh [-f file] vim ...
+# Without -f a file of about 20 Mbyte is made from the help files.  Give an
+# old and a new Vim executable to compare them.
+#
+
+DOCDIR=`dirname $0`/../doc
+FILE=
+
+if [ "$1" = "-f" ]
+then
+	FILE=$2
+	shift
+	shift
+fi
+
+if [ $# -eq 0 ]
+then
+	echo "Usage: $0 [-f file] vim ..."
+	exit 1
+fi
+
+VIMS="$*"
+DIR=/tmp/regexpbench.$$
+mkdir $DIR || exit 1
+trap "rm -rf $DIR" 0 1 2 15
+
+if [ -z "$FILE" ]
+then
+	FILE=$DIR/file
+	for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20
+	do
+		cat $DOCDIR/*.txt
+	done >$FILE
+fi
+
+# Run Vim "$1" on $FILE with script "$2", print the user time of Vim.
+runvim()
+{
+	( "$1" -u NONE -i NONE -n -e -s $FILE <$2 >/dev/null; times ) 2>/dev/null |
+		tail -1 | sed -e 's/ .*//' -e 's/^\([0-9]*\)m\([0-9.]*\)s$/\1 \2/' |
+		awk '{ printf "%6.2f", $1 * 60 + $2 }'
+}
+
+echo "qa!" >$DIR/load.vim
+
+# One pattern per line, without "/".
+cat >$DIR/patterns <<'EOF'
+nosuchword
+\<buffer\>
+option.*window
+\(cursor\|screen\)line
+[0-9][0-9]*x
+^ *:[a-z]*map
+a.*b.*c.*d.*e
+\<[A-Z][a-z]*[A-Z]
+EOF
+
+for vim in $VIMS
+do
+	echo "$vim"
+	load=`runvim $vim $DIR/load.vim`
+	while read -r pat
+	do
+		for ic in noic ic
+		do
+			echo "set magic $ic" >$DIR/pat.vim
+			echo "let n = 0" >>$DIR/pat.vim
+			echo "g/$pat/let n = n + 1" >>$DIR/pat.vim
+			echo "qa!" >>$DIR/pat.vim
+			t=`runvim $vim $DIR/pat.vim`
+			t=`echo "$t $load" | awk '{ printf "%6.2f", $1 - $2 }'`
+			printf "%s  %-6s %s\n" "$t" $ic "$pat"
+		done
+	done <$DIR/patterns
+done
@@ -0,0 +1,72 @@
+#!/bin/sh
+#
+# Benchmark for the page size of the swap file.
+#
+# Creates files of about 16 Mbyte with different line lengths and reports
+# for each Vim given on the command line:
+#	load	user time for loading the file
+#	get	user time for getting all lines (searching for a missing word)
+#	swap	size of the swap file after ":preserve"
+#
+# Usage: swapbench.sh vim ...
+# Give an old and a new Vim executable to compare them.  Vim must be able to
+# use the terminal, the screen will flash a few times.
+#
+
+if [ $# -eq 0 ]
+then
+	echo "Usage: $0 vim ..."
+	exit 1
+fi
+
+VIMS="$*"
+DIR=/tmp/swapbench.$$
+mkdir $DIR $DIR/swap || exit 1
+trap "rm -rf $DIR" 0 1 2 15
+
+# Run Vim "$1" on file "$2" with script "$3", print the user time of Vim.
+runvim()
+{
+	( "$1" -u $DIR/vimrc -i NONE -s $3 $2 >/dev/tty; times ) 2>/dev/null | tail -1 |
+		sed -e 's/ .*//' -e 's/^\([0-9]*\)m\([0-9.]*\)s$/\1 \2/' |
+		awk '{ printf "%6.2f", $1 * 60 + $2 }'
+}
+
+echo "set dir=$DIR/swap nows" >$DIR/vimrc
+
+echo ":qa!" >$DIR/load.vim
+
+for i in 1 2 3 4 5
+do
+	echo "/nosuchword"
+done >$DIR/get.vim
+echo ":qa!" >>$DIR/get.vim
+
+echo ":preserve" >$DIR/swap.vim
+echo ":!cat $DIR/swap/*.sw? $DIR/swap/.*.sw? 2>/dev/null | wc -c >$DIR/swapsize" >>$DIR/swap.vim
+echo "" >>$DIR/swap.vim
+echo ":qa!" >>$DIR/swap.vim
+
+echo "linelen   load    get       swap  vim" >$DIR/result
+
+# line length and number of lines
+for spec in "80 200000" "1500 11000" "6000 2800" "40000 400"
+do
+	set -- $spec
+	FILE=$DIR/file$1
+	awk "BEGIN { for (i = 0; i < $1; ++i) s = s \"x\";
+			for (i = 0; i < $2; ++i) print s }" >$FILE
+	for vim in $VIMS
+	do
+		load=`runvim $vim $FILE $DIR/load.vim`
+		get=`runvim $vim $FILE $DIR/get.vim`
+		runvim $vim $FILE $DIR/swap.vim >/dev/null
+		swap=`cat $DIR/swapsize`
+		echo "$1 $load $get $swap $vim" |
+		 awk '{ printf "%7d %6.2f %6.2f %10d  %s\n", $1, $2, $3 - $2, $4, $5 }' \
+								   >>$DIR/result
+	done
+	rm -f $FILE
+done
+
+cat $DIR/result